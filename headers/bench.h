@@ -0,0 +1,285 @@
+/**
+ * \file  bench.h
+ * \brief Microbenchmark harness: calibrated cycle timer, optimization barrier,
+ *        repeated timed queries with warm-up and latency percentiles.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "memory.h"
+#include "pool.h"
+#include "stats.h"
+#include "trace.h"
+#include "workload.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+using namespace std;
+
+/// \brief Read the time stamp counter (or a nanosecond clock where there is no TSC).
+inline uint64_t tscNow() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence();
+    uint64_t ticks = __rdtsc();
+    _mm_lfence();
+    return ticks;
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/// \brief          Length of one tscNow() tick in seconds.
+/// \details        Measured once against steady_clock on the first call and cached afterwards.
+double tscSeconds();
+
+/// \brief       Keep the compiler from optimizing away the computation of value.
+/// \param value Result that must be treated as used.
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// \brief Parameters of one benchmark run.
+struct BenchConfig {
+    size_t warmup = 200;      ///< Untimed queries executed before the measurement.
+    int repetitions = 3;      ///< How many times the whole query list is timed.
+};
+
+/// \brief Latency summary of one benchmark run, all times in seconds.
+struct BenchResult {
+    string name;          ///< Name of the measured structure.
+    size_t samples = 0;   ///< Number of timed queries.
+    double mean = 0;
+    double p50 = 0;
+    double p99 = 0;
+    double p999 = 0;
+};
+
+/// \brief         Compute mean and percentiles of per-query timings.
+/// \param name    Name of the measured structure.
+/// \param ticks   Timings in tscNow() ticks; the vector is sorted in place.
+/// \return        Summary converted to seconds.
+BenchResult summarize(const string& name, vector<uint64_t>& ticks);
+
+/**
+ * \brief Time every query of a workload against one structure.
+ *
+ * The first config.warmup queries are executed untimed to warm caches and branch predictors.
+ * Then the whole query list is executed config.repetitions times and every query is timed
+ * separately, its result is passed through doNotOptimize().
+ *
+ * \tparam Key    Type of a query (a name, or an Operation of a workload).
+ * \param name    Name of the measured structure.
+ * \param queries Keys to look up.
+ * \param config  Warm-up and repetition counts.
+ * \param lookup  Callable that searches the structure for one key and returns something.
+ * \return        Latency summary.
+ */
+template <typename Key, typename Lookup>
+BenchResult runBench(const string& name, const vector<Key>& queries, const BenchConfig& config, Lookup lookup) {
+    TraceSpan span("query " + name, (long long)queries.size());
+
+    for (size_t i = 0; i < config.warmup && !queries.empty(); ++i) {
+        doNotOptimize(lookup(queries[i % queries.size()]));
+    }
+
+    vector<uint64_t> ticks;
+    ticks.reserve(queries.size() * config.repetitions);
+
+    for (int r = 0; r < config.repetitions; ++r) {
+        for (const Key& key : queries) {
+            uint64_t start = tscNow();
+            doNotOptimize(lookup(key));
+            ticks.push_back(tscNow() - start);
+        }
+    }
+
+    return summarize(name, ticks);
+}
+
+/**
+ * \brief Time a workload against one structure, with reads and inserts summarized apart.
+ *
+ * Like runBench(), but a workload that contains inserts changes the structure, so it is run
+ * exactly once and without warm-up: every structure then receives every insert once and
+ * answers every read on the same contents as the others. A read-only workload is warmed up
+ * and repeated as config says.
+ *
+ * \param name    Name of the measured structure.
+ * \param ops     The workload.
+ * \param config  Warm-up and repetition counts of a read-only workload.
+ * \param apply   Callable that executes one operation and returns something.
+ * \param inserts If not nullptr, receives the summary of the inserts.
+ * \return        Latency summary of the reads.
+ */
+template <typename Apply>
+BenchResult runWorkload(const string& name, const vector<Operation>& ops, BenchConfig config, Apply apply,
+                        BenchResult *inserts = nullptr) {
+    TraceSpan span("query " + name, (long long)ops.size());
+
+    if (any_of(ops.begin(), ops.end(), [](const Operation& op) { return op.type == INSERT; })) {
+        config.warmup = 0;
+        config.repetitions = 1;
+    }
+
+    for (size_t i = 0; i < config.warmup && !ops.empty(); ++i) {
+        doNotOptimize(apply(ops[i % ops.size()]));
+    }
+
+    vector<uint64_t> reads, writes;
+    reads.reserve(ops.size() * config.repetitions);
+
+    for (int r = 0; r < config.repetitions; ++r) {
+        for (const Operation& op : ops) {
+            uint64_t start = tscNow();
+            doNotOptimize(apply(op));
+            (op.type == INSERT ? writes : reads).push_back(tscNow() - start);
+        }
+    }
+
+    if (inserts) {
+        *inserts = summarize(name, writes);
+    }
+    return summarize(name, reads);
+}
+
+/// \brief Cost of building one structure.
+struct BuildResult {
+    string name;              ///< Name of the structure.
+    double seconds = 0;       ///< Wall time of the build.
+    size_t peak_bytes = 0;    ///< Highest heap growth during the build, including temporaries.
+    size_t steady_bytes = 0;  ///< Heap growth that is still allocated after the build.
+    size_t allocations = 0;   ///< Number of operator new calls during the build.
+};
+
+/**
+ * \brief Measures the time and heap footprint of building a structure.
+ *
+ * Heap usage comes from the counting operator new in memory.cpp, so everything the
+ * structure allocates (nodes, copied Flower objects, vectors) is included. Start() opens
+ * an allocation scope for the calling thread (and the pool tasks it starts), so builds
+ * that run at the same time on other threads are not counted. The structure must still
+ * be alive when Stop() is called, otherwise its steady size is zero.
+ * The measured interval is also recorded as a "build <name>" trace span.
+ */
+class BuildMeter {
+public:
+    BuildMeter() = default;
+    ~BuildMeter() { Close(); }
+
+    BuildMeter(const BuildMeter&) = delete;
+    BuildMeter& operator=(const BuildMeter&) = delete;
+
+    /// \brief Start a new measurement.
+    void Start() {
+        Close();
+        scope_ = memScopeOpen();
+        previous_scope_ = memScopeSwitch(scope_);
+        span_.Begin("build");
+        start_ = tscNow();
+    }
+
+    /// \brief Finish the measurement started by the last Start().
+    BuildResult Stop(const string& name) {
+        BuildResult res;
+        res.name = name;
+        res.seconds = (tscNow() - start_) * tscSeconds();
+
+        MemScope usage = memScopeRead(scope_);
+        res.peak_bytes = usage.peak;
+        res.steady_bytes = usage.current;
+        res.allocations = usage.allocations;
+
+        span_.End("build " + name);
+        Close();
+        return res;
+    }
+
+private:
+    unsigned long long scope_ = 0;
+    unsigned long long previous_scope_ = 0;
+    uint64_t start_ = 0;
+    TraceSpan span_;
+
+private:
+    /// \brief Give the thread its previous allocation scope back.
+    void Close() {
+        if (scope_) {
+            memScopeSwitch(previous_scope_);
+            scope_ = 0;
+        }
+    }
+};
+
+/**
+ * \brief Builds independent structures concurrently on a thread pool.
+ *
+ * Every build runs as one pool task under its own BuildMeter, so the results contain the
+ * same per-structure time and footprint as sequential builds. A build may itself use the
+ * pool (e.g. a partitioned hash build), RunAll() of the pool does not deadlock on nesting.
+ */
+class BuildScheduler {
+public:
+    BuildScheduler(ThreadPool& pool) : pool_(pool) {}
+
+    /// \brief Register a build; builds start in Run().
+    void Add(const string& name, function<void()> build) { builds_.push_back({ name, std::move(build) }); }
+
+    /**
+     * \brief Run all registered builds concurrently and wait for them.
+     * \return The results in the order the builds were added.
+     * \throws The first exception thrown by a build.
+     */
+    vector<BuildResult> Run();
+
+    /// \brief Wall time of the last Run(), in seconds.
+    double GetSeconds() const { return seconds_; }
+
+private:
+    ThreadPool& pool_;
+    vector<pair<string, function<void()>>> builds_;
+    double seconds_ = 0;
+};
+
+/// \brief          Append build costs to a CSV file
+///                 ("size,structure,build_seconds,peak_bytes,steady_bytes,bytes_per_row,peak_bytes_per_row,bytes_per_key,allocations").
+/// \param path     Path to the CSV file; the header is written if the file is empty.
+/// \param size     Number of rows in the dataset.
+/// \param distinct Number of distinct names in the dataset.
+/// \param results  Results to append.
+/// \throws         runtime_error if the file cannot be opened.
+void writeBuildCSV(const string& path, long size, size_t distinct, const vector<BuildResult>& results);
+
+/// \brief         Append instrumentation counters to a CSV file
+///                ("size,structure,phase,comparisons,nodes_visited,rotations,probes,allocations,height").
+/// \param path    Path to the CSV file; the header is written if the file is empty.
+/// \param size    Dataset size the counters belong to.
+/// \param stats   Name and counters of every structure.
+/// \throws        runtime_error if the file cannot be opened.
+void writeStatsCSV(const string& path, long size, const vector<pair<string, IndexStats>>& stats);
+
+/// \brief         Append benchmark results to a CSV file ("size,structure,samples,mean,p50,p99,p999").
+/// \param path    Path to the CSV file; the header is written if the file is empty.
+/// \param size    Dataset size the results belong to.
+/// \param results Results to append.
+/// \throws        runtime_error if the file cannot be opened.
+void writeBenchCSV(const string& path, long size, const vector<BenchResult>& results);
+
+/// \brief         Append benchmark results to a JSON Lines file, one object per structure.
+/// \param path    Path to the file.
+/// \param size    Dataset size the results belong to.
+/// \param results Results to append.
+/// \throws        runtime_error if the file cannot be opened.
+void writeBenchJSON(const string& path, long size, const vector<BenchResult>& results);
+
+#endif
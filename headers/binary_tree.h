@@ -6,6 +6,8 @@
 
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include "stats.h"
 using namespace std;
 
 /**
@@ -40,7 +42,11 @@ public:
     /// \{
     
     Tree() { root_ = nullptr; }
-    Tree(T value) { root_ = new Node<T>(value); }
+    Tree(T value) {
+        root_ = new Node<T>(value);
+        STAT_ADD(stats_, allocations, 1);
+        STAT_MAX(stats_, height, 1);
+    }
     ~Tree() { DeleteTree(root_); }
     /// \}
 
@@ -53,29 +59,82 @@ public:
     /// the tree and insert the new node in the correct position to maintain BST property.
     ///
     /// \param value Reference to the value to insert.
+    /// \return      The new node; it is a leaf.
     ///
-    void Insert(const T& value) {
+    Node<T>* Insert(const T& value) {
+        STAT_ADD(stats_, allocations, 1);
+
         if (!root_) {
             root_ = new Node<T>(value);
-            return;
+            STAT_MAX(stats_, height, 1);
+            return root_;
         }
 
         Node<T> *cur = root_;
+        Node<T> *node = new Node<T>(value);
+        long long depth = 1;
         while (true) {
+            STAT_ADD(stats_, nodes_visited, 1);
+            STAT_ADD(stats_, comparisons, 1);
+            depth += 1;
+
             if (value < cur->value_) {
                 if (cur->left_ == nullptr) {
-                    cur->left_ = new Node<T>(value);
+                    cur->left_ = node;
                     break;
                 }
                 cur = cur->left_;
             } else {
                 if (cur->right_ == nullptr) {
-                    cur->right_ = new Node<T>(value);
+                    cur->right_ = node;
                     break;
                 }
                 cur = cur->right_;
             }
         }
+
+        STAT_MAX(stats_, height, depth);
+        return node;
+    }
+
+    /**
+     * \brief Insert a run of values that is sorted by operator<.
+     *
+     * The first value of every run of equal values is inserted by Insert(). The next equal
+     * value belongs right below it, because Insert() sends equal values to the right and
+     * the new node is a leaf, so the rest of the run is linked without a search. The tree
+     * gets the same shape as after inserting the values one by one, and the cost depends
+     * on the number of distinct keys in the run, not on the number of values.
+     *
+     * \param sorted Pointers to the values, stably sorted by operator<.
+     */
+    void MergeSorted(const vector<const T*>& sorted) {
+        Node<T> *last = nullptr;
+
+        for (const T *value : sorted) {
+            if (last && !(last->value_ < *value)) {
+                last->right_ = new Node<T>(*value);
+                STAT_ADD(stats_, allocations, 1);
+                last = last->right_;
+            } else {
+                last = Insert(*value);
+            }
+        }
+    }
+
+    /**
+     * \brief Replace the contents of the tree with values that are already sorted.
+     *
+     * Builds a balanced tree in linear time instead of inserting the values one by one.
+     * The middle value of every range is moved to the first occurrence of its key, so all
+     * equal values stay to the right, as Insert() would place them: SearchAll() finds the
+     * same values in the same (input) order.
+     *
+     * \param sorted Pointers to the values, stably sorted by operator<.
+     */
+    void BuildSorted(const vector<const T*>& sorted) {
+        DeleteTree(root_);
+        root_ = SupportBuild(sorted.data(), 0, sorted.size(), 1);
     }
 
     /**
@@ -84,7 +143,17 @@ public:
      * \param value Reference to the value to search for.
      * \return Pointer to the node containing the value, or nullptr if not found.
      */
-    Node<T>* Search(const T& value) const { return SupportSearch(root_, value); }
+    Node<T>* Search(const T& value) { return SupportSearch(root_, value); }
+
+    /**
+     * \brief Find the next node with the same value as node.
+     *
+     * Equal values are inserted to the right, so the next one is in the right subtree.
+     *
+     * \param node A node returned by Search() or Next().
+     * \return Pointer to the next node with an equal value, or nullptr if there is none.
+     */
+    Node<T>* Next(Node<T>* node) { return SupportSearch(node->right_, node->value_); }
 
     /**
      * \brief Search for all nodes containing a given value.
@@ -103,12 +172,69 @@ public:
         return res;
     }
 
+    /**
+     * \brief Remove all values equal to value.
+     *
+     * Every node is unlinked as in a textbook BST deletion: a node with two children is
+     * replaced by the smallest node of its right subtree. All equal values lie in the subtree
+     * of the first one, so the search for the next one starts there.
+     *
+     * \param value Reference to the value to remove.
+     * \return Number of removed values.
+     */
+    size_t Remove(const T& value) {
+        size_t removed = 0;
+        Node<T> **link = SupportLink(&root_, value);
+
+        while (*link) {
+            SupportUnlink(link);
+            removed += 1;
+            link = SupportLink(link, value);
+        }
+
+        return removed;
+    }
+
+    /**
+     * \brief Remove one value: the first one equal to value for which match returns true.
+     *
+     * The equal values are visited in insertion order and only the matching node is unlinked,
+     * as in Remove().
+     *
+     * \param value Reference to a value with the key to remove.
+     * \param match Predicate that picks the value among the equal ones.
+     * \return      true if a value was removed.
+     */
+    template <typename Match>
+    bool RemoveOne(const T& value, Match match) {
+        for (Node<T> **link = SupportLink(&root_, value); *link; link = SupportLink(&(*link)->right_, value)) {
+            if (match((*link)->value_)) {
+                SupportUnlink(link);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * \brief Replace all values equal to value by value, or insert it if there are none.
+     * \param value Reference to the new value.
+     */
+    void Upsert(const T& value) {
+        Remove(value);
+        Insert(value);
+    }
+
     /// \brief Print all values in the tree using pre-order traversal.
     void PrintTree() { SupportPrint(root_); }
+
+    /// \brief Instrumentation counters, see stats.h.
+    IndexStats& GetStats() { return stats_; }
     /// \}
 
 private:
     Node<T> *root_ = nullptr;
+    IndexStats stats_;
 
 private:
     /// \defgroup supporting_methods Supporting methods for basic methods
@@ -140,8 +266,12 @@ private:
         Node<T> *cur = root;
 
         while (cur) { 
+            STAT_ADD(stats_, nodes_visited, 1);
+            STAT_ADD(stats_, comparisons, 1);
             if (cur->value_ == value) { return cur; }
 
+            STAT_ADD(stats_, comparisons, 1);
+
             if (value < cur->value_) {
                 cur = cur->left_;
             } else {
@@ -152,6 +282,75 @@ private:
         return nullptr;
     }
 
+    /// \brief The link (root_ or a child pointer) to the first node equal to value below *link, or to the empty place where it would be.
+    Node<T>** SupportLink(Node<T>** link, const T& value) {
+        while (*link) {
+            STAT_ADD(stats_, nodes_visited, 1);
+            STAT_ADD(stats_, comparisons, 1);
+            if ((*link)->value_ == value) {
+                break;
+            }
+
+            STAT_ADD(stats_, comparisons, 1);
+            link = value < (*link)->value_ ? &(*link)->left_ : &(*link)->right_;
+        }
+
+        return link;
+    }
+
+    /// \brief Delete the node *link points to and link its replacement in its place.
+    void SupportUnlink(Node<T>** link) {
+        Node<T> *node = *link;
+
+        if (!node->left_) {
+            *link = node->right_;
+        } else if (!node->right_) {
+            *link = node->left_;
+        } else {
+            Node<T> **next = &node->right_;
+            while ((*next)->left_) {
+                next = &(*next)->left_;
+            }
+
+            Node<T> *successor = *next;
+            *next = successor->right_;
+            successor->left_ = node->left_;
+            successor->right_ = node->right_;
+            *link = successor;
+        }
+
+        delete node;
+    }
+
+    /**
+     * \brief Build a subtree from sorted[lo, hi).
+     *
+     * Only the left subtrees are built recursively; the right spine is built in a loop,
+     * so long runs of equal values do not deepen the recursion.
+     */
+    Node<T>* SupportBuild(const T* const* sorted, size_t lo, size_t hi, long long depth) {
+        Node<T> *root = nullptr;
+        Node<T> **link = &root;
+
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            mid = lower_bound(sorted + lo, sorted + mid, sorted[mid],
+                              [](const T *l, const T *r) { return *l < *r; }) - sorted;
+
+            Node<T> *node = new Node<T>(*sorted[mid]);
+            STAT_ADD(stats_, allocations, 1);
+            STAT_MAX(stats_, height, depth);
+            node->left_ = SupportBuild(sorted, lo, mid, depth + 1);
+
+            *link = node;
+            link = &node->right_;
+            lo = mid + 1;
+            depth += 1;
+        }
+
+        return root;
+    }
+
     /// \brief Recursively delete all nodes in the subtree.
     void DeleteTree(Node<T> *root) {
         if (root) {
@@ -0,0 +1,285 @@
+/// \file cache.h
+/// \brief Defines a bounded query result cache with W-TinyLFU admission.
+///
+/// Provides:
+/// - FrequencySketch: A count-min sketch with small saturating counters and periodic aging.
+/// - ResultCache: A cache of row-id lists keyed by (index, key).
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include "hash_func.h"
+#include "rows.h"
+
+using namespace std;
+
+/**
+ * \class FrequencySketch
+ * \brief Approximate access counter used by the admission policy.
+ *
+ * Four rows of counters are indexed by four values derived from the key hash, the estimate
+ * of a key is the minimum of its four counters. Counters saturate at 15 and all of them are
+ * halved after every 10 * capacity increments, so the sketch forgets old popularity.
+ */
+class FrequencySketch {
+public:
+    FrequencySketch() = default;
+    FrequencySketch(size_t capacity) {
+        size_t width = 16;
+        while (width < capacity) {
+            width <<= 1;
+        }
+
+        mask_ = width - 1;
+        counters_.assign(4 * width, 0);
+        sample_size_ = 10 * (capacity ? capacity : 1);
+    }
+
+    /// \brief Count one access of the key with the given hash.
+    void Increment(uint64_t hash) {
+        for (int i = 0; i < 4; ++i) {
+            uint8_t& counter = counters_[Index(hash, i)];
+            if (counter < 15) {
+                counter += 1;
+            }
+        }
+
+        if (++additions_ == sample_size_) {
+            Age();
+        }
+    }
+
+    /// \brief Estimated number of recent accesses of the key with the given hash.
+    int Estimate(uint64_t hash) const {
+        int res = 15;
+        for (int i = 0; i < 4; ++i) {
+            int counter = counters_[Index(hash, i)];
+            res = counter < res ? counter : res;
+        }
+        return res;
+    }
+
+private:
+    vector<uint8_t> counters_;   ///< Four rows of width mask_ + 1 counters.
+    size_t mask_ = 0;
+    size_t sample_size_ = 0;     ///< Increments between two agings.
+    size_t additions_ = 0;
+
+private:
+    size_t Index(uint64_t hash, int row) const {
+        return row * (mask_ + 1) + (mix64(hash + row * 0x9e3779b97f4a7c15ULL) & mask_);
+    }
+
+    void Age() {
+        for (size_t i = 0; i < counters_.size(); ++i) {
+            counters_[i] >>= 1;
+        }
+        additions_ = 0;
+    }
+};
+
+/**
+ * \class ResultCache
+ * \brief In-process cache of lookup results, keyed by (index, key).
+ *
+ * Values are compact lists of row ids. The cache follows W-TinyLFU:
+ * - new entries go to a small LRU window (1% of the capacity);
+ * - an entry evicted from the window competes with the LRU victim of the main area,
+ *   and the one with the higher sketch frequency stays;
+ * - the main area is a segmented LRU: a hit in the probation segment promotes the entry
+ *   to the protected segment (80% of the main area).
+ *
+ * A hit costs one hash computation and one probe of the hash map. The index that produced
+ * a result must call Invalidate() whenever a row with that key is inserted.
+ */
+class ResultCache {
+public:
+    /**
+     * \brief Create a cache.
+     * \param capacity Maximum number of cached results.
+     */
+    ResultCache(size_t capacity) : sketch_(capacity) {
+        window_cap_ = capacity / 100 ? capacity / 100 : 1;
+        main_cap_ = capacity > window_cap_ ? capacity - window_cap_ : 1;
+        protected_cap_ = main_cap_ * 8 / 10;
+    }
+
+    /**
+     * \brief Look up a cached result.
+     *
+     * \param index Number of the index that produced the result (chosen by the caller).
+     * \param key   The searched key.
+     * \return      Pointer to the cached row ids, or nullptr on a miss. The pointer stays
+     *              valid until the next Put() or Invalidate().
+     */
+    const vector<RowId>* Get(int index, const string& key) {
+        uint64_t hash = HashKey(index, key);
+        sketch_.Increment(hash);
+
+        auto it = Find(hash, index, key);
+        if (it == map_.end()) {
+            misses_ += 1;
+            return nullptr;
+        }
+
+        hits_ += 1;
+        Touch(it->second);
+        return &it->second->rows_;
+    }
+
+    /**
+     * \brief Store the result of a lookup.
+     *
+     * \param index Number of the index that produced the result.
+     * \param key   The searched key.
+     * \param rows  Row ids found by the index.
+     */
+    void Put(int index, const string& key, const vector<RowId>& rows) {
+        uint64_t hash = HashKey(index, key);
+
+        auto it = map_.find(hash);
+        if (it != map_.end()) {
+            if (it->second->index_ == index && it->second->key_ == key) {
+                it->second->rows_ = rows;
+                Touch(it->second);
+                return;
+            }
+            Erase(it->second);
+        }
+
+        window_.push_front(Entry{ index, key, hash, rows, WINDOW });
+        map_.emplace(hash, window_.begin());
+
+        if (window_.size() > window_cap_) {
+            EvictWindow();
+        }
+    }
+
+    /// \brief Drop the cached result of one key, e.g. after a row with this key was inserted.
+    void Invalidate(int index, const string& key) {
+        auto it = Find(HashKey(index, key), index, key);
+        if (it != map_.end()) {
+            Erase(it->second);
+            invalidations_ += 1;
+        }
+    }
+
+    /// \brief Drop all cached results of an index, e.g. after it was rebuilt.
+    void InvalidateIndex(int index) {
+        for (list<Entry>* segment : { &window_, &probation_, &protected_ }) {
+            for (auto it = segment->begin(); it != segment->end(); ) {
+                auto next = std::next(it);
+                if (it->index_ == index) {
+                    Erase(it);
+                    invalidations_ += 1;
+                }
+                it = next;
+            }
+        }
+    }
+
+    size_t GetSize() const { return map_.size(); }
+    long long GetHits() const { return hits_; }
+    long long GetMisses() const { return misses_; }
+    long long GetEvictions() const { return evictions_; }
+    long long GetInvalidations() const { return invalidations_; }
+
+    /// \brief Share of Get() calls that found a cached result.
+    double HitRatio() const { return hits_ + misses_ ? (double)hits_ / (hits_ + misses_) : 0; }
+
+private:
+    /// \brief Segment of the cache an entry currently lives in.
+    enum Segment { WINDOW, PROBATION, PROTECTED };
+
+    struct Entry {
+        int index_;
+        string key_;
+        uint64_t hash_;   ///< Hash of (index_, key_), the key of the entry in map_.
+        vector<RowId> rows_;
+        Segment segment_;
+    };
+
+    /// \brief The map is keyed by the already mixed 64-bit hash, so it is used as is.
+    struct IdentityHash {
+        size_t operator()(uint64_t hash) const { return (size_t)hash; }
+    };
+
+    typedef list<Entry>::iterator EntryIt;
+
+    FrequencySketch sketch_;
+    list<Entry> window_, probation_, protected_;   ///< Most recently used entries first.
+    unordered_map<uint64_t, EntryIt, IdentityHash> map_;
+
+    size_t window_cap_, main_cap_, protected_cap_;
+    long long hits_ = 0, misses_ = 0, evictions_ = 0, invalidations_ = 0;
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+
+    uint64_t HashKey(int index, const string& key) const { return hashFunc_mix(key, (uint64_t)index); }
+
+    /// \brief Find the entry of (index, key); two keys with the same 64-bit hash never share it.
+    unordered_map<uint64_t, EntryIt, IdentityHash>::iterator Find(uint64_t hash, int index, const string& key) {
+        auto it = map_.find(hash);
+        if (it != map_.end() && (it->second->index_ != index || it->second->key_ != key)) {
+            return map_.end();
+        }
+        return it;
+    }
+
+    list<Entry>& SegmentList(Segment segment) {
+        return segment == WINDOW ? window_ : (segment == PROBATION ? probation_ : protected_);
+    }
+
+    /// \brief Update recency of an entry after a hit.
+    void Touch(EntryIt it) {
+        if (it->segment_ == PROBATION) {
+            it->segment_ = PROTECTED;
+            protected_.splice(protected_.begin(), probation_, it);
+
+            if (protected_.size() > protected_cap_) {
+                EntryIt demoted = std::prev(protected_.end());
+                demoted->segment_ = PROBATION;
+                probation_.splice(probation_.begin(), protected_, demoted);
+            }
+        } else {
+            list<Entry>& segment = SegmentList(it->segment_);
+            segment.splice(segment.begin(), segment, it);
+        }
+    }
+
+    /// \brief Move the LRU entry of the window to the main area if it wins admission.
+    void EvictWindow() {
+        EntryIt candidate = std::prev(window_.end());
+
+        if (probation_.size() + protected_.size() < main_cap_) {
+            candidate->segment_ = PROBATION;
+            probation_.splice(probation_.begin(), window_, candidate);
+            return;
+        }
+
+        EntryIt victim = probation_.empty() ? std::prev(protected_.end()) : std::prev(probation_.end());
+        evictions_ += 1;
+
+        if (sketch_.Estimate(candidate->hash_) > sketch_.Estimate(victim->hash_)) {
+            Erase(victim);
+            candidate->segment_ = PROBATION;
+            probation_.splice(probation_.begin(), window_, candidate);
+        } else {
+            Erase(candidate);
+        }
+    }
+
+    void Erase(EntryIt it) {
+        map_.erase(it->hash_);
+        SegmentList(it->segment_).erase(it);
+    }
+    /// \}
+};
+
+#endif
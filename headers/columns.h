@@ -0,0 +1,125 @@
+/**
+ * \file  columns.h
+ * \brief Columnar, dictionary-coded projection of a dataset and the aggregation kernels over it.
+ */
+
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include "flower.h"
+#include "pool.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// \brief Filter value that matches every row.
+#define ANY_VALUE -1
+/// \brief Code of a value that is not in a dictionary; a filter on it matches no row.
+#define NO_VALUE -2
+
+/// \brief Largest number of distinct regions: the regions of a row are a 32-bit mask.
+#define MAX_REGIONS 32
+
+/// \brief Rows tested by one step of the filter kernels.
+#define COLUMN_BLOCK 32
+
+/// \brief The columns of a ColumnStore.
+typedef enum { COL_NAME, COL_COLOR, COL_SMELL, COL_REGION, COLUMNS } ColumnId;
+
+/// \brief Conjunction of equality tests, one per column, as dictionary codes or ANY_VALUE.
+struct ColumnFilter {
+    int name = ANY_VALUE;
+    int color = ANY_VALUE;
+    int smell = ANY_VALUE;
+    int region = ANY_VALUE;     ///< The row has this region among its regions.
+};
+
+/**
+ * \class ColumnStore
+ * \brief Structure-of-arrays copy of the rows with every string column replaced by dictionary codes.
+ *
+ * - name: uint32 codes;
+ * - color, smell: uint8 codes (at most 256 distinct values);
+ * - regions: a uint32 bit mask per row, bit i for region code i (at most MAX_REGIONS regions).
+ *
+ * Dictionaries are sorted, so code order is the order of the values. A filter is evaluated
+ * COLUMN_BLOCK rows at a time into a bit mask: a byte column is compared 32 codes per
+ * instruction with AVX2 (16 with SSE2), a 32-bit column 8 (4) per instruction. COUNT is the
+ * popcount of the masks; GROUP BY adds the codes of the matching rows to a histogram,
+ * through four interleaved histograms when every row matches, so consecutive equal codes
+ * do not wait for each other's increments.
+ *
+ * Every query splits the rows into one range per thread of the pool and adds up the
+ * per-thread results.
+ */
+class ColumnStore {
+public:
+    /**
+     * \brief Encode the columns of rows; row i keeps id i.
+     * \throws runtime_error if there are more than 256 colors or smells, or more than MAX_REGIONS regions.
+     */
+    ColumnStore(const vector<Flower>& rows, ThreadPool& pool);
+
+    size_t GetRows() const { return names_.size(); }
+
+    /// \brief The sorted distinct values of a column.
+    const vector<string>& GetDictionary(ColumnId column) const { return dicts_[column]; }
+
+    /// \brief Dictionary code of value in column, or NO_VALUE.
+    int Code(ColumnId column, const string& value) const;
+
+    /// \brief Number of rows that pass filter.
+    uint64_t Count(const ColumnFilter& filter) const;
+
+    /**
+     * \brief GROUP BY column, COUNT(*) over the rows that pass filter.
+     * \return One count per code of column; for COL_REGION a row counts once for each of its regions.
+     */
+    vector<uint64_t> CountBy(ColumnId column, const ColumnFilter& filter) const;
+
+    /**
+     * \brief GROUP BY two columns, COUNT(*) over the rows that pass filter.
+     * \return Counts in row-major order: the count of codes (a, b) is at a * dictionary size of second + b.
+     */
+    vector<uint64_t> CountBy(ColumnId first, ColumnId second, const ColumnFilter& filter) const;
+
+    /// \brief Number of bytes of the code columns (the dictionaries are not counted).
+    size_t GetBytes() const { return names_.size() * (sizeof(uint32_t) * 2 + sizeof(uint8_t) * 2); }
+
+private:
+    ThreadPool& pool_;
+    vector<string> dicts_[COLUMNS];
+    vector<uint32_t> names_;
+    vector<uint8_t> colors_;
+    vector<uint8_t> smells_;
+    vector<uint32_t> regions_;
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+
+    /// \brief Bit j set if row begin + j passes filter, for the rows of [begin, end), at most COLUMN_BLOCK of them.
+    uint32_t Match(size_t begin, size_t end, const ColumnFilter& filter) const;
+
+    /// \brief Call visit(row) for every row of [begin, end) that passes filter.
+    template <typename Visit>
+    void ForEachMatch(size_t begin, size_t end, const ColumnFilter& filter, Visit visit) const;
+
+    /// \brief Add the codes of column over [begin, end) to hist, every row matching.
+    void Histogram(ColumnId column, size_t begin, size_t end, uint64_t *hist) const;
+
+    /// \brief Call add(code) for every value of column in row.
+    template <typename Add>
+    void ForEachValue(ColumnId column, size_t row, Add add) const;
+
+    /// \brief Run body(part, begin, end) on per-thread ranges of rows that start at block boundaries, part < pool threads.
+    template <typename Body>
+    void ForRanges(Body body) const;
+    /// \}
+};
+
+#endif
@@ -0,0 +1,471 @@
+/// \file compact_rb_tree.h
+/// \brief Defines a Red-Black Tree whose nodes are 64-byte array elements with the key stored inline.
+///
+/// This file provides:
+/// - CompactRBTree: A Red-Black Tree with the same insertion, removal, search and bulk-loading behaviour
+///   as RBTree, laid out so that one descent step reads one cache line.
+
+#ifndef COMPACT_RB_TREE_H
+#define COMPACT_RB_TREE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "inline_key.h"
+#include "rb_tree.h"
+#include "stats.h"
+
+using namespace std;
+
+/**
+ * \brief Red-Black Tree over nodes stored in one array and linked by 32-bit indices.
+ *
+ * RBTree compares against values_[0] of a node, so every step of a descent reads the node,
+ * the buffer of its vector and the name the value owns. Here a node is one cache line:
+ * - the InlineKey of the values of the node (first 32 bytes of the name and its length);
+ * - the indices of the children and of the parent, with the color in the lowest bit of
+ *   the parent index;
+ * - nothing else: the values with this key are kept in a separate array of payload lists,
+ *   read only when a search has found its node or two long names share their first bytes.
+ *
+ * Index 0 is a black sentinel that stands for every missing child and the parent of the root.
+ *
+ * \tparam T Type of the values; must provide GetKey() (an InlineKey) and GetName().
+ */
+template <typename T>
+class CompactRBTree {
+public:
+    /// \defgroup constructors Constructors
+    /// \{
+    CompactRBTree() { Clear(); }
+    /// \}
+
+    /// \defgroup main_methods Insert, removal, search and bulk loading
+    /// \{
+
+    /**
+     * \brief Insert a value into the tree.
+     *
+     * A value whose key is already in the tree is appended to the payload of that node.
+     * Otherwise a red node is linked in as in a BST and the tree is rebalanced via Balance().
+     *
+     * \param value Reference to the value to insert.
+     * \return      Index of the node that holds the values with the key of value.
+     */
+    uint32_t Insert(const T& value) {
+        uint32_t parent = kNil;
+        uint32_t cur = root_;
+        int order = 0;
+        long long depth = 1;
+
+        while (cur != kNil) {
+            STAT_ADD(stats_, nodes_visited, 1);
+            STAT_ADD(stats_, comparisons, 1);
+            order = Compare(value, cur);
+            if (order == 0) {
+                values_[cur].push_back(value);
+                return cur;
+            }
+
+            parent = cur;
+            cur = order < 0 ? nodes_[cur].left_ : nodes_[cur].right_;
+            depth += 1;
+        }
+
+        uint32_t node = NewNode(value, parent, RED);
+        STAT_ADD(stats_, allocations, 1);
+        STAT_MAX(stats_, height, depth);
+
+        if (parent == kNil) {
+            root_ = node;
+        } else if (order < 0) {
+            nodes_[parent].left_ = node;
+        } else {
+            nodes_[parent].right_ = node;
+        }
+
+        Balance(node);
+        return node;
+    }
+
+    /**
+     * \brief Insert a run of values that is sorted by operator<, one descent per run of equal values.
+     * \param sorted Pointers to the values, stably sorted by operator<.
+     */
+    void MergeSorted(const vector<const T*>& sorted) {
+        for (size_t i = 0; i < sorted.size(); ) {
+            uint32_t node = Insert(*sorted[i]);
+            for (i += 1; i < sorted.size() && !(*sorted[i - 1] < *sorted[i]); ++i) {
+                values_[node].push_back(*sorted[i]);
+            }
+        }
+    }
+
+    /**
+     * \brief Search for the values with the key of value.
+     *
+     * \param value Reference to the value to search for.
+     * \return Pointer to all values with this key, in insertion order, or nullptr if there are none.
+     *         The pointer is invalidated by the next Insert().
+     */
+    const vector<T>* SearchAll(const T& value) const {
+        uint32_t node = Find(value);
+        return node != kNil ? &values_[node] : nullptr;
+    }
+
+    /**
+     * \brief Remove all values with the key of value.
+     *
+     * As in RBTree::Remove(), a node with two children takes over the key and values of its
+     * successor, which is removed instead. The freed array slot is filled with the last node,
+     * so the array stays dense.
+     *
+     * \param value Reference to the value to remove.
+     * \return Number of removed values.
+     */
+    size_t Remove(const T& value) {
+        uint32_t node = Find(value);
+        if (node == kNil) {
+            return 0;
+        }
+        size_t removed = values_[node].size();
+
+        uint32_t target = node;
+        if (nodes_[node].left_ != kNil && nodes_[node].right_ != kNil) {
+            target = nodes_[node].right_;
+            while (nodes_[target].left_ != kNil) {
+                target = nodes_[target].left_;
+            }
+            nodes_[node].key_ = nodes_[target].key_;
+            values_[node].swap(values_[target]);
+        }
+
+        // The sentinel may take the place of target; its parent is then read by RemoveBalance().
+        uint32_t child = nodes_[target].left_ != kNil ? nodes_[target].left_ : nodes_[target].right_;
+        SetParent(child, Parent(target));
+        Relink(Parent(target), target, child);
+
+        if (!IsRed(target)) {
+            RemoveBalance(child);
+        }
+        nodes_[kNil].parent_color_ = 0;
+
+        Release(target);
+        return removed;
+    }
+
+    /**
+     * \brief Remove one value: the first one with the key of value for which match returns true.
+     *
+     * As in RBTree::RemoveOne(), the node is removed only when it held nothing else.
+     *
+     * \param value Reference to a value with the key to remove.
+     * \param match Predicate that picks the value among the equal ones.
+     * \return      true if a value was removed.
+     */
+    template <typename Match>
+    bool RemoveOne(const T& value, Match match) {
+        uint32_t node = Find(value);
+        if (node == kNil) {
+            return false;
+        }
+
+        vector<T>& values = values_[node];
+        auto it = find_if(values.begin(), values.end(), match);
+        if (it == values.end()) {
+            return false;
+        }
+        if (values.size() == 1) {
+            Remove(value);
+        } else {
+            values.erase(it);
+        }
+        return true;
+    }
+
+    /**
+     * \brief Replace all values with the key of value by value, or insert it if there are none.
+     * \param value Reference to the new value.
+     */
+    void Upsert(const T& value) {
+        uint32_t node = Find(value);
+        if (node != kNil) {
+            values_[node].assign(1, value);
+        } else {
+            Insert(value);
+        }
+    }
+
+    /**
+     * \brief Replace the contents of the tree with values that are already sorted.
+     *
+     * Equal values are grouped into one node, in input order. The nodes are stored in
+     * breadth-first order of a perfectly balanced tree, so the top levels of every search
+     * share cache lines. Colors are assigned as in RBTree::BuildSorted().
+     *
+     * \param sorted Pointers to the values, stably sorted by operator<.
+     */
+    void BuildSorted(const vector<const T*>& sorted) {
+        Clear();
+
+        vector<size_t> groups;
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            if (i == 0 || *sorted[i - 1] < *sorted[i]) {
+                groups.push_back(i);
+            }
+        }
+        size_t count = groups.size();
+        groups.push_back(sorted.size());
+        if (count == 0) {
+            return;
+        }
+
+        int max_depth = 0;
+        while (((size_t)2 << max_depth) - 1 < count) {
+            max_depth += 1;
+        }
+        int red_depth = ((size_t)2 << max_depth) - 1 == count ? -1 : max_depth;
+
+        nodes_.reserve(count + 1);
+        values_.reserve(count + 1);
+
+        // Every range [lo, hi) of groups becomes the subtree of one node; ranges are visited
+        // level by level, so node indices follow breadth-first order.
+        struct Range { size_t lo, hi; uint32_t parent; bool left; int depth; };
+        vector<Range> level = { Range{ 0, count, kNil, false, 0 } };
+
+        while (!level.empty()) {
+            vector<Range> next;
+            for (const Range& range : level) {
+                size_t mid = range.lo + (range.hi - range.lo) / 2;
+                uint32_t node = NewNode(*sorted[groups[mid]], range.parent, range.depth == red_depth ? RED : BLACK);
+                values_[node].reserve(groups[mid + 1] - groups[mid]);
+                for (size_t i = groups[mid] + 1; i < groups[mid + 1]; ++i) {
+                    values_[node].push_back(*sorted[i]);
+                }
+                STAT_ADD(stats_, allocations, 1);
+                STAT_MAX(stats_, height, range.depth + 1);
+
+                if (range.parent == kNil) {
+                    root_ = node;
+                } else if (range.left) {
+                    nodes_[range.parent].left_ = node;
+                } else {
+                    nodes_[range.parent].right_ = node;
+                }
+
+                if (range.lo < mid) {
+                    next.push_back(Range{ range.lo, mid, node, true, range.depth + 1 });
+                }
+                if (mid + 1 < range.hi) {
+                    next.push_back(Range{ mid + 1, range.hi, node, false, range.depth + 1 });
+                }
+            }
+            level = std::move(next);
+        }
+    }
+
+    /// \brief Number of distinct keys.
+    size_t GetCountUnq() const { return nodes_.size() - 1; }
+
+    /// \brief Number of bytes used by the nodes and the payload list headers (the values are not counted).
+    size_t GetBytes() const { return nodes_.capacity() * sizeof(Node) + values_.capacity() * sizeof(vector<T>); }
+
+    /// \brief Instrumentation counters, see stats.h.
+    IndexStats& GetStats() { return stats_; }
+    /// \}
+
+private:
+    /// \brief One cache line: the key and the links of a node.
+    struct alignas(64) Node {
+        InlineKey key_;
+        uint32_t left_ = 0;
+        uint32_t right_ = 0;
+        uint32_t parent_color_ = 0;   ///< Parent index << 1 | 1 if the node is red.
+    };
+
+    static const uint32_t kNil = 0;   ///< Index of the sentinel.
+
+    vector<Node> nodes_;              ///< Nodes; nodes_[0] is the sentinel.
+    vector<vector<T>> values_;        ///< Values with the key of every node, in insertion order.
+    uint32_t root_ = kNil;
+    mutable IndexStats stats_;        ///< Instrumentation counters, updated by const searches too.
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+
+    void Clear() {
+        nodes_.assign(1, Node());
+        values_.assign(1, vector<T>());
+        root_ = kNil;
+    }
+
+    uint32_t NewNode(const T& value, uint32_t parent, Color color) {
+        Node node;
+        node.key_ = value.GetKey();
+        node.parent_color_ = parent << 1 | (color == RED);
+        nodes_.push_back(node);
+        values_.push_back(vector<T>(1, value));
+        return (uint32_t)nodes_.size() - 1;
+    }
+
+    /// \brief Index of the node with the key of value, or kNil.
+    uint32_t Find(const T& value) const {
+        uint32_t cur = root_;
+
+        while (cur != kNil) {
+            STAT_ADD(stats_, nodes_visited, 1);
+            STAT_ADD(stats_, comparisons, 1);
+            int order = Compare(value, cur);
+            if (order == 0) {
+                break;
+            }
+            cur = order < 0 ? nodes_[cur].left_ : nodes_[cur].right_;
+        }
+
+        return cur;
+    }
+
+    /// \brief Move the last node into the unlinked slot node and shrink the arrays.
+    void Release(uint32_t node) {
+        uint32_t last = (uint32_t)nodes_.size() - 1;
+        if (node != last) {
+            nodes_[node] = nodes_[last];
+            values_[node] = std::move(values_[last]);
+
+            Relink(Parent(last), last, node);
+            if (nodes_[node].left_ != kNil) { SetParent(nodes_[node].left_, node); }
+            if (nodes_[node].right_ != kNil) { SetParent(nodes_[node].right_, node); }
+        }
+
+        nodes_.pop_back();
+        values_.pop_back();
+    }
+
+    /// \brief Three-way comparison of the key of value with the key of node.
+    int Compare(const T& value, uint32_t node) const {
+        const InlineKey& key = value.GetKey();
+        int order = key.Compare(nodes_[node].key_);
+        if (order == 0 && key.Truncated()) {
+            return value.GetName().compare(values_[node][0].GetName());
+        }
+        return order;
+    }
+
+    uint32_t Parent(uint32_t node) const { return nodes_[node].parent_color_ >> 1; }
+    bool IsRed(uint32_t node) const { return nodes_[node].parent_color_ & 1; }
+
+    void SetParent(uint32_t node, uint32_t parent) {
+        nodes_[node].parent_color_ = parent << 1 | (nodes_[node].parent_color_ & 1);
+    }
+    void SetColor(uint32_t node, Color color) {
+        nodes_[node].parent_color_ = (nodes_[node].parent_color_ & ~1u) | (color == RED);
+    }
+
+    /// \brief Replace the child link of parent that points to from by to (or the root if parent is the sentinel).
+    void Relink(uint32_t parent, uint32_t from, uint32_t to) {
+        if (parent == kNil) {
+            root_ = to;
+        } else if (nodes_[parent].left_ == from) {
+            nodes_[parent].left_ = to;
+        } else {
+            nodes_[parent].right_ = to;
+        }
+    }
+
+    /// \brief Restore the Red-Black properties after node was linked in, see RBTree::Balance().
+    void Balance(uint32_t node) {
+        while (IsRed(Parent(node))) {
+            uint32_t dad = Parent(node);
+            uint32_t grand = Parent(dad);
+            bool left = nodes_[grand].left_ == dad;
+            uint32_t uncle = left ? nodes_[grand].right_ : nodes_[grand].left_;
+
+            if (IsRed(uncle)) {
+                SetColor(dad, BLACK);
+                SetColor(uncle, BLACK);
+                SetColor(grand, RED);
+                node = grand;
+                continue;
+            }
+
+            if (node == (left ? nodes_[dad].right_ : nodes_[dad].left_)) {
+                Rotate(node, dad);
+                node = dad;
+                dad = Parent(node);
+            }
+            SetColor(dad, BLACK);
+            SetColor(grand, RED);
+            Rotate(dad, grand);
+            break;
+        }
+
+        SetColor(root_, BLACK);
+    }
+
+    /// \brief Restore the Red-Black properties after a black node was removed, see RBTree::RemoveBalance().
+    void RemoveBalance(uint32_t node) {
+        while (node != root_ && !IsRed(node)) {
+            uint32_t parent = Parent(node);
+            bool left = nodes_[parent].left_ == node;
+            uint32_t sibling = left ? nodes_[parent].right_ : nodes_[parent].left_;
+
+            if (IsRed(sibling)) {
+                SetColor(sibling, BLACK);
+                SetColor(parent, RED);
+                Rotate(sibling, parent);
+                sibling = left ? nodes_[parent].right_ : nodes_[parent].left_;
+            }
+
+            uint32_t near = left ? nodes_[sibling].left_ : nodes_[sibling].right_;
+            uint32_t far = left ? nodes_[sibling].right_ : nodes_[sibling].left_;
+            if (!IsRed(near) && !IsRed(far)) {
+                SetColor(sibling, RED);
+                node = parent;
+                continue;
+            }
+
+            if (!IsRed(far)) {
+                SetColor(near, BLACK);
+                SetColor(sibling, RED);
+                Rotate(near, sibling);
+                far = sibling;
+                sibling = near;
+            }
+
+            SetColor(sibling, IsRed(parent) ? RED : BLACK);
+            SetColor(parent, BLACK);
+            SetColor(far, BLACK);
+            Rotate(sibling, parent);
+            node = root_;
+        }
+
+        SetColor(node, BLACK);
+    }
+
+    /// \brief Rotate child above its parent dad: a left rotation if child is the right child, otherwise a right one.
+    void Rotate(uint32_t child, uint32_t dad) {
+        STAT_ADD(stats_, rotations, 1);
+        uint32_t grand = Parent(dad);
+
+        if (nodes_[dad].right_ == child) {
+            uint32_t grandson = nodes_[child].left_;
+            nodes_[dad].right_ = grandson;
+            nodes_[child].left_ = dad;
+            if (grandson != kNil) { SetParent(grandson, dad); }
+        } else {
+            uint32_t grandson = nodes_[child].right_;
+            nodes_[dad].left_ = grandson;
+            nodes_[child].right_ = dad;
+            if (grandson != kNil) { SetParent(grandson, dad); }
+        }
+
+        SetParent(dad, child);
+        SetParent(child, grand);
+        Relink(grand, dad, child);
+    }
+    /// \}
+};
+
+#endif
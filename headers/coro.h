@@ -0,0 +1,332 @@
+/**
+ * \file  coro.h
+ * \brief C++20 coroutine primitives on top of ThreadPool: tasks, an executor hop and bounded queues.
+ *
+ * Provides:
+ * - Task<T>: A lazy coroutine that starts when it is awaited and resumes its awaiter when it finishes.
+ * - resumeOn(): An awaitable that continues the coroutine on a worker of a ThreadPool.
+ * - BoundedQueue<T>: A channel between coroutines; Push() suspends while the queue is full and
+ *   Pop() while it is empty, so a fast stage cannot run ahead of a slow one by more than the
+ *   capacity.
+ * - syncWaitAll(): Start a group of tasks and block the calling thread until all of them finish.
+ *
+ * Suspended coroutines are always resumed through ThreadPool::Post(), never while a lock of a
+ * queue is held.
+ */
+
+#ifndef CORO_H
+#define CORO_H
+
+#include "pool.h"
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+template <typename T = void>
+class Task;
+
+/// \brief Result slot of a Task promise: a value, or nothing for Task<void>.
+template <typename T>
+struct TaskResult {
+    optional<T> value_;
+
+    void return_value(T value) { value_ = std::move(value); }
+    T Take() { return std::move(*value_); }
+};
+
+template <>
+struct TaskResult<void> {
+    void return_void() {}
+    void Take() {}
+};
+
+/**
+ * \class Task
+ * \brief A lazy coroutine returning T.
+ *
+ * The body does not run until the task is awaited; the awaiting coroutine is resumed on the
+ * thread that finishes the body. An exception of the body is rethrown to the awaiter.
+ */
+template <typename T>
+class Task {
+public:
+    struct promise_type : TaskResult<T> {
+        exception_ptr error_;
+        coroutine_handle<> continuation_;
+
+        Task get_return_object() { return Task(coroutine_handle<promise_type>::from_promise(*this)); }
+        suspend_always initial_suspend() noexcept { return {}; }
+        void unhandled_exception() { error_ = current_exception(); }
+
+        /// \brief Transfer control to the awaiter without growing the stack.
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            coroutine_handle<> await_suspend(coroutine_handle<promise_type> self) noexcept {
+                coroutine_handle<> next = self.promise().continuation_;
+                return next ? next : noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept { return {}; }
+    };
+
+    Task() = default;
+    Task(Task&& other) noexcept : handle_(exchange(other.handle_, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            Destroy();
+            handle_ = exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+    ~Task() { Destroy(); }
+
+    auto operator co_await() noexcept {
+        struct Awaiter {
+            coroutine_handle<promise_type> handle_;
+
+            bool await_ready() noexcept { return !handle_ || handle_.done(); }
+            coroutine_handle<> await_suspend(coroutine_handle<> awaiter) noexcept {
+                handle_.promise().continuation_ = awaiter;
+                return handle_;
+            }
+            T await_resume() {
+                if (handle_.promise().error_) {
+                    rethrow_exception(handle_.promise().error_);
+                }
+                return handle_.promise().Take();
+            }
+        };
+        return Awaiter{ handle_ };
+    }
+
+private:
+    coroutine_handle<promise_type> handle_;
+
+    explicit Task(coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    void Destroy() {
+        if (handle_) {
+            handle_.destroy();
+            handle_ = nullptr;
+        }
+    }
+};
+
+/// \brief Awaitable that suspends the coroutine and resumes it on a worker of pool.
+struct ResumeOn {
+    ThreadPool& pool_;
+
+    bool await_ready() noexcept { return false; }
+    void await_suspend(coroutine_handle<> handle) { pool_.Post([handle] { handle.resume(); }); }
+    void await_resume() noexcept {}
+};
+
+inline ResumeOn resumeOn(ThreadPool& pool) { return ResumeOn{ pool }; }
+
+/**
+ * \class BoundedQueue
+ * \brief A closable FIFO channel of at most capacity items between coroutines.
+ *
+ * A waiting Pop() gets a pushed item directly; a waiting Push() places its item as soon as
+ * Pop() frees a slot. After Close(), Push() fails and Pop() drains the remaining items and
+ * then returns nothing. Waiters are resumed on the pool.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    /// \brief     Create an open queue.
+    /// \param capacity Largest number of items held, at least 1.
+    BoundedQueue(ThreadPool& pool, size_t capacity) : pool_(pool), capacity_(max<size_t>(capacity, 1)) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    struct PushAwaiter {
+        BoundedQueue& queue_;
+        T value_;
+        coroutine_handle<> handle_;
+        bool pushed_ = false;
+
+        bool await_ready() noexcept { return false; }
+
+        bool await_suspend(coroutine_handle<> handle) {
+            coroutine_handle<> wake;
+            {
+                lock_guard<std::mutex> lock(queue_.mutex_);
+                if (queue_.closed_) {
+                    return false;
+                }
+                pushed_ = true;
+
+                if (!queue_.poppers_.empty()) {
+                    PopAwaiter *popper = queue_.poppers_.front();
+                    queue_.poppers_.pop_front();
+                    popper->value_ = std::move(value_);
+                    wake = popper->handle_;
+                } else if (queue_.items_.size() < queue_.capacity_) {
+                    queue_.items_.push_back(std::move(value_));
+                } else {
+                    // From here on another thread may resume the coroutine: do not touch this awaiter.
+                    handle_ = handle;
+                    queue_.pushers_.push_back(this);
+                    return true;
+                }
+            }
+
+            queue_.Wake(wake);
+            return false;
+        }
+
+        /// \return false if the queue was closed and the value was dropped.
+        bool await_resume() noexcept { return pushed_; }
+    };
+
+    struct PopAwaiter {
+        BoundedQueue& queue_;
+        optional<T> value_;
+        coroutine_handle<> handle_;
+
+        bool await_ready() noexcept { return false; }
+
+        bool await_suspend(coroutine_handle<> handle) {
+            coroutine_handle<> wake;
+            {
+                lock_guard<std::mutex> lock(queue_.mutex_);
+                if (!queue_.items_.empty()) {
+                    value_ = std::move(queue_.items_.front());
+                    queue_.items_.pop_front();
+
+                    if (!queue_.pushers_.empty()) {
+                        PushAwaiter *pusher = queue_.pushers_.front();
+                        queue_.pushers_.pop_front();
+                        queue_.items_.push_back(std::move(pusher->value_));
+                        wake = pusher->handle_;
+                    }
+                } else if (!queue_.closed_) {
+                    handle_ = handle;
+                    queue_.poppers_.push_back(this);
+                    return true;
+                }
+            }
+
+            queue_.Wake(wake);
+            return false;
+        }
+
+        /// \return The next item, or nothing if the queue is closed and empty.
+        optional<T> await_resume() { return std::move(value_); }
+    };
+
+    /// \brief Awaitable that appends value, waiting for a free slot. Resumes with false if the queue is closed.
+    PushAwaiter Push(T value) { return PushAwaiter{ *this, std::move(value), {} }; }
+
+    /// \brief Awaitable that takes the first item, waiting for one. Resumes with nothing once closed and empty.
+    PopAwaiter Pop() { return PopAwaiter{ *this, {}, {} }; }
+
+    /// \brief Close the queue: waiting pushers fail, waiting poppers get nothing.
+    void Close() {
+        vector<coroutine_handle<>> wake;
+        {
+            lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            for (PushAwaiter *pusher : pushers_) {
+                pusher->pushed_ = false;
+                wake.push_back(pusher->handle_);
+            }
+            for (PopAwaiter *popper : poppers_) {
+                wake.push_back(popper->handle_);
+            }
+            pushers_.clear();
+            poppers_.clear();
+        }
+
+        for (coroutine_handle<> handle : wake) {
+            Wake(handle);
+        }
+    }
+
+private:
+    ThreadPool& pool_;
+    size_t capacity_;
+    std::mutex mutex_;
+    deque<T> items_;
+    deque<PushAwaiter*> pushers_;   ///< Suspended pushers, oldest first; only when items_ is full.
+    deque<PopAwaiter*> poppers_;    ///< Suspended poppers, oldest first; only when items_ is empty.
+    bool closed_ = false;
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+    void Wake(coroutine_handle<> handle) {
+        if (handle) {
+            pool_.Post([handle] { handle.resume(); });
+        }
+    }
+    /// \}
+};
+
+/**
+ * \brief Start tasks and block the calling thread until every one of them has finished.
+ *
+ * The tasks run concurrently as far as their awaits allow: each one runs on the calling thread
+ * until its first suspension, typically a co_await resumeOn(pool).
+ *
+ * \throws The first exception thrown by a task, after all of them have finished.
+ */
+inline void syncWaitAll(vector<Task<>>& tasks) {
+    struct Latch {
+        std::mutex mutex_;
+        condition_variable done_;
+        size_t left_;
+        exception_ptr error_;
+    } latch{ {}, {}, tasks.size(), {} };
+
+    // A coroutine that starts at once and frees its own frame at the end.
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() { return {}; }
+            suspend_never initial_suspend() noexcept { return {}; }
+            suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { terminate(); }
+        };
+    };
+
+    auto run = [](Task<>& task, Latch& latch) -> Detached {
+        exception_ptr error;
+        try {
+            co_await task;
+        } catch (...) {
+            error = current_exception();
+        }
+
+        lock_guard<std::mutex> lock(latch.mutex_);
+        if (error && !latch.error_) {
+            latch.error_ = error;
+        }
+        latch.left_ -= 1;
+        latch.done_.notify_all();
+    };
+
+    for (Task<>& task : tasks) {
+        run(task, latch);
+    }
+
+    unique_lock<std::mutex> lock(latch.mutex_);
+    latch.done_.wait(lock, [&] { return latch.left_ == 0; });
+    if (latch.error_) {
+        rethrow_exception(latch.error_);
+    }
+}
+
+#endif
@@ -6,6 +6,7 @@
 
 #include <string>
 #include <vector>
+#include "inline_key.h"
 
 using namespace std;
 
@@ -27,22 +28,24 @@ public:
 
     /// \name Getters
     /// @{
-    string GetName() const { return name_; }
-    string GetColor() const { return color_; }
-    string GetSmell() const { return smell_; }
-    vector<string> GetRegions() const { return regions_; }
+    const string& GetName() const { return name_; }
+    const InlineKey& GetKey() const { return key_; }
+    const string& GetColor() const { return color_; }
+    const string& GetSmell() const { return smell_; }
+    const vector<string>& GetRegions() const { return regions_; }
     /// @}
 
     /// \name Setters
     /// @{
-    void SetName(string name) { name_ = name; }
+    void SetName(string name) { name_ = name; key_.Assign(name_); }
     void SetColor(string color) { color_ = color; }
     void SetSmell(string smell) { smell_ = smell; }
     void SetRegions(vector<string> regions) { regions_ = regions; }
     /// @}
 
     /// \name Operator Overloading
-    /// \details Comparison based on key fields (name, color, smell).
+    /// \details Comparison based on the name; the inline key decides without reading the name
+    ///          unless both names are longer than InlineKey::kCapacity and share those bytes.
     /// @{
     bool operator>(const Flower& other) const;
     bool operator<(const Flower& other) const;
@@ -61,6 +64,17 @@ public:
     bool EqFlowers(const Flower& other) const;
 
 private:
+    /// \brief Three-way comparison of the names.
+    int CompareNames(const Flower& other) const {
+        int order = key_.Compare(other.key_);
+        if (order == 0 && key_.Truncated()) {
+            return name_.compare(other.name_);
+        }
+        return order;
+    }
+
+private:
+    InlineKey key_; ///< First bytes and length of the name, compared instead of the name.
     string name_;   ///< Name of the flower.
     string color_;  ///< Color of the flower.
     string smell_;  ///< Scent intensity ("strong", "moderate", "weak").
@@ -12,7 +12,10 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include <algorithm>
 #include "flower.h"
+#include "stats.h"
+#include "pool.h"
 
 /// \brief Size of the hash table
 #define SIZE 14
@@ -27,7 +30,7 @@ using namespace std;
  * \param key The input string to hash.
  * \return    An unsigned int in the range [0, SIZE-1], representing the hash-table index.
  */
-unsigned int hashFunc_rs(string key) {
+inline unsigned int hashFunc_rs(string key) {
     unsigned int a = 63689;
     unsigned int b = 378551;
     unsigned int hash = 0;
@@ -104,40 +107,59 @@ public:
     HashTable(const vector<Flower>& data) {
         NullTable();
 
+        count = 0;
+
+        for (size_t i = 0; i < data.size(); ++i) {
+            Insert(data[i]);
+        }
+    }
+
+    /**
+     * \brief Construct a hash table with a partitioned parallel build.
+     *
+     * 1. The bucket of every object is computed in parallel.
+     * 2. The buckets are split into one partition per thread, and one pass over the objects
+     *    lists the objects of every partition in input order.
+     * 3. Every partition inserts the objects of its list, so the chains and their order are the
+     *    same as after the sequential constructor and the total work stays O(n).
+     * 4. The counters of the partitions are merged.
+     *
+     * \param data A vector of Flower objects to insert into the hash table.
+     * \param pool Pool that runs the partitions.
+     */
+    HashTable(const vector<Flower>& data, ThreadPool& pool) {
+        NullTable();
+
         count = data.size();
 
-        for (size_t i = 0; i < count; ++i) {
-            string key = data[i].GetName();
-            Flower value = data[i];
-            unsigned int hash = hashFunc_rs(key);
+        vector<unsigned char> buckets(data.size());
+        pool.ParallelFor(data.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                buckets[i] = (unsigned char)hashFunc_rs(data[i].GetName());
+            }
+        });
 
-            if (!items_[hash]) {
-                items_[hash] = new Item(key, value);
-                unq_count += 1;
-            } else {
-                Item *where = items_[hash];
-                int is_collis = 1;
+        size_t parts = min<size_t>(pool.GetThreads(), SIZE);
+        vector<long long> unq(parts, 0), collis(parts, 0);
+        vector<IndexStats> stats(parts);
 
-                while (true) {
-                    if (key == where->key_) {
-                        where->values_->push_back(value);
-                        is_collis = 0;
-                        break;
-                    } else {
-                        if (where->next_) {
-                            where = where->next_;
-                        } else {
-                            break;
-                        }
-                    }
-                }
+        vector<vector<size_t>> members(parts);
+        for (size_t i = 0; i < data.size(); ++i) {
+            members[buckets[i] % parts].push_back(i);
+        }
 
-                if (is_collis) {
-                    collisions += 1;
-                    unq_count += 1;
-                    where->next_ = new Item(key, value);
+        pool.ParallelFor(parts, [&](size_t begin, size_t end) {
+            for (size_t p = begin; p < end; ++p) {
+                for (size_t i : members[p]) {
+                    SupportInsert(data[i], buckets[i], stats[p], unq[p], collis[p]);
                 }
             }
+        });
+
+        for (size_t p = 0; p < parts; ++p) {
+            unq_count += unq[p];
+            collisions += collis[p];
+            stats_.Merge(stats[p]);
         }
     }
 
@@ -148,6 +170,124 @@ public:
         }
     }
 
+    /**
+     * \brief Insert one Flower object into the hash table.
+     *
+     * Follows the same steps as the constructor: append to the Item with the same key,
+     * or create a new Item at the end of the chain (counting a collision if the chain was not empty).
+     *
+     * \param value The Flower object to insert.
+     */
+    void Insert(const Flower& value) {
+        count += 1;
+        SupportInsert(value, hashFunc_rs(value.GetName()), stats_, unq_count, collisions);
+    }
+
+    /**
+     * \brief Insert a batch of Flower objects sorted by name.
+     *
+     * Every run of equal names costs one chain walk: the run is appended to the Item of
+     * the name, or a new Item is created for it at the end of the chain, as Insert() does.
+     *
+     * \param sorted Pointers to the objects, stably sorted by name.
+     */
+    void MergeSorted(const vector<const Flower*>& sorted) {
+        for (size_t i = 0; i < sorted.size(); ) {
+            const string& key = sorted[i]->GetName();
+            Item **link = SupportLink(key);
+
+            if (!*link) {
+                if (items_[hashFunc_rs(key)]) {
+                    collisions += 1;
+                }
+                *link = new Item(key, *sorted[i]);
+                STAT_ADD(stats_, allocations, 2);
+                unq_count += 1;
+            } else {
+                (*link)->values_->push_back(*sorted[i]);
+            }
+            count += 1;
+
+            for (i += 1; i < sorted.size() && sorted[i]->GetName() == key; ++i) {
+                (*link)->values_->push_back(*sorted[i]);
+                count += 1;
+            }
+        }
+    }
+
+    /**
+     * \brief Remove all Flower objects with a given key.
+     *
+     * The Item of the key is unlinked from its chain and freed. The collision counter
+     * describes the inserts and is not decreased.
+     *
+     * \param key The string key to remove.
+     * \return    Number of removed objects.
+     */
+    size_t Remove(const string& key) {
+        Item **link = SupportLink(key);
+        if (!*link) {
+            return 0;
+        }
+
+        Item *item = *link;
+        size_t removed = item->values_->size();
+        *link = item->next_;
+
+        count -= removed;
+        unq_count -= 1;
+        delete item->values_;
+        delete item;
+
+        return removed;
+    }
+
+    /**
+     * \brief Remove one Flower object: the first one with a given key for which match returns true.
+     *
+     * The object is erased from the vector of its Item; the Item is unlinked by Remove() only
+     * when it held nothing else.
+     *
+     * \param key   The string key of the object.
+     * \param match Predicate that picks the object among those with the key.
+     * \return      true if an object was removed.
+     */
+    template <typename Match>
+    bool RemoveOne(const string& key, Match match) {
+        Item *item = *SupportLink(key);
+        if (!item) {
+            return false;
+        }
+
+        vector<Flower>& values = *item->values_;
+        auto it = find_if(values.begin(), values.end(), match);
+        if (it == values.end()) {
+            return false;
+        }
+        if (values.size() == 1) {
+            Remove(key);
+        } else {
+            values.erase(it);
+            count -= 1;
+        }
+        return true;
+    }
+
+    /**
+     * \brief Replace all Flower objects with the key of value by value, or insert it if there are none.
+     * \param value The new Flower object.
+     */
+    void Upsert(const Flower& value) {
+        Item *item = *SupportLink(value.GetName());
+        if (!item) {
+            Insert(value);
+            return;
+        }
+
+        count += 1 - (long long)item->values_->size();
+        item->values_->assign(1, value);
+    }
+
     /**
      * \brief Search for all Flower objects associated with a given key.
      *
@@ -159,8 +299,11 @@ public:
         vector<Flower> *res = nullptr;
 
         unsigned int hash = hashFunc_rs(key);
+        STAT_ADD(stats_, probes, 1);
         Item *cur = items_[hash];
         while(cur) {
+            STAT_ADD(stats_, nodes_visited, 1);
+            STAT_ADD(stats_, comparisons, 1);
             if (cur->key_ == key) {
                 res = cur->values_;
                 break;
@@ -171,11 +314,70 @@ public:
         return res;
     }
 
+    /**
+     * \brief Search for many keys at once, walking every chain at most once.
+     *
+     * 1. Hash all keys and group them by bucket (a counting sort, so every group keeps the
+     *    order of keys).
+     * 2. Walk the chain of every bucket that has keys once; an item is looked up among the
+     *    sorted keys of its bucket by binary search, and the walk stops when all of them
+     *    are found.
+     *
+     * With few buckets and many keys this replaces one chain walk per key by one per bucket.
+     *
+     * \param keys Keys sorted by string order, without repeats.
+     * \return     For every key, the vector of its objects, or nullptr.
+     */
+    vector<vector<Flower>*> SearchBatch(const vector<string>& keys) const {
+        vector<vector<Flower>*> res(keys.size(), nullptr);
+
+        vector<unsigned char> buckets(keys.size());
+        size_t starts[SIZE + 1] = {};
+        for (size_t k = 0; k < keys.size(); ++k) {
+            buckets[k] = (unsigned char)hashFunc_rs(keys[k]);
+            starts[buckets[k] + 1] += 1;
+        }
+        for (int i = 0; i < SIZE; ++i) {
+            starts[i + 1] += starts[i];
+        }
+
+        vector<size_t> order(keys.size());
+        size_t fill[SIZE];
+        copy(starts, starts + SIZE, fill);
+        for (size_t k = 0; k < keys.size(); ++k) {
+            order[fill[buckets[k]]++] = k;
+        }
+
+        for (int i = 0; i < SIZE; ++i) {
+            size_t left = starts[i + 1] - starts[i];
+            if (left == 0) {
+                continue;
+            }
+
+            STAT_ADD(stats_, probes, 1);
+            auto first = order.begin() + starts[i], last = order.begin() + starts[i + 1];
+            for (Item *cur = items_[i]; cur && left; cur = cur->next_) {
+                STAT_ADD(stats_, nodes_visited, 1);
+                auto it = lower_bound(first, last, cur->key_, [&](size_t k, const string& name) { return keys[k] < name; });
+                STAT_ADD(stats_, comparisons, 1);
+                if (it != last && keys[*it] == cur->key_) {
+                    res[*it] = cur->values_;
+                    left -= 1;
+                }
+            }
+        }
+
+        return res;
+    }
+
     long long GetCount() { return count; }
     long long GetCountUnq() { return unq_count; }
     long long GetCollisions() { return collisions; }
     Item** GetItems() { return items_; }
 
+    /// \brief Instrumentation counters, see stats.h; nodes_visited counts chain items.
+    IndexStats& GetStats() { return stats_; }
+
     /// @brief Print the contents of the hash table to stdout.
     void GetTable() {
         for (int i = 0; i < SIZE; ++i) {
@@ -201,6 +403,7 @@ private:
     long long count;            ///< Total number of Flower objects inserted.
     long long unq_count = 0;    ///< number of unique keys
     long long collisions = 0;   ///< Number of collisions detected during insertion.
+    mutable IndexStats stats_;  ///< Instrumentation counters, updated by const searches too.
 
 private:
     /// @brief   Initializes all buckets to nullptr.
@@ -210,6 +413,70 @@ private:
         }
     }
     
+    /// \brief The link (bucket head or next_ of an Item) to the Item of key, or to the end of its chain.
+    Item** SupportLink(const string& key) {
+        STAT_ADD(stats_, probes, 1);
+        Item **link = &items_[hashFunc_rs(key)];
+
+        while (*link) {
+            STAT_ADD(stats_, nodes_visited, 1);
+            STAT_ADD(stats_, comparisons, 1);
+            if ((*link)->key_ == key) {
+                break;
+            }
+            link = &(*link)->next_;
+        }
+
+        return link;
+    }
+
+    /**
+     * \brief Insert one object into bucket hash and update the given counters.
+     *
+     * \param value      The Flower object to insert.
+     * \param hash       Bucket of its key.
+     * \param stats      Instrumentation counters to update.
+     * \param unq        Number of unique keys, incremented for a new key.
+     * \param collis     Number of collisions, incremented when a new key joins a non-empty chain.
+     */
+    void SupportInsert(const Flower& value, unsigned int hash, [[maybe_unused]] IndexStats& stats, long long& unq,
+                       long long& collis) {
+        const string& key = value.GetName();
+        STAT_ADD(stats, probes, 1);
+
+        if (!items_[hash]) {
+            items_[hash] = new Item(key, value);
+            STAT_ADD(stats, allocations, 2);
+            unq += 1;
+        } else {
+            Item *where = items_[hash];
+            int is_collis = 1;
+
+            while (true) {
+                STAT_ADD(stats, nodes_visited, 1);
+                STAT_ADD(stats, comparisons, 1);
+                if (key == where->key_) {
+                    where->values_->push_back(value);
+                    is_collis = 0;
+                    break;
+                } else {
+                    if (where->next_) {
+                        where = where->next_;
+                    } else {
+                        break;
+                    }
+                }
+            }
+
+            if (is_collis) {
+                collis += 1;
+                unq += 1;
+                where->next_ = new Item(key, value);
+                STAT_ADD(stats, allocations, 2);
+            }
+        }
+    }
+
     /// @brief Recursively deletes a linked list of Items starting from `cur`.
     void SupportDelete(Item *cur) {
         while (cur) {
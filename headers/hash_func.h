@@ -0,0 +1,65 @@
+/// \file hash_func.h
+/// \brief Seeded 64-bit string hashing shared by the static indexes and filters.
+///
+/// Provides:
+/// - hashFunc_mix: A fast 64-bit hash of a string with a caller-supplied seed.
+/// - mix64: A bit finalizer used to derive independent values from one hash.
+
+#ifndef HASH_FUNC_H
+#define HASH_FUNC_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+/**
+ * \brief Finalize a 64-bit value so that every input bit affects every output bit.
+ *
+ * This is the finalizer of SplitMix64 / MurmurHash3.
+ *
+ * \param x Value to mix.
+ * \return  The mixed value.
+ */
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * \brief Compute a seeded 64-bit hash of a string.
+ *
+ * The key is consumed eight bytes at a time, every word is folded into the state
+ * with a multiply-xor step, and the result is finalized with mix64(). Different seeds
+ * give (practically) independent hash functions, which the perfect hash needs.
+ *
+ * \param key  The input string to hash.
+ * \param seed Seed that selects the hash function.
+ * \return     A 64-bit hash value.
+ */
+inline uint64_t hashFunc_mix(const string& key, uint64_t seed = 0) {
+    const char *p = key.data();
+    size_t len = key.size();
+    uint64_t hash = seed ^ (len * 0x9e3779b97f4a7c15ULL);
+
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        hash = (hash ^ mix64(word)) * 0x9e3779b97f4a7c15ULL;
+        p += 8;
+        len -= 8;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, p, len);
+    hash = (hash ^ mix64(tail)) * 0x9e3779b97f4a7c15ULL;
+
+    return mix64(hash);
+}
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ * \file  in_list.h
+ * \brief IN-list lookups: many names answered by one merged pass over an index.
+ *
+ * A lookup of m names through m calls to Search() pays m full searches. The functions here
+ * sort and dedupe the names once and then walk the index left to right: a finger search
+ * over the RB tree (RBTree::SearchSorted()), a galloping search over the sorted array
+ * (SortedIndex::SearchSorted()), or one walk per bucket of the hash table
+ * (HashTable::SearchBatch()). The cost is close to linear in the names plus the matches.
+ */
+
+#ifndef IN_LIST_H
+#define IN_LIST_H
+
+#include "flower.h"
+#include "rb_tree.h"
+#include "hash.h"
+#include "sorted_index.h"
+#include "rows.h"
+
+#include <span>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// \brief The matches of one name of an IN-list.
+template <typename Rows>
+struct KeyGroup {
+    string key_;
+    Rows rows_;     ///< Never empty.
+};
+
+/// \brief The names of an IN-list in string order (the order of the indexes), every name once.
+vector<string> inListKeys(const vector<string>& keys);
+
+/// \brief     The rows of every name of keys found in tree.
+/// \param keys Names in any order, possibly repeated.
+/// \return    One group per distinct name that has rows, in name order.
+vector<KeyGroup<span<const Flower>>> searchIn(RBTree<Flower>& tree, const vector<string>& keys);
+
+/// \brief The rows of every name of keys found in table, as searchIn() for the RB tree.
+vector<KeyGroup<span<const Flower>>> searchIn(const HashTable& table, const vector<string>& keys);
+
+/// \brief The row ids of every name of keys found in index, as searchIn() for the RB tree.
+vector<KeyGroup<RowRange>> searchIn(const SortedIndex& index, const vector<string>& keys);
+
+#endif
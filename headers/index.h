@@ -0,0 +1,455 @@
+/**
+ * \file  index.h
+ * \brief Unified, statically dispatched search interface over all indexes and a cost-based planner.
+ *
+ * Provides:
+ * - SearchIndex: The concept every index view satisfies: Lookup(key) returns a lazy range of
+ *   const Flower&, Cost() estimates the price of a lookup, Available() tells if it may be used.
+ * - LinearIndex, TreeIndex, RBTreeIndex, CompactRBTreeIndex, HashIndex, MultimapIndex, PerfectHashIndex, SortedArrayIndex,
+ *   LearnedArrayIndex:
+ *   Non-owning views that adapt the existing structures to the concept without copying rows.
+ * - RowSource: The rows behind the row ids of the static indexes: a vector, or a RowStore whose
+ *   erased rows are skipped.
+ * - TableStats: Cardinality and per-key selectivity of a dataset.
+ * - QueryPlanner: Picks the cheapest available index for every query and dispatches to it
+ *   without virtual calls.
+ */
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "flower.h"
+#include "binary_tree.h"
+#include "rb_tree.h"
+#include "compact_rb_tree.h"
+#include "hash.h"
+#include "mph.h"
+#include "sorted_index.h"
+#include "learned.h"
+#include "row_store.h"
+#include <cmath>
+#include <concepts>
+#include <limits>
+#include <map>
+#include <ranges>
+#include <span>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/// \brief A range whose elements can be read as const Flower&.
+template <typename Range>
+concept FlowerRange = ranges::input_range<Range> &&
+                      convertible_to<ranges::range_reference_t<Range>, const Flower&>;
+
+/**
+ * \brief Cardinality statistics of a dataset, collected once and used by the planner.
+ *
+ * The selectivity of a key is the share of rows with that name; a key that is not in
+ * the data has selectivity zero.
+ */
+class TableStats {
+public:
+    TableStats(const vector<Flower>& rows) : rows_(rows.size()) {
+        for (const Flower& flower : rows) {
+            counts_[flower.GetName()] += 1;
+        }
+    }
+
+    size_t GetRows() const { return rows_; }
+    size_t GetDistinct() const { return counts_.size(); }
+
+    /// \brief Expected number of rows with the name key.
+    double Matches(const string& key) const {
+        auto it = counts_.find(key);
+        return it == counts_.end() ? 0 : (double)it->second;
+    }
+
+    /// \brief Share of rows with the name key.
+    double Selectivity(const string& key) const { return rows_ ? Matches(key) / rows_ : 0; }
+
+private:
+    size_t rows_;
+    unordered_map<string, size_t> counts_;
+};
+
+/// \defgroup costs Unit costs of the planner cost model
+/// \{
+/// \brief Comparison of two names.
+#define COST_COMPARE 1.0
+/// \brief Following a pointer to a node that is probably not in cache.
+#define COST_NODE 4.0
+/// \brief Hashing a name.
+#define COST_HASH 8.0
+/// \brief Reading one matching row from a contiguous array.
+#define COST_ROW 1.0
+/// \}
+
+/**
+ * \brief The interface shared by all index views.
+ *
+ * - Lookup(key) returns a lazy range of the rows whose name is key; rows are produced while
+ *   the range is iterated, so a caller that only needs the first row does not pay for the rest.
+ *   The range refers to the index and to key, both must outlive it.
+ * - Cost(stats, matches) estimates the price of a lookup that returns matches rows, in the
+ *   units above.
+ * - Available() is false when the index must not answer queries (e.g. it is stale).
+ * - kName names the index in reports.
+ */
+template <typename Index>
+concept SearchIndex = requires(Index& index, const Index& cindex, const string& key, const TableStats& stats) {
+    { index.Lookup(key) } -> FlowerRange;
+    { cindex.Cost(stats, 1.0) } -> convertible_to<double>;
+    { cindex.Available() } -> convertible_to<bool>;
+    { Index::kName } -> convertible_to<const char*>;
+};
+
+/// \brief Full scan of the rows.
+class LinearIndex {
+public:
+    static constexpr const char *kName = "linear";
+
+    LinearIndex(const vector<Flower>& rows) : rows_(&rows) {}
+
+    auto Lookup(const string& key) const {
+        const string *name = &key;
+        return views::filter(*rows_, [name](const Flower& flower) { return flower.GetName() == *name; });
+    }
+
+    double Cost(const TableStats& stats, double) const { return stats.GetRows() * COST_COMPARE; }
+    bool Available() const { return true; }
+
+private:
+    const vector<Flower> *rows_;
+};
+
+/**
+ * \brief Binary search tree; equal rows form a chain through right subtrees.
+ *
+ * The range walks the chain lazily, every step is a search in the right subtree of the
+ * previous match.
+ */
+class TreeIndex {
+public:
+    static constexpr const char *kName = "binary";
+
+    /// \brief Lazy range over the matches of one lookup.
+    class Chain : public ranges::view_interface<Chain> {
+    public:
+        class Iterator {
+        public:
+            using value_type = Flower;
+            using difference_type = ptrdiff_t;
+
+            Iterator() = default;
+            Iterator(Tree<Flower> *tree, Node<Flower> *node) : tree_(tree), node_(node) {}
+
+            const Flower& operator*() const { return node_->value_; }
+            Iterator& operator++() {
+                node_ = tree_->Next(node_);
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+            bool operator==(default_sentinel_t) const { return node_ == nullptr; }
+
+        private:
+            Tree<Flower> *tree_ = nullptr;
+            Node<Flower> *node_ = nullptr;
+        };
+
+        Chain() = default;
+        Chain(Tree<Flower> *tree, Node<Flower> *first) : tree_(tree), first_(first) {}
+
+        Iterator begin() const { return Iterator(tree_, first_); }
+        default_sentinel_t end() const { return default_sentinel; }
+
+    private:
+        Tree<Flower> *tree_ = nullptr;
+        Node<Flower> *first_ = nullptr;
+    };
+
+    TreeIndex(Tree<Flower>& tree) : tree_(&tree) {}
+
+    Chain Lookup(const string& key) const {
+        return Chain(tree_, tree_->Search(Flower(key, "", "", {})));
+    }
+
+    /// The first match is one descent; every further match lies below the previous one, and in a
+    /// bulk-loaded tree (Tree::BuildSorted) it is its right child.
+    double Cost(const TableStats& stats, double matches) const {
+        return (log2((double)stats.GetRows() + 1) + matches) * (COST_NODE + COST_COMPARE);
+    }
+    bool Available() const { return true; }
+
+private:
+    Tree<Flower> *tree_;
+};
+
+/// \brief Red-black tree; all rows of a name are stored in one node.
+class RBTreeIndex {
+public:
+    static constexpr const char *kName = "rb";
+
+    RBTreeIndex(RBTree<Flower>& tree) : tree_(&tree) {}
+
+    span<const Flower> Lookup(const string& key) const {
+        RBNode<Flower> *node = tree_->SearchAll(Flower(key, "", "", {}));
+        return node ? span<const Flower>(node->values_) : span<const Flower>();
+    }
+
+    double Cost(const TableStats& stats, double matches) const {
+        return log2((double)stats.GetDistinct() + 1) * (COST_NODE + COST_COMPARE) + matches * COST_ROW;
+    }
+    bool Available() const { return true; }
+
+private:
+    RBTree<Flower> *tree_;
+};
+
+/// \brief Red-black tree with one cache line per node; a step costs a comparison and a node.
+class CompactRBTreeIndex {
+public:
+    static constexpr const char *kName = "rb_compact";
+
+    CompactRBTreeIndex(const CompactRBTree<Flower>& tree) : tree_(&tree) {}
+
+    span<const Flower> Lookup(const string& key) const {
+        const vector<Flower> *values = tree_->SearchAll(Flower(key, "", "", {}));
+        return values ? span<const Flower>(*values) : span<const Flower>();
+    }
+
+    /// The key is in the node, so a step reads one line instead of three.
+    double Cost(const TableStats& stats, double matches) const {
+        return log2((double)stats.GetDistinct() + 1) * (COST_NODE / 2 + COST_COMPARE) + COST_NODE + matches * COST_ROW;
+    }
+    bool Available() const { return true; }
+
+private:
+    const CompactRBTree<Flower> *tree_;
+};
+
+/// \brief Chained hash table with SIZE buckets.
+class HashIndex {
+public:
+    static constexpr const char *kName = "hash";
+
+    HashIndex(const HashTable& table) : table_(&table) {}
+
+    span<const Flower> Lookup(const string& key) const {
+        vector<Flower> *rows = table_->Search(key);
+        return rows ? span<const Flower>(*rows) : span<const Flower>();
+    }
+
+    /// A hit walks half of a chain on average.
+    double Cost(const TableStats& stats, double matches) const {
+        double chain = (double)stats.GetDistinct() / SIZE;
+        return COST_HASH + (1 + chain / 2) * (COST_NODE + COST_COMPARE) + matches * COST_ROW;
+    }
+    bool Available() const { return true; }
+
+private:
+    const HashTable *table_;
+};
+
+/// \brief std::multimap from name to row; matches are neighbouring tree nodes.
+class MultimapIndex {
+public:
+    static constexpr const char *kName = "multimap";
+
+    MultimapIndex(const multimap<string, Flower>& map) : map_(&map) {}
+
+    auto Lookup(const string& key) const {
+        auto range = map_->equal_range(key);
+        return ranges::subrange(range.first, range.second) | views::values;
+    }
+
+    double Cost(const TableStats& stats, double matches) const {
+        return log2((double)stats.GetRows() + 1) * (COST_NODE + COST_COMPARE) + matches * COST_NODE;
+    }
+    bool Available() const { return true; }
+
+private:
+    const multimap<string, Flower> *map_;
+};
+
+/**
+ * \brief The rows that the row ids of a static index refer to.
+ *
+ * Either the vector the index was built from, or a RowStore over it. The ids of erased rows
+ * stay in the index until the next compaction, so with a store they are skipped with IsLive();
+ * after a compaction the owner of the index applies the remap with Remap(). An index built over
+ * n rows sees all rows while the source has n row ids; an Update() appends a row it misses.
+ */
+class RowSource {
+public:
+    RowSource(const vector<Flower>& rows) : rows_(&rows) {}
+    RowSource(const RowStore& store) : store_(&store) {}
+
+    const Flower& Get(RowId id) const { return store_ ? store_->Get(id) : (*rows_)[id]; }
+    bool IsLive(RowId id) const { return !store_ || store_->IsLive(id); }
+    size_t GetCount() const { return store_ ? store_->GetCount() : rows_->size(); }
+
+    /// \brief Lazy range of the live rows of found.
+    auto Rows(RowRange found) const {
+        RowSource source = *this;
+        return ranges::subrange(found.begin(), found.end())
+             | views::filter([source](RowId id) { return source.IsLive(id); })
+             | views::transform([source](RowId id) -> const Flower& { return source.Get(id); });
+    }
+
+private:
+    const vector<Flower> *rows_ = nullptr;
+    const RowStore *store_ = nullptr;
+};
+
+/**
+ * \brief Minimal perfect hash over the rows it was built from.
+ *
+ * The fingerprint of a slot can accept a name that is not in the data, so the name of the
+ * first row is compared. The index is unavailable once rows has more row ids than at the build.
+ */
+class PerfectHashIndex {
+public:
+    static constexpr const char *kName = "mph";
+
+    PerfectHashIndex(const PerfectHash& mph, RowSource rows) : mph_(&mph), rows_(rows) {}
+
+    auto Lookup(const string& key) const {
+        RowRange found = mph_->Search(key);
+        if (!found.empty() && rows_.Get(found[0]).GetName() != key) {
+            found = RowRange();
+        }
+        return rows_.Rows(found);
+    }
+
+    /// Rows are reached through their ids, so every match is one extra indirection.
+    double Cost(const TableStats&, double matches) const {
+        return COST_HASH + 2 * COST_NODE + matches * (COST_ROW + COST_NODE / 2);
+    }
+    bool Available() const { return mph_->GetCount() == rows_.GetCount(); }
+
+private:
+    const PerfectHash *mph_;
+    RowSource rows_;
+};
+
+/// \brief Sorted array of name prefixes; a binary search over contiguous memory.
+class SortedArrayIndex {
+public:
+    static constexpr const char *kName = "sorted";
+
+    SortedArrayIndex(const SortedIndex& index, RowSource rows) : index_(&index), rows_(rows) {}
+
+    auto Lookup(const string& key) const { return rows_.Rows(index_->Search(key)); }
+
+    /// The steps of the search read neighbouring cache lines, so they cost a comparison each.
+    double Cost(const TableStats& stats, double matches) const {
+        return log2((double)stats.GetDistinct() + 1) * COST_COMPARE + COST_NODE + matches * (COST_ROW + COST_NODE / 2);
+    }
+    bool Available() const { return index_->GetCount() == rows_.GetCount(); }
+
+private:
+    const SortedIndex *index_;
+    RowSource rows_;
+};
+
+/// \brief Learned index; two model evaluations and a search of the error window of the model.
+class LearnedArrayIndex {
+public:
+    static constexpr const char *kName = "learned";
+
+    LearnedArrayIndex(const LearnedIndex& index, RowSource rows) : index_(&index), rows_(rows) {}
+
+    auto Lookup(const string& key) const { return rows_.Rows(index_->Search(key)); }
+
+    /// The window is searched like the sorted array; the models cost about one hash.
+    double Cost(const TableStats&, double matches) const {
+        return COST_HASH + log2(index_->GetMeanWindow() + 1) * COST_COMPARE + COST_NODE
+             + matches * (COST_ROW + COST_NODE / 2);
+    }
+    bool Available() const { return index_->GetCount() == rows_.GetCount(); }
+
+private:
+    const LearnedIndex *index_;
+    RowSource rows_;
+};
+
+/**
+ * \class QueryPlanner
+ * \brief Chooses the cheapest available index for every lookup and runs the lookup on it.
+ *
+ * The expected number of matches of the key comes from TableStats; every index turns it
+ * into a cost with its own model. The set of indexes is fixed at compile time, so the
+ * chosen index is called through a switch over the tuple, not through a virtual call.
+ *
+ * \tparam Indexes Index views, each satisfying SearchIndex.
+ */
+template <SearchIndex... Indexes>
+class QueryPlanner {
+public:
+    QueryPlanner(const TableStats& stats, Indexes... indexes)
+        : stats_(&stats), indexes_(indexes...), choices_(sizeof...(Indexes), 0) {}
+
+    /// \brief Number of the cheapest available index for key, or sizeof...(Indexes) if none is available.
+    size_t Plan(const string& key) const {
+        double matches = stats_->Matches(key);
+        double best_cost = numeric_limits<double>::infinity();
+        size_t best = sizeof...(Indexes);
+
+        size_t i = 0;
+        apply([&](const auto&... index) {
+            ((index.Available() && index.Cost(*stats_, matches) < best_cost
+                  ? (void)(best_cost = index.Cost(*stats_, matches), best = i)
+                  : (void)0, ++i), ...);
+        }, indexes_);
+
+        return best;
+    }
+
+    /**
+     * \brief Plan a lookup and pass its lazy result range to visit.
+     *
+     * \param key   The name to search for.
+     * \param visit Callable that accepts the range of every index and returns the same type for all.
+     * \return      What visit returned, or a value-initialized result if no index is available.
+     */
+    template <typename Visitor>
+    auto Lookup(const string& key, Visitor visit) {
+        size_t chosen = Plan(key);
+        if (chosen < choices_.size()) {
+            choices_[chosen] += 1;
+        }
+        return Dispatch(chosen, key, visit, index_sequence_for<Indexes...>());
+    }
+
+    /// \brief Name of the index with the given number.
+    static const char* Name(size_t i) {
+        static const char *names[] = { Indexes::kName... };
+        return names[i];
+    }
+
+    static constexpr size_t Count() { return sizeof...(Indexes); }
+
+    /// \brief How many lookups were sent to each index.
+    const vector<long long>& GetChoices() const { return choices_; }
+
+private:
+    const TableStats *stats_;
+    tuple<Indexes...> indexes_;
+    vector<long long> choices_;
+
+private:
+    template <typename Visitor, size_t... I>
+    auto Dispatch(size_t chosen, const string& key, Visitor& visit, index_sequence<I...>) {
+        using Result = decltype(visit(get<0>(indexes_).Lookup(key)));
+        Result res{};
+        ((chosen == I ? (void)(res = visit(get<I>(indexes_).Lookup(key))) : (void)0), ...);
+        return res;
+    }
+};
+
+#endif
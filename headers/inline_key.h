@@ -0,0 +1,110 @@
+/// \file inline_key.h
+/// \brief Defines a fixed-capacity key that keeps the first bytes of a string in place.
+///
+/// Provides:
+/// - InlineKey: The first 32 bytes of a string, zero padded, and its length; compared with
+///   vector instructions and without reading the string itself.
+
+#ifndef INLINE_KEY_H
+#define INLINE_KEY_H
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/**
+ * \class InlineKey
+ * \brief The first kCapacity bytes of a string with the length of the whole string.
+ *
+ * Two keys are ordered like the strings they were made from (byte-wise, as string::compare)
+ * by one 32-byte comparison: a mask of the differing bytes gives the first difference, and
+ * equal bytes are ordered by length. Only when both strings are longer than kCapacity and
+ * their first kCapacity bytes are equal the key cannot decide; Compare() then returns 0 and
+ * the owner of the strings compares them in full (see Truncated()).
+ */
+class InlineKey {
+public:
+    static const size_t kCapacity = 32;
+
+    /// \defgroup constructors
+    /// \{
+    InlineKey() = default;
+
+    explicit InlineKey(const string& key) { Assign(key); }
+    /// \}
+
+    /// \brief Replace the key by the first bytes of key.
+    void Assign(const string& key) {
+        size_ = (uint32_t)key.size();
+        memset(bytes_, 0, kCapacity);
+        memcpy(bytes_, key.data(), key.size() < kCapacity ? key.size() : kCapacity);
+    }
+
+    /// \brief Length of the whole string.
+    size_t Size() const { return size_; }
+
+    /// \brief Whether the string did not fit, so equal keys do not mean equal strings.
+    bool Truncated() const { return size_ > kCapacity; }
+
+    /**
+     * \brief Three-way comparison of the strings behind the keys.
+     *
+     * \return A negative value, zero or a positive value if this string is less than, equal to
+     *         or greater than the other; zero is also returned when both keys are truncated and
+     *         their stored bytes are equal.
+     */
+    int Compare(const InlineKey& other) const {
+        uint32_t diff = DiffMask(other);
+        if (diff != 0) {
+            size_t i = __builtin_ctz(diff);
+            if (i < size_ && i < other.size_) {
+                return (int)(unsigned char)bytes_[i] - (int)(unsigned char)other.bytes_[i];
+            }
+        }
+
+        if (size_ > kCapacity && other.size_ > kCapacity) {
+            return 0;
+        }
+        return size_ < other.size_ ? -1 : (size_ > other.size_ ? 1 : 0);
+    }
+
+private:
+    char bytes_[kCapacity] = {};   ///< First bytes of the string, zero padded.
+    uint32_t size_ = 0;            ///< Length of the whole string.
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+
+    /// \brief Bit i is set if byte i of the keys differs.
+    uint32_t DiffMask(const InlineKey& other) const {
+#if defined(__AVX2__)
+        __m256i l = _mm256_loadu_si256((const __m256i*)bytes_);
+        __m256i r = _mm256_loadu_si256((const __m256i*)other.bytes_);
+        return ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(l, r));
+#elif defined(__SSE2__)
+        __m128i l0 = _mm_loadu_si128((const __m128i*)bytes_);
+        __m128i l1 = _mm_loadu_si128((const __m128i*)(bytes_ + 16));
+        __m128i r0 = _mm_loadu_si128((const __m128i*)other.bytes_);
+        __m128i r1 = _mm_loadu_si128((const __m128i*)(other.bytes_ + 16));
+        uint32_t equal = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(l0, r0))
+                       | (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(l1, r1)) << 16;
+        return ~equal;
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kCapacity; ++i) {
+            mask |= (uint32_t)(bytes_[i] != other.bytes_[i]) << i;
+        }
+        return mask;
+#endif
+    }
+    /// \}
+};
+
+#endif
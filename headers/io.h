@@ -8,6 +8,8 @@
 #define IO_H
 
 #include "flower.h"
+#include "workload.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -32,22 +34,106 @@ using namespace std;
 /// If the file contains no data lines (only a header or is empty), an empty vector is returned.
 vector<Flower> parserCSV(string filename);
 
+/// \brief          Reads the complete lines of a growing CSV file that follow a byte offset.
+/// \param filename Path to the CSV file.
+/// \param offset   Byte offset to start at, 0 for the start of the file (the header is skipped);
+///                 advanced past the last line read.
+/// \param max_rows Largest number of rows to read.
+/// \throws         runtime_error if the file cannot be opened.
+/// \return         Vector of Flower objects of the lines read, in file order.
+///
+/// \details
+/// Lines are parsed as by parserCSV(). A last line without a newline may still be being written,
+/// so it is left for the next call, which continues from the returned offset.
+vector<Flower> parserCSVTail(const string& filename, size_t& offset, size_t max_rows = SIZE_MAX);
+
+/// \brief        Parses a block of data lines of a dataset CSV and appends the rows to out.
+/// \param data   The lines; every line but the last must end with a newline.
+/// \param size   Number of bytes in data.
+/// \param out    Vector the Flower objects are appended to, in line order.
+///
+/// \details
+/// Lines are parsed as by parserCSV(); the block must not contain the header.
+void parserCSVChunk(const char *data, size_t size, vector<Flower>& out);
+
 /**
  * \brief Run multiple search algorithms on a dataset of Flower objects and save results to files.
  *
  * This function performs the following steps:
- *  1. Measures and records execution time for linear search, binary search tree search,
- *     red-black tree search, hash table search, and multimap search.
+ *  1. Benchmarks linear search, binary search tree search, red-black tree search, hash table search,
+ *     multimap search, minimal perfect hash search, sorted array search, learned index search,
+ *     compact red-black tree search and splay tree search with runWorkload(), driving every structure through the
+ *     same workload, and records the mean read latency of every structure. Inserts of the workload are applied
+ *     to every structure that supports them (the perfect hash, the sorted array and the learned index
+ *     are static and skip them); such a workload is run once, without warm-up, so that every insert lands
+ *     once, and the mean insert latency of the mutable structures is written on a line of its own.
+ *     The linear search only runs the first LINEAR_QUERIES operations.
  *  2. Writes matching records for each algorithm into separate output files named:
- *     "<size>_linear.txt", "<size>_binary.txt", "<size>_rb.txt", "<size>_hash.txt", "<size>_multimap.txt".
+ *     "<size>_linear.txt", "<size>_binary.txt", "<size>_rb.txt", "<size>_hash.txt", "<size>_multimap.txt",
+ *     "<size>_mph.txt", "<size>_sorted.txt", "<size>_learned.txt", "<size>_rb_compact.txt",
+ *     "<size>_splay.txt". The files are
+ *     formatted into ResultSink buffers and written by a background SinkWriter, so disk writes overlap
+ *     the following searches.
  *  3. Appends timing information (and collision count for hash) into "info_time.txt".
+ *     A QueryPlanner over all the structures is benchmarked on the read operations of the same
+ *     workload, and the number of lookups it sent to each structure is recorded. Its statistics and
+ *     scan cover the rows inserted by the workload, and the static indexes, which miss them, are
+ *     unavailable to it after any insert. The RB tree and a
+ *     freshly bulk-loaded splay tree are compared on read-only workloads of the ZIPF_SKEWS skews.
+ *  4. Builds a Bloom filter over the names, measures its false-positive rate on absent keys
+ *     and the average miss latency of every structure with and without the filter in front.
+ *     Times an IN-list of the distinct names among IN_LIST_KEYS keys, half of them absent, through
+ *     the RB tree, the hash table and the sorted array, as one search per name and as one searchIn() pass.
+ *  5. Sends the workload through a ResultCache in front of the linear search (inserts invalidate
+ *     the cached key) and records the hit ratio and the latency of a cached hot key.
+ *  6. Appends the mean, p50, p99 and p99.9 latency of every structure to "bench.csv" and "bench.jsonl".
+ *  7. Builds the BST, RB tree, hash table, multimap, perfect hash, sorted array, learned index and
+ *     compact RB tree and splay tree concurrently with a BuildScheduler: the ordered structures are bulk-loaded from one parallel stable sort of the
+ *     rows, the hash table uses a partitioned build. Records the wall time of the parallel build,
+ *     then the build time and the peak and steady heap footprint of every structure, measured with
+ *     a BuildMeter, and appends them to "build.csv".
+ *  8. When compiled with SEARCH_STATS, dumps the build and query instrumentation counters of the
+ *     BST, RB tree, hash table, perfect hash, sorted array, learned index, compact RB tree and splay
+ *     tree to "info_time.txt" and "stats.csv".
+ *  9. Upserts UPDATE_QUERIES new keys into the BST, both RB trees and the hash table, upserts them
+ *     again (replacing their rows) and removes them, recording the mean latency of each step. Updates
+ *     and erases rows of a RowStore over the dataset, half of them while a compaction runs, and
+ *     records their latency, the time of the compaction and the rows that a perfect hash, a sorted
+ *     array and a learned index read through the store find before and after it. Records how inserts
+ *     of all rows and lookups of the workload reads scale over SCALING_THREADS threads in a SkipList
+ *     with lock-free inserts and in an RB tree behind one mutex, both lookups visiting every row of
+ *     the name. Streams the dataset WINDOW_PASSES times through a WindowIndex of about one dataset
+ *     and records the append and search latency and its heap footprint after two passes and at the
+ *     end, then through a window bounded by WINDOW_MAX_AGE seconds at one dataset per second and
+ *     records the append and expiry latency and the rows left.
+ * 10. Projects the dataset into a dictionary-coded ColumnStore and records its size and the rows per
+ *     second of a filtered count and three group-by queries (rows per name, colors per region,
+ *     strong-smelling rows per region).
  *
- * \param source Reference to a vector of Flower objects to be searched.
- * \param size   Number of elements in the source vector (expected to match source.size()).
- * \param target The Flower object to search for.
+ * \param source   Reference to a vector of Flower objects to be searched.
+ * \param size     Number of elements in the source vector (expected to match source.size()).
+ * \param target   The Flower object whose matches are written to the output files.
+ * \param workload Operations used to benchmark every structure, see makeWorkload() and loadTrace().
  *
  * \throws std::runtime_error If any output file cannot be opened for writing.
  */
-void saveRes(vector<Flower>& source, long size, Flower target);
+void saveRes(vector<Flower>& source, long size, Flower target, const vector<Operation>& workload);
+
+/**
+ * \brief Ingest a CSV file into live indexes over a dataset and record the cost.
+ *
+ * Builds LiveIndexes over source, ingests the rows of path in batches of batch_rows and
+ * appends to "info_time.txt" the number of rows and batches, the ingest time and, for
+ * comparison, the time of building the same indexes over all rows from scratch. Then updates
+ * and erases UPDATE_QUERIES rows each, the second half while a compaction runs, and records
+ * their latency and the number of rows left in the indexes next to the live rows of the store.
+ *
+ * \param source     Rows of the base dataset.
+ * \param path       CSV file with the new rows.
+ * \param batch_rows Number of rows merged at once.
+ *
+ * \throws std::runtime_error If a file cannot be opened.
+ */
+void saveIngest(vector<Flower>& source, const string& path, size_t batch_rows);
 
 #endif
\ No newline at end of file
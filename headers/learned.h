@@ -0,0 +1,366 @@
+/// \file learned.h
+/// \brief Defines a read-only learned index (a two-stage recursive model index) over the names of a dataset.
+///
+/// Provides:
+/// - LearnedIndex: Linear models that predict the position of a name in a sorted array,
+///   followed by a search bounded by the recorded error of the model.
+
+#ifndef LEARNED_H
+#define LEARNED_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include "flower.h"
+#include "rows.h"
+#include "sorted_index.h"
+#include "stats.h"
+
+using namespace std;
+
+/**
+ * \class LearnedIndex
+ * \brief Static index that computes where a name is instead of descending a tree to it.
+ *
+ * The distinct names are sorted and encoded by keyPrefix(). The position of the first
+ * entry with a given prefix is approximated by two stages of linear models:
+ * - the root model maps the prefix to one of the leaf models;
+ * - the leaf model maps the prefix to a position and stores the largest errors it made
+ *   on the training prefixes below and above that position.
+ *
+ * A lookup evaluates two models and binary searches only the error window. Names that
+ * share their prefix form a run that is searched by full name, as in SortedIndex.
+ *
+ * Row ids of one name are stored contiguously, in increasing order, so a hit is returned
+ * as a RowRange into the index.
+ */
+class LearnedIndex {
+public:
+    /// \defgroup constructors
+    /// \{
+    LearnedIndex() = default;
+
+    /// \brief Build the index over the names of data, see Build().
+    LearnedIndex(const vector<Flower>& data, size_t leaves = 0) { Build(data, leaves); }
+    /// \}
+
+    /**
+     * \brief Build the index over the names of data, replacing the previous contents.
+     *
+     * 1. Stably sort the row ids by name and emit one entry per distinct name.
+     * 2. Fit the root model on (prefix, leaf) pairs of the distinct prefixes.
+     * 3. Fit every leaf model on the prefixes the root model sends to it and record its errors.
+     *
+     * \param data   A vector of Flower objects, the row id of an object is its position.
+     * \param leaves Number of leaf models; 0 chooses one per 16 distinct names.
+     */
+    void Build(const vector<Flower>& data, size_t leaves = 0) {
+        rows_.resize(data.size());
+        for (size_t i = 0; i < data.size(); ++i) {
+            rows_[i] = (RowId)i;
+        }
+        stable_sort(rows_.begin(), rows_.end(), [&](RowId l, RowId r) { return data[l].GetName() < data[r].GetName(); });
+
+        prefixes_.clear();
+        ranges_.clear();
+        keys_.clear();
+        for (size_t i = 0; i < rows_.size(); ++i) {
+            const string& name = data[rows_[i]].GetName();
+            if (keys_.empty() || keys_.back() != name) {
+                prefixes_.push_back(keyPrefix(name));
+                ranges_.push_back((uint32_t)i);
+                keys_.push_back(name);
+            }
+        }
+        ranges_.push_back((uint32_t)rows_.size());
+
+        Train(leaves ? leaves : max<size_t>(1, prefixes_.size() / 16));
+    }
+
+    /**
+     * \brief Search for all rows with a given name.
+     *
+     * \param key The name to search for.
+     * \return    The row ids of the name, or an empty range if it is not in the index.
+     */
+    RowRange Search(const string& key) const {
+        RowRange res;
+        if (prefixes_.empty()) {
+            return res;
+        }
+
+        uint64_t prefix = keyPrefix(key);
+        size_t lo, hi;
+        Window(prefix, lo, hi);
+        STAT_ADD(stats_, probes, 1);
+
+        size_t i = lower_bound(prefixes_.begin() + lo, prefixes_.begin() + hi, prefix) - prefixes_.begin();
+        if (i == prefixes_.size() || prefixes_[i] != prefix) {
+            return res;
+        }
+
+        // Names longer than the prefix may share it: binary search the run by full name.
+        if (i + 1 < prefixes_.size() && prefixes_[i + 1] == prefix) {
+            size_t end = upper_bound(prefixes_.begin() + i + 1, prefixes_.end(), prefix) - prefixes_.begin();
+            i = lower_bound(keys_.begin() + i, keys_.begin() + end, key) - keys_.begin();
+            if (i == end) {
+                return res;
+            }
+        }
+
+        STAT_ADD(stats_, comparisons, 1);
+        if (keys_[i] == key) {
+            res.begin_ = rows_.data() + ranges_[i];
+            res.end_ = rows_.data() + ranges_[i + 1];
+        }
+
+        return res;
+    }
+
+    /**
+     * \brief Move the row ids to their ids after a RowStore compaction, see remapRowIds().
+     *
+     * The names stay; a name whose rows were all dropped is found with an empty range.
+     *
+     * \param remap New id of every old id, NO_ROW for dropped rows.
+     */
+    void Remap(const vector<RowId>& remap) {
+        vector<uint32_t> moved = remapRowIds(rows_, remap);
+        for (uint32_t& start : ranges_) {
+            start = moved[start];
+        }
+    }
+
+    /// \brief Instrumentation counters, see stats.h; probes count model evaluations.
+    IndexStats& GetStats() { return stats_; }
+
+    size_t GetCountUnq() const { return prefixes_.size(); }
+    size_t GetCount() const { return rows_.size(); }
+
+    /// \brief Number of bytes used by the root and leaf models.
+    size_t GetModelBytes() const { return sizeof(root_) + leaves_.size() * sizeof(Leaf); }
+
+    /// \brief Number of bytes used by the models, prefixes, name ranges and row ids (the names are not counted).
+    size_t GetBytes() const {
+        return GetModelBytes() + prefixes_.size() * sizeof(uint64_t) + ranges_.size() * sizeof(uint32_t)
+             + rows_.size() * sizeof(RowId);
+    }
+
+    /// \brief Mean distance between the predicted and the true position of a distinct name prefix.
+    double GetMeanDistance() const { return mean_distance_; }
+
+    /// \brief Mean size of the window searched after the prediction, over the distinct name prefixes.
+    double GetMeanWindow() const { return mean_window_; }
+
+    /**
+     * \brief Write the index to a binary stream.
+     * \param out Stream opened in binary mode.
+     */
+    void Save(ostream& out) const {
+        uint64_t header[5] = { kMagic, leaves_.size(), prefixes_.size(), rows_.size(), 0 };
+        double stats[2] = { mean_distance_, mean_window_ };
+
+        out.write((const char*)header, sizeof(header));
+        out.write((const char*)&root_, sizeof(root_));
+        out.write((const char*)stats, sizeof(stats));
+        out.write((const char*)leaves_.data(), leaves_.size() * sizeof(Leaf));
+        out.write((const char*)prefixes_.data(), prefixes_.size() * sizeof(uint64_t));
+        out.write((const char*)ranges_.data(), ranges_.size() * sizeof(uint32_t));
+        out.write((const char*)rows_.data(), rows_.size() * sizeof(RowId));
+
+        for (const string& key : keys_) {
+            uint32_t length = (uint32_t)key.size();
+            out.write((const char*)&length, sizeof(length));
+            out.write(key.data(), length);
+        }
+    }
+
+    /**
+     * \brief Read an index written by Save().
+     * \param in Stream opened in binary mode.
+     * \throws   runtime_error if the stream does not contain a saved index.
+     */
+    void Load(istream& in) {
+        uint64_t header[5];
+        if (!in.read((char*)header, sizeof(header)) || header[0] != kMagic) {
+            throw std::runtime_error("Stream does not contain a learned index");
+        }
+
+        double stats[2];
+        in.read((char*)&root_, sizeof(root_));
+        in.read((char*)stats, sizeof(stats));
+        mean_distance_ = stats[0];
+        mean_window_ = stats[1];
+
+        leaves_.resize(header[1]);
+        prefixes_.resize(header[2]);
+        ranges_.resize(header[2] + 1);
+        rows_.resize(header[3]);
+        keys_.resize(header[2]);
+
+        in.read((char*)leaves_.data(), leaves_.size() * sizeof(Leaf));
+        in.read((char*)prefixes_.data(), prefixes_.size() * sizeof(uint64_t));
+        in.read((char*)ranges_.data(), ranges_.size() * sizeof(uint32_t));
+        in.read((char*)rows_.data(), rows_.size() * sizeof(RowId));
+
+        for (string& key : keys_) {
+            uint32_t length = 0;
+            in.read((char*)&length, sizeof(length));
+            key.resize(in ? length : 0);
+            in.read(key.data(), key.size());
+        }
+
+        if (!in) {
+            throw std::runtime_error("Learned index is truncated");
+        }
+    }
+
+private:
+    /// \brief A linear model y = slope * (x - base) + intercept.
+    struct Model {
+        double slope = 0;
+        double intercept = 0;
+        double base = 0;      ///< Mean of the training keys, subtracted for numerical stability.
+
+        double Predict(double x) const { return slope * (x - base) + intercept; }
+    };
+
+    /// \brief A leaf model with the largest errors below and above its prediction.
+    struct Leaf {
+        Model model;
+        uint32_t below = 0;
+        uint32_t above = 0;
+    };
+
+    static const uint64_t kMagic = 0x31584449454e524cULL;   ///< "LRNEIDX1"
+
+    Model root_;
+    vector<Leaf> leaves_;
+    vector<uint64_t> prefixes_;   ///< keyPrefix() of every distinct name, sorted.
+    vector<uint32_t> ranges_;     ///< Start of the row ids of every name in rows_, followed by rows_.size().
+    vector<string> keys_;         ///< Full name of every entry, read only on a prefix match.
+    vector<RowId> rows_;          ///< Row ids grouped by name.
+    double mean_distance_ = 0;
+    double mean_window_ = 0;
+    mutable IndexStats stats_;    ///< Instrumentation counters, updated by const searches too.
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+
+    /// \brief Least-squares line through the points (x[i], y[i]), i in [first, last).
+    static Model Fit(const vector<double>& x, const vector<double>& y, size_t first, size_t last) {
+        Model model;
+        size_t n = last - first;
+        if (n == 0) {
+            return model;
+        }
+
+        double mean_x = 0, mean_y = 0;
+        for (size_t i = first; i < last; ++i) {
+            mean_x += x[i];
+            mean_y += y[i];
+        }
+        mean_x /= n;
+        mean_y /= n;
+
+        double cov = 0, var = 0;
+        for (size_t i = first; i < last; ++i) {
+            cov += (x[i] - mean_x) * (y[i] - mean_y);
+            var += (x[i] - mean_x) * (x[i] - mean_x);
+        }
+
+        model.base = mean_x;
+        model.intercept = mean_y;
+        model.slope = var > 0 ? cov / var : 0;
+        return model;
+    }
+
+    size_t LeafOf(double x) const {
+        double leaf = root_.Predict(x);
+        return leaf <= 0 ? 0 : min(leaves_.size() - 1, (size_t)leaf);
+    }
+
+    long long Position(const Leaf& leaf, double x) const {
+        double pos = leaf.model.Predict(x);
+        double last = (double)prefixes_.size() - 1;
+        return (long long)(pos <= 0 ? 0 : (pos >= last ? last : pos));
+    }
+
+    /// \brief The range of prefixes_ that holds the first entry with prefix, if there is one.
+    void Window(uint64_t prefix, size_t& lo, size_t& hi) const {
+        double x = (double)prefix;
+        const Leaf& leaf = leaves_[LeafOf(x)];
+        long long pos = Position(leaf, x);
+
+        lo = (size_t)max(0LL, pos - (long long)leaf.below);
+        hi = (size_t)min((long long)prefixes_.size(), pos + (long long)leaf.above + 1);
+    }
+
+    /**
+     * \brief Fit both stages on the distinct prefixes and record the errors of the leaves.
+     *
+     * The target of a prefix is the position of its first entry, the one a lookup must find.
+     */
+    void Train(size_t count) {
+        leaves_.assign(count, Leaf());
+        root_ = Model();
+        mean_distance_ = 0;
+        mean_window_ = 0;
+
+        vector<double> x, first;
+        for (size_t i = 0; i < prefixes_.size(); ++i) {
+            if (i == 0 || prefixes_[i] != prefixes_[i - 1]) {
+                x.push_back((double)prefixes_[i]);
+                first.push_back((double)i);
+            }
+        }
+        if (x.empty()) {
+            return;
+        }
+
+        vector<double> leaf_target(x.size());
+        for (size_t i = 0; i < x.size(); ++i) {
+            leaf_target[i] = first[i] * count / prefixes_.size();
+        }
+        root_ = Fit(x, leaf_target, 0, x.size());
+
+        // The root model is monotone, so the keys of every leaf are a contiguous run of x.
+        vector<size_t> leaf_of(x.size());
+        for (size_t i = 0; i < x.size(); ++i) {
+            leaf_of[i] = LeafOf(x[i]);
+        }
+
+        for (size_t i = 0; i < x.size(); ) {
+            size_t j = i;
+            while (j < x.size() && leaf_of[j] == leaf_of[i]) {
+                j += 1;
+            }
+
+            Leaf& leaf = leaves_[leaf_of[i]];
+            leaf.model = Fit(x, first, i, j);
+            for (size_t k = i; k < j; ++k) {
+                long long error = Position(leaf, x[k]) - (long long)first[k];
+                leaf.below = max<uint32_t>(leaf.below, error > 0 ? (uint32_t)error : 0);
+                leaf.above = max<uint32_t>(leaf.above, error < 0 ? (uint32_t)-error : 0);
+                mean_distance_ += error < 0 ? -error : error;
+            }
+
+            i = j;
+        }
+
+        for (size_t i = 0; i < x.size(); ++i) {
+            const Leaf& leaf = leaves_[leaf_of[i]];
+            mean_window_ += leaf.below + leaf.above + 1;
+        }
+        mean_distance_ /= x.size();
+        mean_window_ /= x.size();
+    }
+    /// \}
+};
+
+#endif
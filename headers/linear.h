@@ -21,7 +21,7 @@ using namespace std;
  * \return      The index of the first matching element, or -1 if the element is not found.
  */
 template<class T>
-int linearSearch(T a[], long start, long size, T b) {
+int linearSearch(T a[], long start, long size, const T& b) {
     for (long i = start; i < size; ++i) {
         if (a[i] == b) {
             return i;
@@ -43,7 +43,7 @@ int linearSearch(T a[], long start, long size, T b) {
  *             If the element is not found, the vector will be empty.
  */
 template<class T>
-vector<int> searchAll(T a[], long size, T b) {
+vector<int> searchAll(T a[], long size, const T& b) {
     vector<int> res;
 
     int i = linearSearch(a, 0, size, b);
@@ -0,0 +1,111 @@
+/**
+ * \file  live.h
+ * \brief Indexes of a dataset that grows: new rows are merged into the built structures in batches.
+ */
+
+#ifndef LIVE_H
+#define LIVE_H
+
+#include "flower.h"
+#include "binary_tree.h"
+#include "rb_tree.h"
+#include "compact_rb_tree.h"
+#include "hash.h"
+#include "row_store.h"
+#include "pool.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * \class LiveIndexes
+ * \brief A row store and the mutable indexes over it, kept up to date by merging batches.
+ *
+ * The rows of a batch are appended to the RowStore, sorted by name once and merged into
+ * every index with its MergeSorted() path (one search per distinct name of the batch), the
+ * indexes in parallel. The cost of a batch depends on the batch, not on the rows already
+ * indexed, apart from the logarithmic searches.
+ *
+ * Erase() and Update() tombstone the row in the store. The indexes hold copies of the rows,
+ * not row ids, so every index removes the one copy of the row in place with RemoveOne(): a
+ * tree or hash table finds the key and erases the row from the rows of that key, the
+ * multimap erases the one entry. The SkipList is not part of the live set: it cannot remove a
+ * row, and its reads would return erased rows and both versions of updated ones.
+ *
+ * The static indexes (perfect hash, sorted array, learned index) cannot take new rows and
+ * are not part of the live set; they are rebuilt from the row store when needed.
+ */
+class LiveIndexes {
+public:
+    /// \brief Build all indexes over rows.
+    LiveIndexes(vector<Flower> rows, ThreadPool& pool);
+
+    /// \brief Append a batch of rows to the store and merge it into every index.
+    void Ingest(const vector<Flower>& batch);
+
+    /**
+     * \brief Ingest the complete lines of a growing CSV file that follow offset.
+     *
+     * \param path       Path to the CSV file.
+     * \param offset     Byte offset to continue from (0 at the first call), advanced past the lines read.
+     * \param batch_rows Number of rows merged at once.
+     * \return           Number of batches ingested.
+     */
+    size_t IngestTail(const string& path, size_t& offset, size_t batch_rows);
+
+    /// \brief Erase a row from the store and from every index. \return false if the row is not live.
+    bool Erase(RowId id);
+
+    /// \brief Replace a live row by row in the store and in every index. \return Id of the new version, or NO_ROW.
+    RowId Update(RowId id, const Flower& row);
+
+    /// \brief Start a compaction of the store, see RowStore::StartCompaction().
+    bool StartCompaction() { return store_.StartCompaction(); }
+
+    /**
+     * \brief Install a compaction of the store.
+     *
+     * The indexes hold rows, not ids, and need nothing; indexes over row ids built from the
+     * store are moved to the new ids with the remap.
+     *
+     * \param remap Filled with the new id of every old id, NO_ROW for dropped rows.
+     * \param wait  Wait for the compaction; otherwise return false if it has not finished yet.
+     */
+    bool FinishCompaction(vector<RowId>& remap, bool wait = true) { return store_.FinishCompaction(remap, wait); }
+
+    RowStore& GetStore() { return store_; }
+    Tree<Flower>& GetTree() { return tree_b_; }
+    RBTree<Flower>& GetRBTree() { return tree_c_; }
+    CompactRBTree<Flower>& GetCompactRBTree() { return tree_r_; }
+    HashTable& GetTable() { return *table_; }
+    multimap<string, Flower>& GetMultimap() { return mmap_; }
+
+private:
+    ThreadPool& pool_;
+    RowStore store_;
+    Tree<Flower> tree_b_;
+    RBTree<Flower> tree_c_;
+    CompactRBTree<Flower> tree_r_;
+    unique_ptr<HashTable> table_;
+    multimap<string, Flower> mmap_;
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+
+    /// \brief Merge a run of rows sorted by name into every index.
+    void Merge(const vector<const Flower*>& sorted);
+
+    /// \brief Remove the first copy of row from every index.
+    void RemoveRow(const Flower& row);
+
+    /// \brief Insert a run of values sorted by name into mmap_, one search per distinct name.
+    void MergeMultimap(const vector<const Flower*>& sorted);
+    /// \}
+};
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * \file  memory.h
+ * \brief Counting allocator: global operator new/delete replacements that track
+ *        the number of live heap bytes and its peak.
+ */
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+
+/// \brief  Number of heap bytes currently allocated through operator new.
+size_t memCurrent();
+
+/// \brief  Highest value of memCurrent() since the last memResetPeak().
+size_t memPeak();
+
+/// \brief  Number of operator new calls since the program start.
+size_t memAllocations();
+
+/// \brief  Set the peak to the current number of live bytes.
+void memResetPeak();
+
+/**
+ * \brief Heap usage of one allocation scope.
+ *
+ * A scope counts the blocks allocated by the threads that have it as their current scope
+ * (see memScopeSwitch()); a block released later is subtracted from the scope it was
+ * allocated in, whichever thread releases it. This keeps the footprints of structures
+ * built at the same time on different threads apart.
+ */
+struct MemScope {
+    size_t current = 0;      ///< Live bytes allocated in the scope.
+    size_t peak = 0;         ///< Highest value of current.
+    size_t allocations = 0;  ///< Number of operator new calls in the scope.
+};
+
+/// \brief  Open a new scope with zero counters.
+/// \return Its id, never 0. Only the 64 most recently opened scopes keep counting.
+unsigned long long memScopeOpen();
+
+/// \brief    Make id the current scope of the calling thread (0 for none).
+/// \return   The previous current scope of the thread.
+unsigned long long memScopeSwitch(unsigned long long id);
+
+/// \brief  Current scope of the calling thread, 0 if none.
+unsigned long long memScopeCurrent();
+
+/// \brief  Counters of a scope; zero if it is no longer tracked.
+MemScope memScopeRead(unsigned long long id);
+
+#endif
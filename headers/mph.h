@@ -0,0 +1,300 @@
+/// \file mph.h
+/// \brief Defines a build-once minimal perfect hash index over the distinct names of a dataset.
+///
+/// Provides:
+/// - PerfectHash: A PTHash-style minimal perfect hash that maps every distinct name to a dense
+///   slot. The slot stores a fingerprint of the name and the range of its row ids.
+
+#ifndef MPH_H
+#define MPH_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include "flower.h"
+#include "hash_func.h"
+#include "rows.h"
+#include "stats.h"
+
+using namespace std;
+
+/**
+ * \class PerfectHash
+ * \brief Static index that answers "all rows with this name" in a couple of memory accesses.
+ *
+ * The distinct names are split into small buckets by their hash. Every bucket gets a
+ * pilot value (found at build time) such that hashing the bucket's names together with
+ * the pilot sends them to free slots of a table that has exactly one slot per name.
+ * A lookup therefore reads one pilot and one slot, without probing or chain walking.
+ *
+ * Every slot keeps a 32-bit fingerprint of its name, so a name that was not in the data
+ * is rejected with probability 1 - 2^-32. Callers that need an exact answer must compare
+ * the name of the first returned row.
+ *
+ * Row ids of one name are stored contiguously, in increasing order, so a hit is returned
+ * as a RowRange into the index.
+ */
+class PerfectHash {
+public:
+    /// \defgroup constructors
+    /// \{
+    PerfectHash() = default;
+
+    /// \brief Build the index over the names of data.
+    PerfectHash(const vector<Flower>& data) { Build(data); }
+    /// \}
+
+    /**
+     * \brief Build the index over the names of data, replacing the previous contents.
+     *
+     * 1. Group row ids by name.
+     * 2. Hash every distinct name and distribute the names over buckets.
+     * 3. Going from the largest bucket to the smallest, search for a pilot that places all
+     *    names of the bucket into free slots.
+     * 4. If some bucket has no pilot within the search limit, start over with another seed.
+     *
+     * \param data A vector of Flower objects, the row id of an object is its position.
+     */
+    void Build(const vector<Flower>& data) {
+        unordered_map<string, uint32_t> ids;
+        vector<string> keys;
+        vector<vector<RowId>> groups;
+
+        for (size_t i = 0; i < data.size(); ++i) {
+            string key = data[i].GetName();
+            auto it = ids.find(key);
+
+            if (it == ids.end()) {
+                ids.emplace(key, (uint32_t)keys.size());
+                keys.push_back(key);
+                groups.push_back(vector<RowId>(1, (RowId)i));
+            } else {
+                groups[it->second].push_back((RowId)i);
+            }
+        }
+
+        size_t n = keys.size();
+        pilots_.clear();
+        slots_.assign(n, Slot());
+        rows_.clear();
+        rows_.reserve(data.size());
+
+        if (n == 0) {
+            bucket_count_ = 0;
+            return;
+        }
+
+        vector<uint64_t> hashes(n);
+        vector<uint32_t> positions(n);
+
+        for (uint64_t attempt = 0; ; ++attempt) {
+            seed_ = mix64(attempt + 0x5eed);
+            for (size_t i = 0; i < n; ++i) {
+                hashes[i] = hashFunc_mix(keys[i], seed_);
+            }
+
+            if (PlaceKeys(hashes, positions)) {
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            Slot& slot = slots_[positions[i]];
+            slot.fingerprint_ = Fingerprint(hashes[i]);
+            slot.begin_ = (uint32_t)rows_.size();
+            rows_.insert(rows_.end(), groups[i].begin(), groups[i].end());
+            slot.end_ = (uint32_t)rows_.size();
+        }
+    }
+
+    /**
+     * \brief Search for all rows with a given name.
+     *
+     * \param key The name to search for.
+     * \return    The row ids of the name, or an empty range if the fingerprint does not match.
+     */
+    RowRange Search(const string& key) const {
+        RowRange res;
+        if (slots_.empty()) {
+            return res;
+        }
+
+        uint64_t hash = hashFunc_mix(key, seed_);
+        const Slot& slot = slots_[Position(hash, pilots_[Bucket(hash)])];
+        STAT_ADD(stats_, probes, 1);
+        STAT_ADD(stats_, comparisons, 1);
+
+        if (slot.fingerprint_ == Fingerprint(hash)) {
+            res.begin_ = rows_.data() + slot.begin_;
+            res.end_ = rows_.data() + slot.end_;
+        }
+
+        return res;
+    }
+
+    /**
+     * \brief Move the row ids to their ids after a RowStore compaction, see remapRowIds().
+     *
+     * The names stay; a name whose rows were all dropped is found with an empty range.
+     *
+     * \param remap New id of every old id, NO_ROW for dropped rows.
+     */
+    void Remap(const vector<RowId>& remap) {
+        vector<uint32_t> moved = remapRowIds(rows_, remap);
+        for (Slot& slot : slots_) {
+            slot.begin_ = moved[slot.begin_];
+            slot.end_ = moved[slot.end_];
+        }
+    }
+
+    /// \brief Instrumentation counters, see stats.h; build probes count tried slot positions.
+    IndexStats& GetStats() { return stats_; }
+
+    size_t GetCountUnq() const { return slots_.size(); }
+    size_t GetCount() const { return rows_.size(); }
+
+    /// \brief Number of bytes used by the pilots, slots and row ids.
+    size_t GetBytes() const {
+        return pilots_.size() * sizeof(uint32_t) + slots_.size() * sizeof(Slot) + rows_.size() * sizeof(RowId);
+    }
+
+    /**
+     * \brief Write the index to a binary stream.
+     * \param out Stream opened in binary mode.
+     */
+    void Save(ostream& out) const {
+        uint64_t header[5] = { kMagic, seed_, bucket_count_, slots_.size(), rows_.size() };
+        out.write((const char*)header, sizeof(header));
+        out.write((const char*)pilots_.data(), pilots_.size() * sizeof(uint32_t));
+        out.write((const char*)slots_.data(), slots_.size() * sizeof(Slot));
+        out.write((const char*)rows_.data(), rows_.size() * sizeof(RowId));
+    }
+
+    /**
+     * \brief Read an index written by Save().
+     * \param in Stream opened in binary mode.
+     * \throws   runtime_error if the stream does not contain a saved index.
+     */
+    void Load(istream& in) {
+        uint64_t header[5];
+        if (!in.read((char*)header, sizeof(header)) || header[0] != kMagic) {
+            throw std::runtime_error("Stream does not contain a perfect hash index");
+        }
+
+        seed_ = header[1];
+        bucket_count_ = header[2];
+        pilots_.resize(bucket_count_);
+        slots_.resize(header[3]);
+        rows_.resize(header[4]);
+
+        in.read((char*)pilots_.data(), pilots_.size() * sizeof(uint32_t));
+        in.read((char*)slots_.data(), slots_.size() * sizeof(Slot));
+        in.read((char*)rows_.data(), rows_.size() * sizeof(RowId));
+        if (!in) {
+            throw std::runtime_error("Perfect hash index is truncated");
+        }
+    }
+
+private:
+    /// \brief A table slot: fingerprint of the name and the range of its row ids in rows_.
+    struct Slot {
+        uint32_t fingerprint_ = 0;
+        uint32_t begin_ = 0;
+        uint32_t end_ = 0;
+    };
+
+    static const uint64_t kMagic = 0x3148504d48535046ULL;  ///< "FPSHMPH1"
+    static const uint32_t kBucketSize = 4;                 ///< Average number of names per bucket.
+    static const uint32_t kMaxPilot = 1u << 20;            ///< Pilot search limit before reseeding.
+
+    uint64_t seed_ = 0;           ///< Seed of the hash function.
+    uint64_t bucket_count_ = 0;   ///< Number of buckets (and pilots).
+    vector<uint32_t> pilots_;     ///< Pilot of every bucket.
+    vector<Slot> slots_;          ///< One slot per distinct name.
+    vector<RowId> rows_;          ///< Row ids grouped by name.
+    mutable IndexStats stats_;    ///< Instrumentation counters, updated by const searches too.
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+
+    uint32_t Fingerprint(uint64_t hash) const { return (uint32_t)(hash >> 32); }
+    uint64_t Bucket(uint64_t hash) const { return (uint32_t)hash % bucket_count_; }
+
+    uint32_t Position(uint64_t hash, uint32_t pilot) const {
+        return (uint32_t)(mix64(hash ^ mix64(pilot + seed_)) % slots_.size());
+    }
+
+    /**
+     * \brief Find a pilot for every bucket.
+     *
+     * \param hashes    Hash of every distinct name.
+     * \param positions Output: the slot of every distinct name.
+     * \return          false if some bucket could not be placed with the current seed.
+     */
+    bool PlaceKeys(const vector<uint64_t>& hashes, vector<uint32_t>& positions) {
+        size_t n = hashes.size();
+        bucket_count_ = (n + kBucketSize - 1) / kBucketSize;
+        pilots_.assign(bucket_count_, 0);
+
+        vector<vector<uint32_t>> buckets(bucket_count_);
+        for (size_t i = 0; i < n; ++i) {
+            buckets[Bucket(hashes[i])].push_back((uint32_t)i);
+        }
+
+        vector<uint32_t> order(bucket_count_);
+        for (size_t b = 0; b < bucket_count_; ++b) {
+            order[b] = (uint32_t)b;
+        }
+        stable_sort(order.begin(), order.end(), [&](uint32_t l, uint32_t r) {
+            return buckets[l].size() > buckets[r].size();
+        });
+
+        vector<bool> taken(n, false);
+        vector<uint32_t> candidate;
+
+        for (uint32_t b : order) {
+            const vector<uint32_t>& bucket = buckets[b];
+            if (bucket.empty()) {
+                break;
+            }
+
+            bool placed = false;
+            for (uint32_t pilot = 0; pilot < kMaxPilot && !placed; ++pilot) {
+                candidate.clear();
+                placed = true;
+
+                for (uint32_t key : bucket) {
+                    uint32_t pos = Position(hashes[key], pilot);
+                    STAT_ADD(stats_, probes, 1);
+                    if (taken[pos] || find(candidate.begin(), candidate.end(), pos) != candidate.end()) {
+                        placed = false;
+                        break;
+                    }
+                    candidate.push_back(pos);
+                }
+
+                if (placed) {
+                    pilots_[b] = pilot;
+                    for (size_t k = 0; k < bucket.size(); ++k) {
+                        taken[candidate[k]] = true;
+                        positions[bucket[k]] = candidate[k];
+                    }
+                }
+            }
+
+            if (!placed) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+    /// \}
+};
+
+#endif
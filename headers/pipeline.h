@@ -0,0 +1,45 @@
+/**
+ * \file  pipeline.h
+ * \brief Coroutine pipeline that reads and parses the next datasets while the current one is processed.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "flower.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// \brief Bytes read from a dataset file at once.
+#define PIPELINE_CHUNK (1 << 20)
+
+/// \brief Chunks read ahead of the parser.
+#define PIPELINE_CHUNKS 8
+
+/// \brief Parsed datasets waiting for the consumer.
+#define PIPELINE_DATASETS 2
+
+/**
+ * \brief Run the datasets of paths through a read, parse and consume pipeline.
+ *
+ * Three coroutines (see coro.h) are connected by bounded queues:
+ * 1. the reader reads every file in chunks of PIPELINE_CHUNK bytes cut at line ends;
+ * 2. the parser parses the chunks (parserCSVChunk()) and hands every complete dataset on;
+ * 3. the consumer calls consume(index, rows) for the datasets in the order of paths.
+ *
+ * The stages run on their own workers, so the next files are read and parsed while consume()
+ * works on the current one, at most PIPELINE_DATASETS datasets and PIPELINE_CHUNKS chunks
+ * ahead. The rows are the same as parserCSV() would return.
+ *
+ * \param paths   Paths to the dataset CSV files.
+ * \param consume Called once per dataset, one call at a time.
+ * \throws        runtime_error if a file cannot be opened, or what consume() throws; the pipeline
+ *                stops at the first error.
+ */
+void runPipeline(const vector<string>& paths, const function<void(size_t, vector<Flower>&)>& consume);
+
+#endif
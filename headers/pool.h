@@ -0,0 +1,142 @@
+/**
+ * \file  pool.h
+ * \brief Fixed-size thread pool for building indexes, and a parallel stable sort on top of it.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * \class ThreadPool
+ * \brief Worker threads that execute groups of tasks.
+ *
+ * RunAll() blocks until every task of its group is finished. While waiting, the calling
+ * thread executes queued tasks itself, so a task may start a nested group without
+ * deadlocking the pool. A task runs with the allocation scope (see memory.h) of the thread
+ * that submitted it, so heap usage of a parallel build is charged to the build.
+ */
+class ThreadPool {
+public:
+    /// \brief     Start the workers.
+    /// \param threads Total number of threads that execute tasks, including the caller of RunAll();
+    ///                0 means one per hardware thread.
+    ThreadPool(unsigned threads = 0);
+
+    /// \brief Finishes the queued tasks and joins the workers.
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// \brief Number of threads that execute tasks, including the caller of RunAll().
+    unsigned GetThreads() const { return (unsigned)workers_.size() + 1; }
+
+    /**
+     * \brief Run a group of tasks and wait for all of them.
+     *
+     * \param tasks Tasks of the group; they may run in any order and concurrently.
+     * \throws      The first exception thrown by a task, after the whole group has finished.
+     */
+    void RunAll(vector<function<void()>> tasks);
+
+    /**
+     * \brief Queue a task without waiting for it.
+     *
+     * The task runs on a worker thread; a pool without workers runs it in the caller.
+     * An exception thrown by the task terminates the program, as nobody waits for it.
+     */
+    void Post(function<void()> task);
+
+    /**
+     * \brief Split [0, count) into one range per thread and process the ranges concurrently.
+     *
+     * \param count Number of items.
+     * \param body  Callable body(begin, end) that processes the items of one range.
+     */
+    template <typename Body>
+    void ParallelFor(size_t count, Body body) {
+        size_t parts = min<size_t>(GetThreads(), count ? count : 1);
+        vector<function<void()>> tasks;
+
+        for (size_t p = 0; p < parts; ++p) {
+            size_t begin = count * p / parts;
+            size_t end = count * (p + 1) / parts;
+            tasks.push_back([&body, begin, end] { body(begin, end); });
+        }
+
+        RunAll(std::move(tasks));
+    }
+
+private:
+    struct Task {
+        function<void()> run_;
+        unsigned long long scope_;   ///< Allocation scope of the submitting thread.
+    };
+
+    std::mutex mutex_;
+    condition_variable work_, done_;
+    deque<Task> queue_;
+    vector<std::thread> workers_;
+    bool stop_ = false;
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+    void Work();
+
+    /// \brief Run one queued task; the lock is released while it runs.
+    void RunOne(unique_lock<std::mutex>& lock);
+    /// \}
+};
+
+/**
+ * \brief Stable sort that sorts one slice per thread and merges the slices pairwise.
+ *
+ * \param pool  Pool that runs the slices.
+ * \param first Begin of the random-access range.
+ * \param last  End of the range.
+ * \param less  Strict weak ordering.
+ */
+template <typename It, typename Compare>
+void parallelStableSort(ThreadPool& pool, It first, It last, Compare less) {
+    size_t count = last - first;
+    size_t parts = pool.GetThreads();
+
+    if (parts == 1 || count < 4096) {
+        stable_sort(first, last, less);
+        return;
+    }
+
+    vector<size_t> bounds(parts + 1);
+    for (size_t p = 0; p <= parts; ++p) {
+        bounds[p] = count * p / parts;
+    }
+
+    pool.ParallelFor(parts, [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) {
+            stable_sort(first + bounds[p], first + bounds[p + 1], less);
+        }
+    });
+
+    for (size_t width = 1; width < parts; width *= 2) {
+        vector<function<void()>> merges;
+        for (size_t p = 0; p + width < parts; p += 2 * width) {
+            size_t middle = bounds[p + width];
+            size_t end = bounds[min(p + 2 * width, parts)];
+            merges.push_back([=, &less] { inplace_merge(first + bounds[p], first + middle, first + end, less); });
+        }
+        pool.RunAll(std::move(merges));
+    }
+}
+
+#endif
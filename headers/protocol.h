@@ -0,0 +1,143 @@
+/**
+ * \file  protocol.h
+ * \brief Binary protocol of the query server (see server.h) and of its load generator.
+ *
+ * Every message is a frame: a 32-bit size of the rest of the frame, then the body. All
+ * integers are in the byte order of the host, the protocol is only spoken over a local socket.
+ *
+ * Request body:
+ * - uint32 id, echoed in the response;
+ * - uint16 count, number of queries in the frame;
+ * - count queries: uint8 op (QueryOp), uint16 key size, uint32 limit, key bytes.
+ *
+ * Response body:
+ * - uint32 id of the request;
+ * - uint8 status (ReplyStatus);
+ * - uint16 count, number of results, the same as in the request when the status is OK;
+ * - count results: uint32 matches, uint32 n = min(matches, limit), n row ids (uint32).
+ *
+ * A response body never exceeds MAX_FRAME: when the row ids of all results do not fit, the
+ * results are filled in order and n of a later result is cut to the space left, down to zero.
+ * The number of matches is always exact, so a client can tell a cut result from a complete one.
+ *
+ * A client may send any number of frames without waiting for the responses (pipelining);
+ * the responses of one connection come back in the order of the requests.
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// \brief Largest frame body accepted by either side; the server closes a connection that sends a larger one.
+#define MAX_FRAME (1 << 20)
+
+/// \brief Size of the frame size field.
+#define FRAME_HEADER 4
+
+/// \brief What a query searches for.
+enum QueryOp : uint8_t {
+    OP_EXACT = 1,   ///< Rows whose name is the key.
+    OP_PREFIX,      ///< Rows whose name starts with the key.
+    OP_COLOR,       ///< Rows of the color key.
+    OP_SMELL,       ///< Rows of the smell key.
+    OP_REGION,      ///< Rows found in the region key.
+};
+
+enum ReplyStatus : uint8_t {
+    REPLY_OK = 0,
+    REPLY_BAD_REQUEST,  ///< The body could not be decoded or has an unknown op; no results follow.
+};
+
+/// \brief One query of a request frame.
+struct Query {
+    uint8_t op_ = OP_EXACT;
+    uint32_t limit_ = 0;    ///< Largest number of row ids to return; the number of matches is always returned.
+    string key_;
+};
+
+/// \defgroup protocol_coding Encoding and decoding of frames
+/// \{
+
+/// \brief Append the bytes of an integer to out.
+template <typename Int>
+void putInt(string& out, Int value) {
+    out.append((const char*)&value, sizeof(value));
+}
+
+/// \brief Read an integer at pos and advance pos. \return false if the data ends first.
+template <typename Int>
+bool getInt(const char *data, size_t size, size_t& pos, Int& value) {
+    if (size - pos < sizeof(value)) {
+        return false;
+    }
+    memcpy(&value, data + pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+/// \brief Append a request frame with the given queries to out.
+inline void encodeRequest(string& out, uint32_t id, const vector<Query>& queries) {
+    size_t start = out.size();
+    putInt<uint32_t>(out, 0);
+    putInt<uint32_t>(out, id);
+    putInt<uint16_t>(out, (uint16_t)queries.size());
+
+    for (const Query& query : queries) {
+        putInt<uint8_t>(out, query.op_);
+        putInt<uint16_t>(out, (uint16_t)query.key_.size());
+        putInt<uint32_t>(out, query.limit_);
+        out += query.key_;
+    }
+
+    uint32_t body = (uint32_t)(out.size() - start - FRAME_HEADER);
+    memcpy(&out[start], &body, sizeof(body));
+}
+
+/**
+ * \brief Decode a request body.
+ *
+ * \param data    The body, without the frame size.
+ * \param size    Size of the body.
+ * \param id      Set to the id of the request, if the body is long enough to hold it.
+ * \param queries Filled with the queries.
+ * \return        false if the body is malformed.
+ */
+inline bool decodeRequest(const char *data, size_t size, uint32_t& id, vector<Query>& queries) {
+    size_t pos = 0;
+    uint16_t count = 0;
+    if (!getInt(data, size, pos, id) || !getInt(data, size, pos, count)) {
+        return false;
+    }
+
+    queries.resize(count);
+    for (Query& query : queries) {
+        uint16_t key_size = 0;
+        if (!getInt(data, size, pos, query.op_) || !getInt(data, size, pos, key_size) ||
+            !getInt(data, size, pos, query.limit_) || size - pos < key_size) {
+            return false;
+        }
+        query.key_.assign(data + pos, key_size);
+        pos += key_size;
+    }
+
+    return pos == size;
+}
+
+/// \brief Length of the first complete frame in data, or 0 if it is not complete yet.
+inline size_t frameLength(const char *data, size_t size) {
+    uint32_t body = 0;
+    if (size < FRAME_HEADER) {
+        return 0;
+    }
+    memcpy(&body, data, sizeof(body));
+    return size - FRAME_HEADER < body ? 0 : FRAME_HEADER + body;
+}
+/// \}
+
+#endif
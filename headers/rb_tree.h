@@ -13,6 +13,8 @@
 #include <stdexcept>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include "stats.h"
 
 using namespace std;
 
@@ -88,6 +90,8 @@ public:
     RBTree(T value) { 
         root_ = new RBNode<T>(value);
         root_->color_ = BLACK; ///< The root node is always initialized with BLACK color.
+        STAT_ADD(stats_, allocations, 1);
+        STAT_MAX(stats_, height, 1);
     }
     ~RBTree() { DelTree(root_); }
     /// \}
@@ -102,30 +106,39 @@ public:
      * Otherwise, insert similar to a BST and then rebalance via Balance().
      *
      * \param value Reference to the value to insert.
+     * \return      The node that holds the values with the key of value.
      */
-    void Insert(const T& value) {
+    RBNode<T>* Insert(const T& value) {
         if (!root_) {
             root_ = new RBNode<T>(value);
             root_->color_ = BLACK;
-            return;
+            STAT_ADD(stats_, allocations, 1);
+            STAT_MAX(stats_, height, 1);
+            return root_;
         }
 
         RBNode<T> *target = root_;
         RBNode<T> *parent = nullptr;
+        long long depth = 1;
 
         while(target) {
+            STAT_ADD(stats_, nodes_visited, 1);
+            STAT_ADD(stats_, comparisons, 1);
             parent = target;
             if (value < target->values_[0]) {
                 target = target->left_;
-            } else if (value > target->values_[0]){
+            } else if (STAT_ADD(stats_, comparisons, 1), value > target->values_[0]){
                 target = target->right_;
             } else {
                 target->values_.push_back(value);
-                return;
+                return target;
             }
+            depth += 1;
         }
 
         target = new RBNode<T>(value);
+        STAT_ADD(stats_, allocations, 1);
+        STAT_MAX(stats_, height, depth);
         target->parent_ = parent;
 
         if (value < parent->values_[0]) {
@@ -135,6 +148,24 @@ public:
         }
 
         Balance(target);
+        return target;
+    }
+
+    /**
+     * \brief Insert a run of values that is sorted by operator<.
+     *
+     * Every run of equal values costs one descent: the first value is inserted by Insert()
+     * and the rest is appended to the values of its node.
+     *
+     * \param sorted Pointers to the values, stably sorted by operator<.
+     */
+    void MergeSorted(const vector<const T*>& sorted) {
+        for (size_t i = 0; i < sorted.size(); ) {
+            RBNode<T> *node = Insert(*sorted[i]);
+            for (i += 1; i < sorted.size() && !(*sorted[i - 1] < *sorted[i]); ++i) {
+                node->values_.push_back(*sorted[i]);
+            }
+        }
     }
 
     // /// @brief  Search for all nodes containing a given value.
@@ -152,10 +183,13 @@ public:
             RBNode<T> *cur = root_;
 
             while (cur) {
+                STAT_ADD(stats_, nodes_visited, 1);
+                STAT_ADD(stats_, comparisons, 1);
                 if (cur->values_[0] == value) {
                     return cur;
                 } 
 
+                STAT_ADD(stats_, comparisons, 1);
                 if (value < cur->values_[0]) {
                     cur = cur->left_;
                 } else {
@@ -167,14 +201,187 @@ public:
         return nullptr;
     }
 
+    /**
+     * \brief Search for many values at once, in one left-to-right pass over the tree.
+     *
+     * Every search starts from the node where the previous one ended (a finger): it climbs
+     * to the lowest ancestor whose subtree can hold the value and descends from there. Values
+     * close to each other in key order share most of their paths, so m values cost
+     * O(m log(n / m)) steps instead of m full descents.
+     *
+     * \param sorted Values sorted by operator<, without two equal ones.
+     * \return       For every value, the node holding its key, or nullptr.
+     */
+    vector<RBNode<T>*> SearchSorted(const vector<T>& sorted) {
+        vector<RBNode<T>*> res(sorted.size(), nullptr);
+        RBNode<T> *finger = root_;
+
+        for (size_t i = 0; i < sorted.size() && finger; ++i) {
+            const T& value = sorted[i];
+
+            // The subtree of a left child ends before its parent; a right child ends where its parent ends.
+            while (finger->parent_) {
+                RBNode<T> *dad = finger->parent_;
+                STAT_ADD(stats_, nodes_visited, 1);
+                if (dad->left_ == finger && (STAT_ADD(stats_, comparisons, 1), value < dad->values_[0])) {
+                    break;
+                }
+                finger = dad;
+            }
+
+            RBNode<T> *cur = finger;
+            while (cur) {
+                STAT_ADD(stats_, nodes_visited, 1);
+                STAT_ADD(stats_, comparisons, 1);
+                finger = cur;
+                if (cur->values_[0] == value) {
+                    res[i] = cur;
+                    break;
+                }
+
+                STAT_ADD(stats_, comparisons, 1);
+                cur = value < cur->values_[0] ? cur->left_ : cur->right_;
+            }
+        }
+
+        return res;
+    }
+
+    /**
+     * \brief Replace the contents of the tree with values that are already sorted.
+     *
+     * Equal values are grouped into one node, in input order, and the nodes are linked
+     * into a perfectly balanced tree without rotations. All nodes are black except the
+     * deepest level of a tree that is not perfect, which is red; then every path from
+     * the root to a leaf has the same number of black nodes.
+     *
+     * \param sorted Pointers to the values, stably sorted by operator<.
+     */
+    void BuildSorted(const vector<const T*>& sorted) {
+        DelTree(root_);
+
+        vector<size_t> groups;
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            if (i == 0 || *sorted[i - 1] < *sorted[i]) {
+                groups.push_back(i);
+            }
+        }
+        size_t count = groups.size();
+        groups.push_back(sorted.size());
+
+        int max_depth = 0;
+        while (((size_t)2 << max_depth) - 1 < count) {
+            max_depth += 1;
+        }
+        bool perfect = ((size_t)2 << max_depth) - 1 == count;
+
+        root_ = SupportBuild(sorted, groups, 0, count, nullptr, 0, perfect ? -1 : max_depth);
+    }
+
+    /**
+     * \brief Remove all values equal to value.
+     *
+     * A node with two children takes over the values of its successor, which is then
+     * removed instead; the removed node has at most one child, which takes its place.
+     * Removing a black node is repaired by RemoveBalance().
+     *
+     * \param value Reference to the value to remove.
+     * \return Number of removed values.
+     */
+    size_t Remove(const T& value) {
+        RBNode<T> *node = SearchAll(value);
+        if (!node) {
+            return 0;
+        }
+        size_t removed = node->values_.size();
+
+        RBNode<T> *target = node;
+        if (node->left_ && node->right_) {
+            target = node->right_;
+            while (target->left_) {
+                target = target->left_;
+            }
+            node->values_.swap(target->values_);
+        }
+
+        RBNode<T> *child = target->left_ ? target->left_ : target->right_;
+        RBNode<T> *parent = target->parent_;
+        if (child) {
+            child->parent_ = parent;
+        }
+        if (!parent) {
+            root_ = child;
+        } else if (parent->left_ == target) {
+            parent->left_ = child;
+        } else {
+            parent->right_ = child;
+        }
+
+        if (target->color_ == BLACK) {
+            RemoveBalance(child, parent);
+        }
+        delete target;
+
+        return removed;
+    }
+
+    /**
+     * \brief Remove one value: the first one equal to value for which match returns true.
+     *
+     * The value is erased from the vector of its node; the node itself is removed by
+     * Remove() only when it held nothing else.
+     *
+     * \param value Reference to a value with the key to remove.
+     * \param match Predicate that picks the value among the equal ones.
+     * \return      true if a value was removed.
+     */
+    template <typename Match>
+    bool RemoveOne(const T& value, Match match) {
+        RBNode<T> *node = SearchAll(value);
+        if (!node) {
+            return false;
+        }
+
+        auto it = find_if(node->values_.begin(), node->values_.end(), match);
+        if (it == node->values_.end()) {
+            return false;
+        }
+        if (node->values_.size() == 1) {
+            Remove(value);
+        } else {
+            node->values_.erase(it);
+        }
+        return true;
+    }
+
+    /**
+     * \brief Replace all values equal to value by value, or insert it if there are none.
+     *
+     * The key of a node does not change, so a replacement needs no rebalancing.
+     *
+     * \param value Reference to the new value.
+     */
+    void Upsert(const T& value) {
+        RBNode<T> *node = SearchAll(value);
+        if (node) {
+            node->values_.assign(1, value);
+        } else {
+            Insert(value);
+        }
+    }
+
     /// \brief Print all nodes in the tree using pre-order traversal.
     void PrintTree() {
         SupportPrint(root_);
     }
+
+    /// \brief Instrumentation counters, see stats.h.
+    IndexStats& GetStats() { return stats_; }
     /// \}
 
 private:
     RBNode<T> *root_;  ///< Pointer to the root node of the tree.
+    IndexStats stats_;
 
 private:
     /// \defgroup supporting_methods Supporting methods for basic methods
@@ -220,6 +427,35 @@ private:
         }
     }
 
+    /**
+     * \brief Build a balanced subtree from the groups [lo, hi) of equal values.
+     *
+     * \param groups    Start of every group in sorted, followed by sorted.size().
+     * \param red_depth Depth whose nodes are colored red, -1 for none.
+     */
+    RBNode<T>* SupportBuild(const vector<const T*>& sorted, const vector<size_t>& groups, size_t lo, size_t hi,
+                            RBNode<T> *parent, int depth, int red_depth) {
+        if (lo >= hi) {
+            return nullptr;
+        }
+
+        size_t mid = lo + (hi - lo) / 2;
+        RBNode<T> *node = new RBNode<T>(*sorted[groups[mid]]);
+        node->values_.reserve(groups[mid + 1] - groups[mid]);
+        for (size_t i = groups[mid] + 1; i < groups[mid + 1]; ++i) {
+            node->values_.push_back(*sorted[i]);
+        }
+        STAT_ADD(stats_, allocations, 1);
+        STAT_MAX(stats_, height, depth + 1);
+
+        node->color_ = depth == red_depth ? RED : BLACK;
+        node->parent_ = parent;
+        node->left_ = SupportBuild(sorted, groups, lo, mid, node, depth + 1, red_depth);
+        node->right_ = SupportBuild(sorted, groups, mid + 1, hi, node, depth + 1, red_depth);
+
+        return node;
+    }
+
     /// @brief Recursively deletes all nodes in the subtree rooted at the given node.
     void DelTree(RBNode<T> *root) {
         if (root) {
@@ -310,6 +546,93 @@ private:
         root_->color_ = BLACK;
     }
 
+    /**
+     * \brief Restores Red-Black Tree properties after a black node was removed.
+     *
+     * The subtree of node (which may be empty) lacks one black node on every path. While
+     * node is black and not the root, the sibling decides the case:
+     *   - Case 1: Sibling is red (rotate it up, the new sibling is black).
+     *   - Case 2: Sibling and both its children are black (recolor it, move up).
+     *   - Case 3: Near child of the sibling is red, far child black (rotate it up).
+     *   - Case 4: Far child of the sibling is red (rotate the sibling up and recolor, done).
+     *
+     * @param[in,out] node   Node that took the place of the removed one, or nullptr.
+     * @param[in,out] parent Parent of that place, nullptr if it is the root.
+     */
+    void RemoveBalance(RBNode<T> *node, RBNode<T> *parent) {
+        while (node != root_ && (!node || node->color_ == BLACK)) {
+            if (node == parent->left_) {
+                RBNode<T> *sibling = parent->right_;
+
+                // 1
+                if (sibling->color_ == RED) {
+                    sibling->color_ = BLACK;
+                    parent->color_ = RED;
+                    LeftRotate(sibling, parent, parent->parent_);
+                    sibling = parent->right_;
+                }
+
+                // 2
+                if ((!sibling->left_ || sibling->left_->color_ == BLACK) &&
+                    (!sibling->right_ || sibling->right_->color_ == BLACK)) {
+                    sibling->color_ = RED;
+                    node = parent;
+                    parent = node->parent_;
+                    continue;
+                }
+
+                // 3
+                if (!sibling->right_ || sibling->right_->color_ == BLACK) {
+                    sibling->left_->color_ = BLACK;
+                    sibling->color_ = RED;
+                    RightRotate(sibling->left_, sibling, parent);
+                    sibling = parent->right_;
+                }
+
+                // 4
+                sibling->color_ = parent->color_;
+                parent->color_ = BLACK;
+                sibling->right_->color_ = BLACK;
+                LeftRotate(sibling, parent, parent->parent_);
+                node = root_;
+            } else {
+                RBNode<T> *sibling = parent->left_;
+
+                if (sibling->color_ == RED) {
+                    sibling->color_ = BLACK;
+                    parent->color_ = RED;
+                    RightRotate(sibling, parent, parent->parent_);
+                    sibling = parent->left_;
+                }
+
+                if ((!sibling->left_ || sibling->left_->color_ == BLACK) &&
+                    (!sibling->right_ || sibling->right_->color_ == BLACK)) {
+                    sibling->color_ = RED;
+                    node = parent;
+                    parent = node->parent_;
+                    continue;
+                }
+
+                if (!sibling->left_ || sibling->left_->color_ == BLACK) {
+                    sibling->right_->color_ = BLACK;
+                    sibling->color_ = RED;
+                    LeftRotate(sibling->right_, sibling, parent);
+                    sibling = parent->left_;
+                }
+
+                sibling->color_ = parent->color_;
+                parent->color_ = BLACK;
+                sibling->left_->color_ = BLACK;
+                RightRotate(sibling, parent, parent->parent_);
+                node = root_;
+            }
+        }
+
+        if (node) {
+            node->color_ = BLACK;
+        }
+    }
+
     /**
      * @brief Perform a left rotation around a given parent and child.
      *
@@ -326,6 +649,7 @@ private:
      *                           `grand`’s appropriate child pointer is updated to point to `child`.
      */
     void LeftRotate(RBNode<T> *child, RBNode<T> *dad, RBNode<T> *grand) {
+        STAT_ADD(stats_, rotations, 1);
         RBNode<T> *grandson = child->left_;
 
         dad->right_ = grandson;
@@ -360,6 +684,7 @@ private:
      *                           `grand`’s appropriate child pointer is updated to point to `child`.
      */
     void RightRotate(RBNode<T> *child, RBNode<T> *dad, RBNode<T> *grand) {
+        STAT_ADD(stats_, rotations, 1);
         RBNode<T> *grandson = child->right_;
 
         dad->left_ = grandson;
@@ -0,0 +1,104 @@
+/**
+ * \file  row_store.h
+ * \brief Shared store of rows addressed by row ids, with tombstones and background compaction.
+ */
+
+#ifndef ROW_STORE_H
+#define ROW_STORE_H
+
+#include "flower.h"
+#include "rows.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * \class RowStore
+ * \brief The rows of a dataset; erasing or updating a row only marks a tombstone.
+ *
+ * Row ids stay valid until a compaction: Erase() sets the tombstone of a row, Update()
+ * erases the old version and appends the new one under a new id. Indexes over row ids
+ * keep returning erased ids and filter them with IsLive(), see RowSource in index.h.
+ *
+ * A compaction copies the live rows into a dense vector on a background thread while the
+ * store keeps serving reads and writes:
+ * - the rows that existed when it started are not modified until it is finished (Update()
+ *   never writes in place), and the thread reads a copy of their tombstones;
+ * - rows appended in the meantime go to a tail vector;
+ * - FinishCompaction() installs the copy, appends the live tail rows, re-applies erases
+ *   that happened in the meantime and returns the mapping from old to new row ids, which
+ *   the owners of row-id indexes use to remap or rebuild them.
+ *
+ * The store itself is not thread-safe: it is used by one thread, the compaction thread
+ * is internal.
+ */
+class RowStore {
+public:
+    /// \brief Store the rows of a dataset; row i gets id i.
+    RowStore(vector<Flower> rows);
+
+    /// \brief Waits for a running compaction and drops its result.
+    ~RowStore();
+
+    RowStore(const RowStore&) = delete;
+    RowStore& operator=(const RowStore&) = delete;
+
+    /// \brief Append a row. \return Its id.
+    RowId Append(const Flower& row);
+
+    /// \brief Mark a row as erased. \return false if it does not exist or is already erased.
+    bool Erase(RowId id);
+
+    /// \brief Replace a live row by a new version. \return Id of the new version, or NO_ROW if id is not live.
+    RowId Update(RowId id, const Flower& row);
+
+    bool IsLive(RowId id) const { return id < dead_.size() && !dead_[id]; }
+
+    /// \brief A row by id; erased rows stay readable until a compaction.
+    const Flower& Get(RowId id) const { return id < rows_.size() ? rows_[id] : tail_[id - rows_.size()]; }
+
+    /// \brief Number of ids issued since the last compaction.
+    size_t GetCount() const { return dead_.size(); }
+    size_t GetLive() const { return dead_.size() - dead_count_; }
+    size_t GetDead() const { return dead_count_; }
+
+    /**
+     * \brief Start copying the live rows on a background thread.
+     * \return false if a compaction is already running.
+     */
+    bool StartCompaction();
+
+    bool IsCompacting() const { return worker_.joinable(); }
+
+    /**
+     * \brief Install the result of a compaction.
+     *
+     * \param remap Filled with the new id of every old id, NO_ROW for dropped rows.
+     * \param wait  Wait for the thread; otherwise return false if it has not finished yet.
+     * \return      true if a compaction was installed.
+     */
+    bool FinishCompaction(vector<RowId>& remap, bool wait = true);
+
+private:
+    vector<Flower> rows_;         ///< Rows with ids [0, rows_.size()); read-only while compacting.
+    vector<Flower> tail_;         ///< Rows appended while compacting, ids from rows_.size().
+    vector<unsigned char> dead_;  ///< Tombstone of every id.
+    size_t dead_count_ = 0;
+
+    std::thread worker_;
+    atomic<bool> done_{ false };
+    vector<unsigned char> snapshot_;  ///< Tombstones of rows_ when the compaction started.
+    vector<Flower> compacted_;        ///< Live rows of rows_, written by the worker.
+    vector<RowId> remap_;             ///< New id of every id of rows_, written by the worker.
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+    void Compact();
+    /// \}
+};
+
+#endif
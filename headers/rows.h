@@ -0,0 +1,63 @@
+/// \file rows.h
+/// \brief Row identifiers and contiguous row-id ranges returned by the static indexes.
+///
+/// A row id is the position of a Flower in the vector produced by parserCSV().
+
+#ifndef ROWS_H
+#define ROWS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/// \brief Position of a row in the source vector of Flower objects.
+typedef uint32_t RowId;
+
+/// \brief Row id of a row that does not exist (erased, or dropped by compaction).
+#define NO_ROW ((RowId)-1)
+
+/**
+ * \brief A non-owning view of a contiguous run of row ids.
+ *
+ * Static indexes keep the row ids of every key next to each other, so the result
+ * of a lookup is just a pair of pointers into the index's own storage. An empty
+ * range means that the key was not found.
+ */
+struct RowRange {
+    const RowId *begin_ = nullptr;  ///< First row id of the run.
+    const RowId *end_ = nullptr;    ///< One past the last row id of the run.
+
+    const RowId* begin() const { return begin_; }
+    const RowId* end() const { return end_; }
+    size_t size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+    RowId operator[](size_t i) const { return begin_[i]; }
+};
+
+/**
+ * \brief Replace the row ids of a static index by their ids after a RowStore compaction.
+ *
+ * Ids mapped to NO_ROW are dropped and the others close up, keeping their order.
+ *
+ * \param rows  Row ids of the index, grouped into runs.
+ * \param remap New id of every old id, as returned by RowStore::FinishCompaction().
+ * \return      New position of every old position in rows, and of rows.size(), to move the bounds of the runs.
+ */
+inline std::vector<uint32_t> remapRowIds(std::vector<RowId>& rows, const std::vector<RowId>& remap) {
+    std::vector<uint32_t> moved(rows.size() + 1);
+    size_t kept = 0;
+
+    for (size_t i = 0; i < rows.size(); ++i) {
+        moved[i] = (uint32_t)kept;
+        RowId id = rows[i] < remap.size() ? remap[rows[i]] : NO_ROW;
+        if (id != NO_ROW) {
+            rows[kept++] = id;
+        }
+    }
+
+    moved[rows.size()] = (uint32_t)kept;
+    rows.resize(kept);
+    return moved;
+}
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ * \file  server.h
+ * \brief Resident query server: loads a dataset once and answers queries over a Unix domain socket.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "flower.h"
+#include "pool.h"
+#include "protocol.h"
+#include "rows.h"
+#include "sorted_index.h"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/// \brief Number of pending replies of a connection after which the server stops reading from it.
+#define SERVER_MAX_PENDING 64
+
+/// \brief Bytes read from a socket at once.
+#define SERVER_READ_CHUNK 65536
+
+/**
+ * \class QueryServer
+ * \brief Answers the queries of protocol.h from indexes built once over the rows.
+ *
+ * - Exact and prefix queries are answered by a SortedIndex over the names: the rows of all
+ *   names with a prefix are one contiguous run of its row ids.
+ * - Attribute queries are answered by posting lists: the row ids of every color, smell and region.
+ *
+ * One thread runs an epoll loop over the listening socket and the connections; sockets are
+ * non-blocking. The complete frames that one read of a connection brings are answered together
+ * by one task of a ThreadPool, so a client that pipelines or batches its requests pays for one
+ * task per read, not per query. A worker stores the encoded responses in the reply slot of the
+ * task and wakes the loop through an eventfd; the loop writes the finished replies of a
+ * connection in request order. A connection with SERVER_MAX_PENDING unfinished replies is not
+ * read until they are written.
+ *
+ * The indexes are read-only after construction, so workers share them without locks (the
+ * instrumentation counters of SortedIndex are not synchronized, so the server is meant to be
+ * built without SEARCH_STATS).
+ */
+class QueryServer {
+public:
+    /// \brief     Build the indexes over rows; row i gets id i.
+    /// \param threads Threads that answer queries, in addition to the loop thread; 0 means one per hardware thread.
+    QueryServer(const vector<Flower>& rows, unsigned threads = 0);
+
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    /**
+     * \brief Listen on path and serve until Stop() is called or SIGINT or SIGTERM arrives.
+     *
+     * An existing file at path is replaced. The signals are blocked in the calling thread
+     * while serving.
+     *
+     * \throws runtime_error if the socket cannot be created.
+     */
+    void Serve(const string& path);
+
+    /// \brief Make Serve() return; may be called from any thread.
+    void Stop();
+
+    /// \brief Answer the queries of one request body and append the response frame to out.
+    void Answer(const char *body, size_t size, string& out) const;
+
+    size_t GetRows() const { return rows_; }
+
+private:
+    /// \brief Encoded responses of the frames of one read, filled by a worker.
+    struct Reply {
+        string bytes_;
+        bool ready_ = false;    ///< Guarded by done_mutex_.
+    };
+
+    struct Connection {
+        int fd_ = -1;
+        string in_;                         ///< Bytes read that do not form a complete frame yet.
+        string out_;                        ///< Bytes of finished replies not written yet.
+        size_t out_pos_ = 0;                ///< Bytes of out_ already written.
+        deque<shared_ptr<Reply>> pending_;  ///< Replies in request order, finished or not.
+        bool eof_ = false;                  ///< The peer closed its side or sent a bad frame.
+        uint32_t events_ = 0;               ///< Events the connection is registered for.
+    };
+
+    size_t rows_;
+    SortedIndex names_;
+    unordered_map<string, vector<RowId>> colors_, smells_, regions_;
+
+    int epoll_ = -1;
+    int wake_ = -1;                         ///< eventfd that workers and Stop() write to.
+    atomic<bool> stop_{ false };
+
+    map<uint64_t, Connection> connections_; ///< By serial number, so a reused fd is never confused.
+    uint64_t next_serial_ = 3;              ///< 0 is the listening socket, 1 the eventfd, 2 the signalfd.
+
+    std::mutex done_mutex_;
+    vector<uint64_t> done_;                 ///< Connections with newly finished replies.
+
+    unique_ptr<ThreadPool> pool_;           ///< Destroyed first: its tasks use the members above.
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+
+    /**
+     * \brief Append the result of one query to out.
+     * \param budget Bytes of row ids the response still has room for; reduced by the ids appended.
+     */
+    void AnswerQuery(const Query& query, string& out, size_t& budget) const;
+
+    void Accept(int listener);
+
+    /// \brief Read what the socket has and hand the complete frames to the pool.
+    void Read(uint64_t serial, Connection& conn);
+
+    /// \brief Move the finished replies at the front of pending_ to out_ and write as much as possible.
+    void Flush(Connection& conn);
+
+    /// \brief Register the events the connection currently waits for; close it if it is finished.
+    void Update(uint64_t serial, Connection& conn);
+
+    void Close(uint64_t serial, Connection& conn);
+
+    /// \brief Handle the connections of done_.
+    void Complete();
+    /// \}
+};
+
+#endif
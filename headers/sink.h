@@ -0,0 +1,176 @@
+/**
+ * \file  sink.h
+ * \brief Buffered result files written by a background thread.
+ *
+ * Provides:
+ * - SinkWriter: A background thread that writes filled buffers to their files with writev().
+ * - ResultSink: An output file with a large reusable buffer and allocation-free formatting.
+ *
+ * A ResultSink formats into its buffer without flushing; a full buffer is handed to the
+ * SinkWriter and formatting continues into a recycled one, so the disk write of one file
+ * overlaps the search and formatting of the next.
+ */
+
+#ifndef SINK_H
+#define SINK_H
+
+#include "flower.h"
+#include <charconv>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/// \brief Size of one sink buffer; a buffer is handed to the writer when it is full.
+#define SINK_BUFFER_SIZE (1 << 18)
+
+/**
+ * \class SinkWriter
+ * \brief Background thread that owns the file descriptors of the sinks and writes their buffers.
+ *
+ * Buffers of one file are written in the order they were submitted. Consecutive buffers of
+ * the same file are written with one writev() call. Written buffers go back to a free list,
+ * so a steady stream of output does not allocate.
+ */
+class SinkWriter {
+public:
+    SinkWriter();
+
+    /// \brief Waits for all pending writes and stops the thread; errors are dropped.
+    ~SinkWriter();
+
+    SinkWriter(const SinkWriter&) = delete;
+    SinkWriter& operator=(const SinkWriter&) = delete;
+
+    /// \brief Take an empty buffer with SINK_BUFFER_SIZE bytes reserved.
+    string Acquire();
+
+    /**
+     * \brief Queue a buffer for writing.
+     *
+     * \param fd     Descriptor of the file, owned by the writer from now on.
+     * \param buffer Data to write; the buffer is recycled after the write.
+     * \param close  Close the descriptor after the buffer is written.
+     */
+    void Submit(int fd, string&& buffer, bool close);
+
+    /**
+     * \brief Wait until every queued buffer is written.
+     * \throws runtime_error if some write or close failed since the last Drain().
+     */
+    void Drain();
+
+private:
+    struct Job {
+        int fd_;
+        string buffer_;
+        bool close_;
+    };
+
+    std::mutex mutex_;
+    condition_variable work_, idle_;
+    deque<Job> jobs_;
+    vector<string> free_;
+    bool busy_ = false;
+    bool stop_ = false;
+    string error_;          ///< First error since the last Drain(), empty if none.
+    std::thread thread_;
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+    void Run();
+
+    /// \brief Write a batch of jobs of one file, return an error message or an empty string.
+    string WriteBatch(vector<Job>& batch);
+    /// \}
+};
+
+/**
+ * \class ResultSink
+ * \brief One output file, formatted into a buffer and written by a SinkWriter.
+ *
+ * The Append methods produce the same text as the matching ofstream insertions, so
+ * result files stay byte for byte the same as the stream-based output.
+ */
+class ResultSink {
+public:
+    /**
+     * \brief Create (truncate) a file.
+     *
+     * \param writer Writer that performs the disk writes; must outlive the sink.
+     * \param path   Path to the file.
+     * \throws       runtime_error if the file cannot be opened.
+     */
+    ResultSink(SinkWriter& writer, const string& path);
+
+    /// \brief Calls Close().
+    ~ResultSink() { Close(); }
+
+    ResultSink(const ResultSink&) = delete;
+    ResultSink& operator=(const ResultSink&) = delete;
+
+    ResultSink& Append(const char *data, size_t size) {
+        if (buffer_.size() + size > SINK_BUFFER_SIZE && !buffer_.empty()) {
+            Spill();
+        }
+        buffer_.append(data, size);
+        return *this;
+    }
+
+    ResultSink& Append(const string& text) { return Append(text.data(), text.size()); }
+    ResultSink& Append(const char *text) { return Append(text, strlen(text)); }
+    ResultSink& Append(char c) { return Append(&c, 1); }
+
+    /// \brief Append an integer in decimal.
+    template <typename Integer>
+    ResultSink& AppendInt(Integer value) {
+        char digits[24];
+        auto res = to_chars(digits, digits + sizeof(digits), value);
+        return Append(digits, res.ptr - digits);
+    }
+
+    /// \brief Append a pointer the way ostream prints it: "0x" and hex digits, "0" for nullptr.
+    ResultSink& AppendPointer(const void *pointer) {
+        if (!pointer) {
+            return Append('0');
+        }
+        char digits[2 + 16] = { '0', 'x' };
+        auto res = to_chars(digits + 2, digits + sizeof(digits), (uintptr_t)pointer, 16);
+        return Append(digits, res.ptr - digits);
+    }
+
+    /// \brief Append "name;color;smell;region1,region2,..." without a line break.
+    ResultSink& AppendRow(const Flower& flower) {
+        Append(flower.GetName()).Append(';').Append(flower.GetColor()).Append(';').Append(flower.GetSmell()).Append(';');
+
+        const vector<string>& regions = flower.GetRegions();
+        for (size_t j = 0; j < regions.size(); ++j) {
+            if (j) {
+                Append(',');
+            }
+            Append(regions[j]);
+        }
+        return *this;
+    }
+
+    /// \brief Hand the rest of the buffer and the file to the writer. Does not wait for the write.
+    void Close();
+
+private:
+    SinkWriter& writer_;
+    string buffer_;
+    int fd_ = -1;
+
+private:
+    /// \brief Hand the full buffer to the writer and continue in a fresh one.
+    void Spill();
+};
+
+#endif
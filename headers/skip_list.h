@@ -0,0 +1,190 @@
+/**
+ * \file  skip_list.h
+ * \brief Ordered index of Flower rows by name that many threads can insert into at once without a lock.
+ *
+ * Provides:
+ * - SkipArena: A bump allocator that threads share without a lock.
+ * - SkipList: A skip list whose towers, key prefixes and rows live in a SkipArena.
+ */
+
+#ifndef SKIP_LIST_H
+#define SKIP_LIST_H
+
+#include "flower.h"
+#include "inline_key.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// \brief Largest number of levels of a tower; with a level kept with probability 1/4, enough for 4^20 keys.
+#define SKIP_MAX_HEIGHT 20
+
+/// \brief Bytes of one arena block.
+#define SKIP_ARENA_BLOCK (1 << 20)
+
+/**
+ * \class SkipArena
+ * \brief Lock-free bump allocator; everything it hands out is freed together with the arena.
+ *
+ * Threads claim space in the current block with one fetch_add. The thread that finds the block
+ * full installs a new one with a compare-and-swap; a thread that loses that race frees its block
+ * and claims space in the winner's one.
+ */
+class SkipArena {
+public:
+    SkipArena() = default;
+    ~SkipArena();
+
+    SkipArena(const SkipArena&) = delete;
+    SkipArena& operator=(const SkipArena&) = delete;
+
+    /// \brief Uninitialized memory of bytes bytes, aligned to 16.
+    void* Allocate(size_t bytes);
+
+    /// \brief Number of bytes of the blocks allocated so far.
+    size_t GetBytes() const { return bytes_.load(memory_order_relaxed); }
+
+private:
+    struct Block {
+        Block *next_;               ///< Previously installed block.
+        size_t size_;               ///< Usable bytes after the header.
+        atomic<size_t> used_;       ///< Bytes claimed; may run past size_ once the block is full.
+
+        char* Data() { return (char*)this + HEADER; }
+    };
+
+    /// \brief Bytes of a block header, rounded up to the alignment of the allocations.
+    static const size_t HEADER = (sizeof(Block) + 15) & ~(size_t)15;
+
+    atomic<Block*> current_{ nullptr };
+    atomic<size_t> bytes_{ 0 };
+};
+
+/**
+ * \class SkipList
+ * \brief Concurrent skip list keyed by name, with all rows of a name kept in one tower.
+ *
+ * A tower is allocated from the arena in one piece: the InlineKey of the name, so that a step
+ * of a search compares the 32-byte prefix in place and reads the name itself only to break a
+ * tie of two long names; a pointer to its first row, which owns the full name; the list of its
+ * rows; and its links, one per level. Rows are copied into the arena as well.
+ *
+ * Insert() never takes a lock. A new row of an existing name is pushed onto the row list of
+ * its tower with a compare-and-swap. A new name gets a tower of random height, which becomes
+ * part of the list by a compare-and-swap of the link at level 0 and is then linked into the
+ * upper levels, each of which only speeds up searches. Nothing is ever removed, so a search
+ * or a scan never meets a half-deleted tower and takes no lock either.
+ *
+ * Every insert takes a number from a shared clock right after linking its row; this is the
+ * moment it takes effect. A search or a scan reads the clock when it starts and reports exactly
+ * the rows with smaller numbers: all of them are linked already, and the rows of inserts that
+ * finish later are skipped. So every search and every range scan returns the contents of the
+ * list at one instant, while inserts go on.
+ *
+ * Reads are therefore not lock-free: a read that meets a row linked but not numbered yet spins
+ * until its inserter takes the number. The window is two instructions long, but an inserter
+ * that is preempted inside it blocks the reads of that name until it runs again.
+ */
+class SkipList {
+public:
+    SkipList();
+    ~SkipList();
+
+    SkipList(const SkipList&) = delete;
+    SkipList& operator=(const SkipList&) = delete;
+
+    /// \brief Add a copy of row; safe to call from several threads at once.
+    void Insert(const Flower& row);
+
+    /// \brief The rows named name, in the order they were inserted by one thread.
+    vector<const Flower*> SearchAll(const string& name) const;
+
+    /**
+     * \brief Call visit(row) for every row named name, newest first, without collecting them.
+     *
+     * Sees the same rows as SearchAll() and, like it, waits for in-flight inserts of the name.
+     */
+    template <typename Visit>
+    void ForEach(const string& name, Visit visit) const {
+        uint64_t now = clock_.load();
+
+        const Tower *tower = LowerBound(name);
+        if (!tower || Compare(tower, InlineKey(name), name) != 0) {
+            return;
+        }
+        for (const Row *row = tower->rows_.load(memory_order_acquire); row; row = row->next_) {
+            if (WaitNumber(row) < now) {
+                visit(row->row_);
+            }
+        }
+    }
+
+    /// \brief The rows with low <= name < high, ordered by name and, within a name, as SearchAll().
+    vector<const Flower*> Range(const string& low, const string& high) const;
+
+    /// \brief All rows, ordered as Range().
+    vector<const Flower*> All() const;
+
+    /// \brief Number of rows inserted so far.
+    size_t GetCount() const { return clock_.load(); }
+
+    /// \brief Number of bytes of the arena: towers, key prefixes and rows.
+    size_t GetBytes() const { return arena_.GetBytes(); }
+
+private:
+    struct Row {
+        Flower row_;
+        atomic<uint64_t> number_;   ///< Reading of the clock at the insert, or SKIP_UNNUMBERED.
+        Row *next_;                 ///< The row of the same name inserted before.
+    };
+
+    struct Tower {
+        InlineKey key_;
+        const Flower *first_;       ///< The row the tower was made for; holds the full name.
+        atomic<Row*> rows_;         ///< The most recently inserted row.
+        int height_;
+        atomic<Tower*> next_[1];    ///< height_ links, allocated past the end of the struct.
+    };
+
+    static const uint64_t SKIP_UNNUMBERED = UINT64_MAX;
+
+    SkipArena arena_;
+    Tower *head_;                   ///< Tower of SKIP_MAX_HEIGHT levels before every name.
+    atomic<uint64_t> clock_{ 0 };
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+
+    /// \brief Three-way comparison of the name of tower with the name that key was made from.
+    static int Compare(const Tower *tower, const InlineKey& key, const string& name);
+
+    /**
+     * \brief Find the last tower before name and the first one at or after it on every level.
+     * \return The tower of name, or nullptr.
+     */
+    Tower* Find(const InlineKey& key, const string& name, Tower **preds, Tower **succs) const;
+
+    /// \brief First tower whose name is not less than name, or nullptr.
+    Tower* LowerBound(const string& name) const;
+
+    /// \brief Append the rows of the towers from first up to high (nullptr for the end) with numbers below now.
+    void Collect(const Tower *first, const string *high, uint64_t now, vector<const Flower*>& out) const;
+
+    /// \brief Append the rows of tower with numbers below now, oldest first.
+    static void CollectRows(const Tower *tower, uint64_t now, vector<const Flower*>& out);
+
+    /// \brief The number of row, spinning while its insert has linked it but not numbered it yet.
+    static uint64_t WaitNumber(const Row *row);
+
+    /// \brief A tower of height levels for the name of first, which becomes its only row; nullptr for the head.
+    Tower* NewTower(Row *first, int height);
+    static int RandomHeight();
+    /// \}
+};
+
+#endif
@@ -0,0 +1,338 @@
+/// \file sorted_index.h
+/// \brief Defines a read-only ordered index stored as one sorted array.
+///
+/// Provides:
+/// - SortedIndex: Sorted (key prefix, row-id range) entries searched with a branchless
+///   binary search, or with interpolation search when the key prefixes are spread evenly.
+
+#ifndef SORTED_INDEX_H
+#define SORTED_INDEX_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "flower.h"
+#include "rows.h"
+#include "stats.h"
+
+using namespace std;
+
+/// \brief First 8 bytes of key as a big-endian integer, padded with zero bytes; integer order is the byte order of keys.
+inline uint64_t keyPrefix(const string& key) {
+    unsigned char bytes[8] = {};
+    memcpy(bytes, key.data(), key.size() < 8 ? key.size() : 8);
+
+    uint64_t res = 0;
+    for (int i = 0; i < 8; ++i) {
+        res = res << 8 | bytes[i];
+    }
+    return res;
+}
+
+/**
+ * \class SortedIndex
+ * \brief Static ordered index: a binary search over a flat array instead of a pointer tree.
+ *
+ * Every distinct name is one 16-byte entry: the first 8 bytes of the name as a big-endian
+ * integer (so integer order is the byte order of the names) and the range of its row ids.
+ * A lookup compares integers and only reads full names when several names share the
+ * prefix of the key; such a run is searched by full name.
+ *
+ * The search is a branchless lower bound (a conditional move per step, no mispredictions).
+ * If at build time interpolation on the prefixes needs clearly fewer steps than a binary
+ * search, lookups first narrow the range by interpolation and finish with the same lower bound.
+ *
+ * Row ids of one name are stored contiguously, in increasing order, so a hit is returned
+ * as a RowRange into the index.
+ */
+class SortedIndex {
+public:
+    /// \defgroup constructors
+    /// \{
+    SortedIndex() = default;
+
+    /// \brief Build the index over the names of data.
+    SortedIndex(const vector<Flower>& data) { Build(data); }
+    /// \}
+
+    /**
+     * \brief Build the index over the names of data, replacing the previous contents.
+     *
+     * 1. Stably sort the row ids by name.
+     * 2. Emit one entry per run of equal names.
+     * 3. Decide whether interpolation search pays off for these prefixes.
+     *
+     * \param data A vector of Flower objects, the row id of an object is its position.
+     */
+    void Build(const vector<Flower>& data) {
+        rows_.resize(data.size());
+        for (size_t i = 0; i < data.size(); ++i) {
+            rows_[i] = (RowId)i;
+        }
+        stable_sort(rows_.begin(), rows_.end(), [&](RowId l, RowId r) { return data[l].GetName() < data[r].GetName(); });
+
+        entries_.clear();
+        keys_.clear();
+        for (size_t i = 0; i < rows_.size(); ++i) {
+            const string& name = data[rows_[i]].GetName();
+            if (keys_.empty() || keys_.back() != name) {
+                entries_.push_back(Entry{ keyPrefix(name), (uint32_t)i, (uint32_t)i });
+                keys_.push_back(name);
+                STAT_ADD(stats_, allocations, 1);
+            }
+            entries_.back().end_ = (uint32_t)i + 1;
+        }
+
+        interpolate_ = false;
+        if (entries_.size() >= 64) {
+            double steps = 0;
+            for (const Entry& entry : entries_) {
+                steps += InterpolationSteps(entry.prefix_);
+            }
+            interpolate_ = steps / entries_.size() < log2((double)entries_.size()) / 2;
+        }
+    }
+
+    /**
+     * \brief Search for all rows with a given name.
+     *
+     * \param key The name to search for.
+     * \return    The row ids of the name, or an empty range if it is not in the index.
+     */
+    RowRange Search(const string& key) const {
+        RowRange res;
+        uint64_t prefix = keyPrefix(key);
+
+        size_t lo = 0, hi = entries_.size();
+        if (interpolate_) {
+            Interpolate(prefix, lo, hi);
+        }
+
+        size_t i = LowerBound(prefix, lo, hi);
+        if (i == entries_.size() || entries_[i].prefix_ != prefix) {
+            return res;
+        }
+
+        // Names longer than the prefix may share it: binary search the run by full name.
+        if (i + 1 < entries_.size() && entries_[i + 1].prefix_ == prefix) {
+            size_t end = prefix == UINT64_MAX ? entries_.size() : LowerBound(prefix + 1, i + 1, entries_.size());
+            i = lower_bound(keys_.begin() + i, keys_.begin() + end, key) - keys_.begin();
+            if (i == end) {
+                return res;
+            }
+        }
+
+        STAT_ADD(stats_, comparisons, 1);
+        if (keys_[i] == key) {
+            res.begin_ = rows_.data() + entries_[i].begin_;
+            res.end_ = rows_.data() + entries_[i].end_;
+        }
+
+        return res;
+    }
+
+    /**
+     * \brief Search for many names at once, in one left-to-right pass over the entries.
+     *
+     * Every search gallops forward from the entry where the previous one ended: it probes
+     * 1, 2, 4, ... entries ahead until it passes the name, then binary searches the last
+     * gap. Names close to each other cost a few steps, so m names cost O(m log(n / m))
+     * comparisons instead of m full searches.
+     *
+     * \param keys Names sorted by string order, without repeats.
+     * \return     For every name, its row ids, or an empty range if it is not in the index.
+     */
+    vector<RowRange> SearchSorted(const vector<string>& keys) const {
+        vector<RowRange> res(keys.size());
+        size_t pos = 0;
+
+        for (size_t k = 0; k < keys.size() && pos < entries_.size(); ++k) {
+            const string& key = keys[k];
+            uint64_t prefix = keyPrefix(key);
+            auto less = [&](size_t i) {
+                STAT_ADD(stats_, probes, 1);
+                return entries_[i].prefix_ < prefix || (entries_[i].prefix_ == prefix && keys_[i] < key);
+            };
+
+            size_t lo = pos, hi = pos, step = 1;
+            while (hi < entries_.size() && less(hi)) {
+                lo = hi + 1;
+                hi = lo + step;
+                step *= 2;
+            }
+            hi = min(hi, entries_.size());
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                if (less(mid)) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
+                }
+            }
+            pos = lo;
+
+            STAT_ADD(stats_, comparisons, 1);
+            if (pos < entries_.size() && keys_[pos] == key) {
+                res[k].begin_ = rows_.data() + entries_[pos].begin_;
+                res[k].end_ = rows_.data() + entries_[pos].end_;
+            }
+        }
+
+        return res;
+    }
+
+    /**
+     * \brief Search for all rows whose name starts with prefix.
+     *
+     * Row ids are grouped by name in name order, so the rows of all names that start with
+     * prefix form one contiguous run of rows_.
+     *
+     * \param prefix The start of the names to search for; an empty prefix matches every row.
+     * \return       The row ids of the matching names, ordered by name.
+     */
+    RowRange SearchPrefix(const string& prefix) const {
+        RowRange res;
+
+        // Entries with a smaller integer prefix hold smaller names; the full names decide from there on.
+        size_t lo = LowerBound(keyPrefix(prefix), 0, entries_.size());
+        size_t first = lower_bound(keys_.begin() + lo, keys_.end(), prefix) - keys_.begin();
+        size_t last = partition_point(keys_.begin() + first, keys_.end(),
+                                      [&](const string& name) { return name.starts_with(prefix); }) - keys_.begin();
+
+        STAT_ADD(stats_, comparisons, 1);
+        if (first < last) {
+            res.begin_ = rows_.data() + entries_[first].begin_;
+            res.end_ = rows_.data() + entries_[last - 1].end_;
+        }
+
+        return res;
+    }
+
+    /**
+     * \brief Move the row ids to their ids after a RowStore compaction, see remapRowIds().
+     *
+     * The names stay; a name whose rows were all dropped is found with an empty range.
+     *
+     * \param remap New id of every old id, NO_ROW for dropped rows.
+     */
+    void Remap(const vector<RowId>& remap) {
+        vector<uint32_t> moved = remapRowIds(rows_, remap);
+        for (Entry& entry : entries_) {
+            entry.begin_ = moved[entry.begin_];
+            entry.end_ = moved[entry.end_];
+        }
+    }
+
+    /// \brief Instrumentation counters, see stats.h; probes count search steps.
+    IndexStats& GetStats() { return stats_; }
+
+    size_t GetCountUnq() const { return entries_.size(); }
+    size_t GetCount() const { return rows_.size(); }
+
+    /// \brief Whether lookups use interpolation search.
+    bool GetInterpolated() const { return interpolate_; }
+
+    /// \brief Number of bytes used by the entries and row ids (the names are not counted).
+    size_t GetBytes() const { return entries_.size() * sizeof(Entry) + rows_.size() * sizeof(RowId); }
+
+private:
+    /// \brief One distinct name: prefix of the name and the range of its row ids in rows_.
+    struct Entry {
+        uint64_t prefix_;
+        uint32_t begin_;
+        uint32_t end_;
+    };
+
+    vector<Entry> entries_;       ///< Sorted by name.
+    vector<string> keys_;         ///< Full name of every entry, read only on a prefix match.
+    vector<RowId> rows_;          ///< Row ids grouped by name.
+    bool interpolate_ = false;    ///< Narrow the range by interpolation before the binary search.
+    mutable IndexStats stats_;    ///< Instrumentation counters, updated by const searches too.
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+
+    /// \brief Branchless lower bound of prefix among entries_[lo, hi).
+    size_t LowerBound(uint64_t prefix, size_t lo, size_t hi) const {
+        size_t count = hi - lo;
+        if (count == 0) {
+            return lo;
+        }
+
+        const Entry *base = entries_.data() + lo;
+        while (count > 1) {
+            size_t half = count / 2;
+            STAT_ADD(stats_, probes, 1);
+            base = base[half].prefix_ < prefix ? base + half : base;
+            count -= half;
+        }
+
+        return (base - entries_.data()) + (base->prefix_ < prefix);
+    }
+
+    /**
+     * \brief Shrink [lo, hi) around the lower bound of prefix by interpolation.
+     *
+     * Every step guesses a position from the prefixes at the ends of the range, then checks
+     * a window of 8 entries next to the guess. The result always contains the lower bound.
+     *
+     * \return Number of steps made.
+     */
+    size_t Interpolate(uint64_t prefix, size_t& lo, size_t& hi) const {
+        const size_t window = 8;
+        size_t steps = 0;
+
+        while (hi - lo > 2 * window) {
+            uint64_t first = entries_[lo].prefix_;
+            uint64_t last = entries_[hi - 1].prefix_;
+            steps += 1;
+            STAT_ADD(stats_, probes, 1);
+
+            if (prefix <= first) {
+                hi = lo;
+                break;
+            }
+            if (prefix > last) {
+                lo = hi;
+                break;
+            }
+
+            double fraction = ((double)prefix - (double)first) / ((double)last - (double)first);
+            size_t guess = lo + (size_t)(fraction * (hi - 1 - lo));
+            guess = min(max(guess, lo + 1), hi - 1);
+
+            if (entries_[guess].prefix_ < prefix) {
+                size_t next = min(guess + window, hi - 1);
+                if (entries_[next].prefix_ >= prefix) {
+                    lo = guess + 1;
+                    hi = next + 1;
+                    break;
+                }
+                lo = next + 1;
+            } else {
+                size_t prev = guess > lo + window ? guess - window : lo;
+                if (entries_[prev].prefix_ < prefix) {
+                    lo = prev + 1;
+                    hi = guess + 1;
+                    break;
+                }
+                hi = prev + 1;
+            }
+        }
+
+        return steps;
+    }
+
+    /// \brief Cost of a lookup of prefix with interpolation, in search steps.
+    double InterpolationSteps(uint64_t prefix) const {
+        size_t lo = 0, hi = entries_.size();
+        size_t steps = Interpolate(prefix, lo, hi);
+        return steps + log2((double)(hi - lo) + 1);
+    }
+    /// \}
+};
+
+#endif
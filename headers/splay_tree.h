@@ -0,0 +1,269 @@
+/// \file splay_tree.h
+/// \brief Defines a templated splay tree that moves every searched key to the root.
+///
+/// This file provides:
+/// - SplayNode: A node storing all values with one key and pointers to its children.
+/// - SplayTree: A self-adjusting search tree supporting insertion, search of all occurrences
+///   and bulk loading; frequently searched keys stay near the root.
+
+#ifndef SPLAY_TREE_H
+#define SPLAY_TREE_H
+
+#include <vector>
+#include "stats.h"
+
+using namespace std;
+
+/**
+ * \brief Represents a node in a splay tree.
+ *
+ * \tparam T Type of the value stored in the node.
+ */
+template <typename T>
+class SplayNode {
+public:
+    vector<T> values_;
+
+    SplayNode *left_, *right_;
+
+public:
+    SplayNode() {
+        left_ = nullptr;
+        right_ = nullptr;
+    }
+
+    SplayNode(const T& value) {
+        values_.push_back(value);
+        left_ = nullptr;
+        right_ = nullptr;
+    }
+};
+
+/**
+ * \brief Implements a top-down splay tree.
+ *
+ * Every Insert() and SearchAll() splays the searched key: the path to it is rotated so that
+ * its node, or the last node of the path when the key is absent, becomes the root. No
+ * balance is stored; a sequence of m operations costs O((m + n) log n), and a key searched
+ * with frequency p costs O(log 1/p) amortized, so under a skewed query stream the hot keys
+ * are found within a few steps of the root where an RB tree always descends O(log n).
+ *
+ * Searches restructure the tree, so even a search is a write: a SplayTree must not be
+ * searched from several threads at once.
+ *
+ * \tparam T Type of the values stored in the tree.
+ */
+template <typename T>
+class SplayTree {
+public:
+    /// \defgroup constructors Constructors and destructor
+    /// \{
+    SplayTree() { root_ = nullptr; }
+    ~SplayTree() { DelTree(root_); }
+
+    SplayTree(const SplayTree&) = delete;
+    SplayTree& operator=(const SplayTree&) = delete;
+    /// \}
+
+    /// \defgroup main_methods Insert and search of the tree
+    /// \{
+
+    /**
+     * \brief Insert a new value into the splay tree.
+     *
+     * The key of value is splayed; if the root then holds the key, value is appended to it,
+     * otherwise a new root is placed above the old one, which keeps one of its subtrees.
+     *
+     * \param value Reference to the value to insert.
+     * \return      The node that holds the values with the key of value (the root).
+     */
+    SplayNode<T>* Insert(const T& value) {
+        if (!root_) {
+            root_ = new SplayNode<T>(value);
+            STAT_ADD(stats_, allocations, 1);
+            return root_;
+        }
+
+        Splay(value);
+
+        STAT_ADD(stats_, comparisons, 1);
+        if (value < root_->values_[0]) {
+            SplayNode<T> *node = new SplayNode<T>(value);
+            node->left_ = root_->left_;
+            node->right_ = root_;
+            root_->left_ = nullptr;
+            root_ = node;
+            STAT_ADD(stats_, allocations, 1);
+        } else if (STAT_ADD(stats_, comparisons, 1), value > root_->values_[0]) {
+            SplayNode<T> *node = new SplayNode<T>(value);
+            node->right_ = root_->right_;
+            node->left_ = root_;
+            root_->right_ = nullptr;
+            root_ = node;
+            STAT_ADD(stats_, allocations, 1);
+        } else {
+            root_->values_.push_back(value);
+        }
+
+        return root_;
+    }
+
+    /// @brief Search for all values equal to a given value and splay its key to the root.
+    /// @param value Reference to the value to search for.
+    /// @return The values with the key of value, or nullptr if there are none.
+    const vector<T>* SearchAll(const T& value) {
+        if (!root_) {
+            return nullptr;
+        }
+
+        Splay(value);
+
+        STAT_ADD(stats_, comparisons, 1);
+        return root_->values_[0] == value ? &root_->values_ : nullptr;
+    }
+
+    /**
+     * \brief Replace the contents of the tree with values that are already sorted.
+     *
+     * Equal values are grouped into one node, in input order, and the nodes are linked into
+     * a perfectly balanced tree, the shape the searches then start to adjust.
+     *
+     * \param sorted Pointers to the values, stably sorted by operator<.
+     */
+    void BuildSorted(const vector<const T*>& sorted) {
+        DelTree(root_);
+
+        vector<size_t> groups;
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            if (i == 0 || *sorted[i - 1] < *sorted[i]) {
+                groups.push_back(i);
+            }
+        }
+        size_t count = groups.size();
+        groups.push_back(sorted.size());
+
+        root_ = SupportBuild(sorted, groups, 0, count, 0);
+    }
+
+    /// \brief Instrumentation counters, see stats.h.
+    IndexStats& GetStats() { return stats_; }
+    /// \}
+
+private:
+    SplayNode<T> *root_;  ///< Pointer to the root node of the tree.
+    IndexStats stats_;
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+
+    /**
+     * \brief Top-down splay: make the node of value, or the last node on its search path, the root.
+     *
+     * The descent takes two steps at a time. A zig-zig rotates the parent edge first, which
+     * roughly halves the depth of every node on the path; the nodes passed by are hung on the
+     * left tree (all smaller than value) or on the right tree (all greater), which become the
+     * subtrees of the new root at the end. The tree must not be empty.
+     */
+    void Splay(const T& value) {
+        SplayNode<T> header;
+        SplayNode<T> *left = &header, *right = &header;
+        SplayNode<T> *cur = root_;
+
+        for (;;) {
+            STAT_ADD(stats_, nodes_visited, 1);
+            STAT_ADD(stats_, comparisons, 1);
+            if (value < cur->values_[0]) {
+                if (!cur->left_) {
+                    break;
+                }
+                STAT_ADD(stats_, comparisons, 1);
+                if (value < cur->left_->values_[0]) {
+                    SplayNode<T> *child = cur->left_;
+                    cur->left_ = child->right_;
+                    child->right_ = cur;
+                    cur = child;
+                    STAT_ADD(stats_, rotations, 1);
+                    if (!cur->left_) {
+                        break;
+                    }
+                }
+                right->left_ = cur;
+                right = cur;
+                cur = cur->left_;
+            } else if (STAT_ADD(stats_, comparisons, 1), value > cur->values_[0]) {
+                if (!cur->right_) {
+                    break;
+                }
+                STAT_ADD(stats_, comparisons, 1);
+                if (value > cur->right_->values_[0]) {
+                    SplayNode<T> *child = cur->right_;
+                    cur->right_ = child->left_;
+                    child->left_ = cur;
+                    cur = child;
+                    STAT_ADD(stats_, rotations, 1);
+                    if (!cur->right_) {
+                        break;
+                    }
+                }
+                left->right_ = cur;
+                left = cur;
+                cur = cur->right_;
+            } else {
+                break;
+            }
+        }
+
+        left->right_ = cur->left_;
+        right->left_ = cur->right_;
+        cur->left_ = header.right_;
+        cur->right_ = header.left_;
+        root_ = cur;
+    }
+
+    /// \brief Build a balanced subtree from the groups [lo, hi) of equal values.
+    /// \param groups Start of every group in sorted, followed by sorted.size().
+    SplayNode<T>* SupportBuild(const vector<const T*>& sorted, const vector<size_t>& groups, size_t lo, size_t hi,
+                               int depth) {
+        if (lo >= hi) {
+            return nullptr;
+        }
+
+        size_t mid = lo + (hi - lo) / 2;
+        SplayNode<T> *node = new SplayNode<T>(*sorted[groups[mid]]);
+        node->values_.reserve(groups[mid + 1] - groups[mid]);
+        for (size_t i = groups[mid] + 1; i < groups[mid + 1]; ++i) {
+            node->values_.push_back(*sorted[i]);
+        }
+        STAT_ADD(stats_, allocations, 1);
+        STAT_MAX(stats_, height, depth + 1);
+
+        node->left_ = SupportBuild(sorted, groups, lo, mid, depth + 1);
+        node->right_ = SupportBuild(sorted, groups, mid + 1, hi, depth + 1);
+
+        return node;
+    }
+
+    /// @brief Delete all nodes of the tree rooted at root.
+    ///
+    /// A splay tree can be a long path, so the nodes are deleted without recursion: a left
+    /// child is rotated up until the node has none, then the node is deleted.
+    void DelTree(SplayNode<T> *root) {
+        while (root) {
+            if (root->left_) {
+                SplayNode<T> *child = root->left_;
+                root->left_ = child->right_;
+                child->right_ = root;
+                root = child;
+            } else {
+                SplayNode<T> *next = root->right_;
+                delete root;
+                root = next;
+            }
+        }
+        root_ = nullptr;
+    }
+    /// \}
+};
+
+#endif
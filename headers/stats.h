@@ -0,0 +1,91 @@
+/// \file stats.h
+/// \brief Hot-path instrumentation counters shared by all indexes.
+///
+/// The counters are only updated when the program is compiled with SEARCH_STATS
+/// (`make STATS=1`). Otherwise STAT_ADD and STAT_MAX expand to nothing and the
+/// instrumented code is identical to the uninstrumented one.
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <string>
+
+using namespace std;
+
+#ifdef SEARCH_STATS
+/// \brief Add n to a counter of the current phase.
+#define STAT_ADD(stats, counter, n) ((stats).Current().counter += (n))
+/// \brief Raise a counter of the current phase to at least n.
+#define STAT_MAX(stats, counter, n) ((stats).Current().counter = (stats).Current().counter > (n) ? (stats).Current().counter : (n))
+#else
+#define STAT_ADD(stats, counter, n) ((void)0)
+#define STAT_MAX(stats, counter, n) ((void)0)
+#endif
+
+/// \brief Phase an index is in: building it or answering queries.
+typedef enum { BUILD, QUERY } Phase;
+
+/// \brief Counters collected during one phase.
+struct PhaseStats {
+    long long comparisons = 0;    ///< Key comparisons.
+    long long nodes_visited = 0;  ///< Tree nodes or chain items touched.
+    long long rotations = 0;      ///< Tree rotations.
+    long long probes = 0;         ///< Hash buckets or slots probed.
+    long long allocations = 0;    ///< Nodes, items and payload vectors allocated.
+    long long height = 0;         ///< Largest depth at which an insert placed a node (the height of a BST).
+};
+
+/**
+ * \brief Uniform statistics of an index.
+ *
+ * Every index owns one IndexStats object and returns it from GetStats(). The owner of
+ * the index switches the phase with SetPhase() once the build is finished, so build
+ * and query costs are counted separately.
+ */
+class IndexStats {
+public:
+    /// \brief Counters of the current phase.
+    PhaseStats& Current() { return phases_[phase_]; }
+
+    /// \brief Counters of a given phase.
+    const PhaseStats& Get(Phase phase) const { return phases_[phase]; }
+
+    void SetPhase(Phase phase) { phase_ = phase; }
+    Phase GetPhase() const { return phase_; }
+
+    /// \brief Add the counters of other (e.g. of one partition of a parallel build); heights take the maximum.
+    void Merge(const IndexStats& other) {
+        for (int phase = BUILD; phase <= QUERY; ++phase) {
+            PhaseStats& to = phases_[phase];
+            const PhaseStats& from = other.phases_[phase];
+            to.comparisons += from.comparisons;
+            to.nodes_visited += from.nodes_visited;
+            to.rotations += from.rotations;
+            to.probes += from.probes;
+            to.allocations += from.allocations;
+            to.height = to.height > from.height ? to.height : from.height;
+        }
+    }
+
+    /// \brief Reset both phases and switch back to BUILD.
+    void Reset() {
+        phases_[BUILD] = PhaseStats();
+        phases_[QUERY] = PhaseStats();
+        phase_ = BUILD;
+    }
+
+private:
+    PhaseStats phases_[2];
+    Phase phase_ = BUILD;
+};
+
+/// \brief Check whether the counters are compiled in.
+inline bool statsEnabled() {
+#ifdef SEARCH_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+#endif
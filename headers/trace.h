@@ -0,0 +1,75 @@
+/**
+ * \file  trace.h
+ * \brief Scoped phase tracing of the load-build-query pipeline, exported as Chrome trace-event JSON.
+ *
+ * A TraceSpan records its start and end TSC timestamps into a ring buffer owned by the
+ * current thread, so the hot path takes no locks and does not allocate. Spans are meant
+ * for phases (parsing a file, building an index, a benchmark run, writing a result file),
+ * not for single lookups; their cost is two timestamp reads and a copy of the name.
+ *
+ * Optionally every span also records the hardware counters of its thread (instructions,
+ * cache misses, branch misses) through perf_event_open. If the kernel refuses to open
+ * the counters, spans are recorded without them.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+/// \brief Hardware counters read at the boundaries of a span.
+typedef enum { PERF_INSTRUCTIONS, PERF_CACHE_MISSES, PERF_BRANCH_MISSES, PERF_COUNTERS } PerfCounter;
+
+/// \brief One finished span.
+struct TraceEvent {
+    char name[48] = {};                     ///< Span name, truncated to 47 bytes.
+    long long arg = -1;                     ///< Optional numeric argument (e.g. dataset size), -1 if unset.
+    uint64_t start = 0;                     ///< Start timestamp in tscNow() ticks.
+    uint64_t end = 0;                       ///< End timestamp in tscNow() ticks.
+    long long perf[PERF_COUNTERS] = {};     ///< Counter deltas over the span, -1 if not measured.
+};
+
+/// \brief               Turn tracing on. Spans created before this call are not recorded.
+/// \param perf_counters Also read hardware counters at span boundaries (Linux only).
+void traceEnable(bool perf_counters);
+
+/// \brief  Check whether tracing is on.
+bool traceEnabled();
+
+/// \brief      Write all recorded spans of all threads as a Chrome trace-event JSON file.
+/// \param path Path to the output file; load it in chrome://tracing or Perfetto.
+/// \throws     runtime_error if the file cannot be opened.
+void traceWriteChrome(const string& path);
+
+/**
+ * \brief RAII span: records the time between construction (or Begin()) and destruction (or End()).
+ *
+ * When tracing is off, Begin() and End() only test a flag.
+ */
+class TraceSpan {
+public:
+    TraceSpan() = default;
+    TraceSpan(const string& name, long long arg = -1) { Begin(name, arg); }
+    ~TraceSpan() { End(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    /// \brief Start the span (ends the previous one first).
+    void Begin(const string& name, long long arg = -1);
+
+    /// \brief Finish the span and record it; does nothing if the span is not running.
+    void End();
+
+    /// \brief Finish the span under a name that is only known at its end.
+    void End(const string& name);
+
+private:
+    bool active_ = false;
+    TraceEvent event_;
+};
+
+#endif
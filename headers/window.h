@@ -0,0 +1,107 @@
+/**
+ * \file  window.h
+ * \brief Index over the most recent rows of a stream, kept as a ring of generation segments.
+ */
+
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include "flower.h"
+#include "rows.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+/// \brief Rows and index entries of dropped segments released per Append().
+#define WINDOW_CLEAR_STEP 2
+
+/// \brief Size and age limits of a WindowIndex.
+struct WindowConfig {
+    size_t segment_rows = 4096;     ///< Rows of a segment; a full segment is sealed and the next one opened.
+    size_t segments = 8;            ///< Segments kept; opening one more drops the oldest.
+    double max_age = 0;             ///< Seconds a segment stays searchable after its last row, 0 for no limit.
+};
+
+/**
+ * \class WindowIndex
+ * \brief Searchable window of the last rows of a stream: by count, by age, or both.
+ *
+ * Rows are appended to the open segment, the newest generation. A segment holds its rows in
+ * arrival order and a hash index from name to the positions of its rows. When the open
+ * segment has segment_rows rows it is sealed and a new one is opened; when there are more
+ * than segments of them, the oldest one is dropped. Expire() drops the segments whose last
+ * row is older than max_age. So the window holds between (segments - 1) * segment_rows and
+ * segments * segment_rows rows when it is limited by count.
+ *
+ * Expiry never deletes from an index: the oldest segment leaves the ring with one pop and is
+ * retired. Every Append() then releases up to WINDOW_CLEAR_STEP rows and index entries of the
+ * retired segments, so no single call pays for a whole segment, and a segment is cleared well
+ * before the open one fills up. A cleared segment keeps the capacity of its rows vector and
+ * the bucket array of its index and is reused by the next segment that is opened; the index
+ * entries and their position lists are freed with it and allocated again as rows arrive. So
+ * after the first segments * segment_rows rows the memory of the window stays flat however
+ * long the stream runs.
+ *
+ * A search asks every live segment, oldest first, so matches come in arrival order.
+ */
+class WindowIndex {
+public:
+    WindowIndex(const WindowConfig& config);
+
+    /// \brief Append a row that arrived at time (in seconds, non-decreasing; ignored without max_age).
+    void Append(const Flower& row, double time = 0);
+
+    /**
+     * \brief Drop the segments whose last row arrived before now - max_age.
+     * \return Number of rows dropped.
+     */
+    size_t Expire(double now);
+
+    /// \brief The rows named name in the window, in arrival order.
+    vector<const Flower*> SearchAll(const string& name) const;
+
+    /// \brief Number of rows in the window.
+    size_t GetCount() const { return count_; }
+
+    /// \brief Number of live segments, the open one included.
+    size_t GetSegments() const { return ring_.size(); }
+
+    /// \brief Generation of the oldest live segment; generations count the segments ever opened.
+    uint64_t GetFirstGeneration() const { return ring_.empty() ? next_generation_ : ring_.front()->generation_; }
+
+private:
+    struct Segment {
+        uint64_t generation_ = 0;
+        double last_time_ = 0;                          ///< Arrival time of the newest row.
+        vector<Flower> rows_;
+        unordered_map<string, vector<RowId>> index_;    ///< Positions in rows_ by name.
+    };
+
+    WindowConfig config_;
+    deque<unique_ptr<Segment>> ring_;   ///< Oldest first; the last one is open.
+    deque<unique_ptr<Segment>> retired_;///< Dropped segments being cleared, oldest first.
+    unique_ptr<Segment> spare_;         ///< A cleared segment, reused by the next one opened.
+    uint64_t next_generation_ = 0;
+    size_t count_ = 0;
+
+private:
+    /// \defgroup supporting_methods Supporting methods for basic methods
+    /// \{
+
+    /// \brief Seal the open segment and open the next generation, dropping the oldest if the ring is full.
+    void Open();
+
+    /// \brief Remove the oldest segment from the ring and retire it.
+    void DropOldest();
+
+    /// \brief Release up to WINDOW_CLEAR_STEP rows and index entries of the retired segments.
+    void ClearStep();
+    /// \}
+};
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * \file  workload.h
+ * \brief Query workload generation and trace recording/replay.
+ *
+ * A workload is a stream of operations that is sent through every structure in the same order:
+ * lookups of existing names (hits), lookups of absent names (misses) and inserts of new rows.
+ */
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include "flower.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// \brief Kind of a workload operation.
+typedef enum { READ, INSERT } OpType;
+
+/// \brief One operation of a workload.
+struct Operation {
+    OpType type = READ;   ///< Lookup or insert.
+    string key;           ///< Name that is searched or inserted.
+    Flower row;           ///< Row to insert; for a lookup only the name is set.
+};
+
+/// \brief Parameters of a generated workload.
+struct WorkloadConfig {
+    size_t operations = 2000;   ///< Length of the stream.
+    double hit_ratio = 1.0;     ///< Share of operations on names that exist in the dataset.
+    double zipf = 0;            ///< Skew of the name popularity, 0 gives a uniform distribution.
+    double insert_ratio = 0;    ///< Share of inserts, the rest are lookups.
+    unsigned seed = 42;         ///< Seed of the generator.
+};
+
+/// \brief        Generate a workload over the names of a dataset.
+/// \param data   Dataset whose names are used for hits; inserted rows copy attributes of random rows.
+/// \param config Length, hit ratio, popularity skew, insert share and seed.
+/// \return       The operations in execution order.
+///
+/// \details
+/// The distinct names are ranked in a seeded random order and drawn by Zipf popularity of their rank.
+/// A miss uses a drawn name with a "#<n>" suffix, which never occurs in a dataset.
+vector<Operation> makeWorkload(const vector<Flower>& data, const WorkloadConfig& config);
+
+/// \brief            Write a workload to a text trace, one operation per line.
+/// \param path       Path to the trace file.
+/// \param operations Operations to write.
+/// \throws           runtime_error if the file cannot be opened.
+///
+/// \details
+/// A lookup is written as "R<TAB>name", an insert as "I<TAB>name<TAB>color<TAB>smell<TAB>region;region".
+void saveTrace(const string& path, const vector<Operation>& operations);
+
+/// \brief      Read a trace written by saveTrace().
+/// \param path Path to the trace file.
+/// \throws     runtime_error if the file cannot be opened or a line is malformed.
+/// \return     The operations in execution order.
+vector<Operation> loadTrace(const string& path);
+
+#endif
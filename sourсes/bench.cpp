@@ -0,0 +1,154 @@
+/// \file  bench.cpp
+/// \brief Implements timer calibration, percentile summaries and result export.
+
+#include "../headers/bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdexcept>
+
+/// \brief Seconds per tick of tscNow(), measured against steady_clock over 20 ms.
+static double calibrateTsc() {
+    auto start_time = chrono::steady_clock::now();
+    uint64_t start = tscNow();
+
+    while (chrono::steady_clock::now() - start_time < chrono::milliseconds(20)) {
+    }
+
+    uint64_t end = tscNow();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start_time;
+    return elapsed.count() / (double)(end - start);
+}
+
+double tscSeconds() {
+    // Pool threads call this too; the initialization of a local static runs exactly once.
+    static const double seconds = calibrateTsc();
+    return seconds;
+}
+
+BenchResult summarize(const string& name, vector<uint64_t>& ticks) {
+    BenchResult res;
+    res.name = name;
+    res.samples = ticks.size();
+
+    if (ticks.empty()) {
+        return res;
+    }
+
+    sort(ticks.begin(), ticks.end());
+
+    double sum = 0;
+    for (uint64_t t : ticks) {
+        sum += t;
+    }
+
+    double scale = tscSeconds();
+    auto percentile = [&](double p) { return ticks[(size_t)(p * (ticks.size() - 1))] * scale; };
+
+    res.mean = sum / ticks.size() * scale;
+    res.p50 = percentile(0.5);
+    res.p99 = percentile(0.99);
+    res.p999 = percentile(0.999);
+
+    return res;
+}
+
+vector<BuildResult> BuildScheduler::Run() {
+    vector<BuildResult> results(builds_.size());
+    vector<function<void()>> tasks;
+
+    for (size_t i = 0; i < builds_.size(); ++i) {
+        tasks.push_back([this, &results, i] {
+            BuildMeter meter;
+            meter.Start();
+            builds_[i].second();
+            results[i] = meter.Stop(builds_[i].first);
+        });
+    }
+
+    uint64_t start = tscNow();
+    pool_.RunAll(std::move(tasks));
+    seconds_ = (tscNow() - start) * tscSeconds();
+
+    builds_.clear();
+    return results;
+}
+
+/// \brief Check whether a file is missing or empty, so that a CSV header must be written.
+static bool isEmptyFile(const string& path) {
+    ifstream check(path);
+    return !check.is_open() || check.peek() == ifstream::traits_type::eof();
+}
+
+void writeBuildCSV(const string& path, long size, size_t distinct, const vector<BuildResult>& results) {
+    bool empty = isEmptyFile(path);
+
+    ofstream fout(path, ofstream::app);
+    if (!fout.is_open()) {
+        throw std::runtime_error("Cannot open file for writing: " + path);
+    }
+
+    if (empty) {
+        fout << "size,structure,build_seconds,peak_bytes,steady_bytes,bytes_per_row,peak_bytes_per_row,bytes_per_key,allocations" << endl;
+    }
+
+    for (const BuildResult& r : results) {
+        fout << size << "," << r.name << "," << r.seconds << "," << r.peak_bytes << "," << r.steady_bytes << ","
+             << (double)r.steady_bytes / (size ? size : 1) << "," << (double)r.peak_bytes / (size ? size : 1) << ","
+             << (double)r.steady_bytes / (distinct ? distinct : 1) << "," << r.allocations << endl;
+    }
+}
+
+void writeStatsCSV(const string& path, long size, const vector<pair<string, IndexStats>>& stats) {
+    bool empty = isEmptyFile(path);
+
+    ofstream fout(path, ofstream::app);
+    if (!fout.is_open()) {
+        throw std::runtime_error("Cannot open file for writing: " + path);
+    }
+
+    if (empty) {
+        fout << "size,structure,phase,comparisons,nodes_visited,rotations,probes,allocations,height" << endl;
+    }
+
+    for (const auto& index : stats) {
+        for (Phase phase : { BUILD, QUERY }) {
+            const PhaseStats& counters = index.second.Get(phase);
+            fout << size << "," << index.first << "," << (phase == BUILD ? "build" : "query") << ","
+                 << counters.comparisons << "," << counters.nodes_visited << "," << counters.rotations << ","
+                 << counters.probes << "," << counters.allocations << "," << counters.height << endl;
+        }
+    }
+}
+
+void writeBenchCSV(const string& path, long size, const vector<BenchResult>& results) {
+    bool empty = isEmptyFile(path);
+
+    ofstream fout(path, ofstream::app);
+    if (!fout.is_open()) {
+        throw std::runtime_error("Cannot open file for writing: " + path);
+    }
+
+    if (empty) {
+        fout << "size,structure,samples,mean,p50,p99,p999" << endl;
+    }
+
+    for (const BenchResult& r : results) {
+        fout << size << "," << r.name << "," << r.samples << "," << r.mean << ","
+             << r.p50 << "," << r.p99 << "," << r.p999 << endl;
+    }
+}
+
+void writeBenchJSON(const string& path, long size, const vector<BenchResult>& results) {
+    ofstream fout(path, ofstream::app);
+    if (!fout.is_open()) {
+        throw std::runtime_error("Cannot open file for writing: " + path);
+    }
+
+    for (const BenchResult& r : results) {
+        fout << "{\"size\": " << size << ", \"structure\": \"" << r.name << "\", \"samples\": " << r.samples
+             << ", \"mean\": " << r.mean << ", \"p50\": " << r.p50 << ", \"p99\": " << r.p99
+             << ", \"p999\": " << r.p999 << "}" << endl;
+    }
+}
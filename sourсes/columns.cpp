@@ -0,0 +1,324 @@
+/// \file  columns.cpp
+/// \brief Implements the dictionary encoding and the SIMD filter, count and group-by kernels of ColumnStore.
+
+#include "../headers/columns.h"
+#include "../headers/trace.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/// \defgroup column_kernels Block kernels: one bit per row of a COLUMN_BLOCK-row block
+/// \{
+
+/// \brief Rows of a block whose byte code is value.
+static inline uint32_t equalBytes(const uint8_t *codes, uint8_t value) {
+#if defined(__AVX2__)
+    __m256i block = _mm256_loadu_si256((const __m256i*)codes);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8((char)value)));
+#elif defined(__SSE2__)
+    __m128i needle = _mm_set1_epi8((char)value);
+    uint32_t low = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)codes), needle));
+    uint32_t high = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(codes + 16)), needle));
+    return low | high << 16;
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < COLUMN_BLOCK; ++i) {
+        mask |= (uint32_t)(codes[i] == value) << i;
+    }
+    return mask;
+#endif
+}
+
+/// \brief Rows of a block whose 32-bit word is value (any_bits false) or shares a bit with it (any_bits true).
+static inline uint32_t matchWords(const uint32_t *words, uint32_t value, bool any_bits) {
+#if defined(__AVX2__)
+    __m256i needle = _mm256_set1_epi32((int)value);
+    __m256i zero = _mm256_setzero_si256();
+    uint32_t mask = 0;
+    for (int i = 0; i < COLUMN_BLOCK; i += 8) {
+        __m256i block = _mm256_loadu_si256((const __m256i*)(words + i));
+        __m256i hit = any_bits ? _mm256_cmpeq_epi32(_mm256_and_si256(block, needle), zero)
+                               : _mm256_cmpeq_epi32(block, needle);
+        mask |= (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(hit)) << i;
+    }
+    return any_bits ? ~mask : mask;
+#elif defined(__SSE2__)
+    __m128i needle = _mm_set1_epi32((int)value);
+    __m128i zero = _mm_setzero_si128();
+    uint32_t mask = 0;
+    for (int i = 0; i < COLUMN_BLOCK; i += 4) {
+        __m128i block = _mm_loadu_si128((const __m128i*)(words + i));
+        __m128i hit = any_bits ? _mm_cmpeq_epi32(_mm_and_si128(block, needle), zero) : _mm_cmpeq_epi32(block, needle);
+        mask |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(hit)) << i;
+    }
+    return any_bits ? ~mask : mask;
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < COLUMN_BLOCK; ++i) {
+        mask |= (uint32_t)(any_bits ? (words[i] & value) != 0 : words[i] == value) << i;
+    }
+    return mask;
+#endif
+}
+/// \}
+
+/// \brief Sort the distinct values of a column into its dictionary and replace every value by its code.
+template <typename Code>
+static void encode(const vector<const string*>& values, vector<string>& dict, vector<Code>& codes) {
+    unordered_map<string, uint32_t> index;
+    for (const string *value : values) {
+        index.emplace(*value, 0);
+    }
+
+    dict.clear();
+    for (const auto& entry : index) {
+        dict.push_back(entry.first);
+    }
+    sort(dict.begin(), dict.end());
+    for (size_t i = 0; i < dict.size(); ++i) {
+        index[dict[i]] = (uint32_t)i;
+    }
+
+    codes.resize(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        codes[i] = (Code)index[*values[i]];
+    }
+}
+
+ColumnStore::ColumnStore(const vector<Flower>& rows, ThreadPool& pool) : pool_(pool) {
+    TraceSpan span("build columns", rows.size());
+    vector<const string*> names(rows.size()), colors(rows.size()), smells(rows.size()), regions;
+
+    for (size_t i = 0; i < rows.size(); ++i) {
+        names[i] = &rows[i].GetName();
+        colors[i] = &rows[i].GetColor();
+        smells[i] = &rows[i].GetSmell();
+        for (const string& region : rows[i].GetRegions()) {
+            regions.push_back(&region);
+        }
+    }
+
+    vector<uint8_t> region_codes;
+    vector<function<void()>> columns = {
+        [&] { encode(names, dicts_[COL_NAME], names_); },
+        [&] { encode(colors, dicts_[COL_COLOR], colors_); },
+        [&] { encode(smells, dicts_[COL_SMELL], smells_); },
+        [&] { encode(regions, dicts_[COL_REGION], region_codes); },
+    };
+    pool_.RunAll(std::move(columns));
+
+    if (dicts_[COL_COLOR].size() > 256 || dicts_[COL_SMELL].size() > 256) {
+        throw runtime_error("Too many distinct colors or smells for 8-bit codes");
+    }
+    if (dicts_[COL_REGION].size() > MAX_REGIONS) {
+        throw runtime_error("Too many distinct regions for a " + to_string(MAX_REGIONS) + "-bit mask");
+    }
+
+    regions_.assign(rows.size(), 0);
+    size_t next = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        for (size_t j = 0; j < rows[i].GetRegions().size(); ++j) {
+            regions_[i] |= 1u << region_codes[next++];
+        }
+    }
+}
+
+int ColumnStore::Code(ColumnId column, const string& value) const {
+    const vector<string>& dict = dicts_[column];
+    auto it = lower_bound(dict.begin(), dict.end(), value);
+    return it != dict.end() && *it == value ? (int)(it - dict.begin()) : NO_VALUE;
+}
+
+template <typename Body>
+void ColumnStore::ForRanges(Body body) const {
+    size_t blocks = (GetRows() + COLUMN_BLOCK - 1) / COLUMN_BLOCK;
+    size_t parts = min<size_t>(pool_.GetThreads(), max<size_t>(blocks, 1));
+    vector<function<void()>> tasks;
+
+    for (size_t p = 0; p < parts; ++p) {
+        size_t begin = min(GetRows(), blocks * p / parts * COLUMN_BLOCK);
+        size_t end = min(GetRows(), blocks * (p + 1) / parts * COLUMN_BLOCK);
+        tasks.push_back([&body, p, begin, end] { body(p, begin, end); });
+    }
+
+    pool_.RunAll(std::move(tasks));
+}
+
+template <typename Add>
+void ColumnStore::ForEachValue(ColumnId column, size_t row, Add add) const {
+    switch (column) {
+    case COL_NAME:
+        add(names_[row]);
+        break;
+    case COL_COLOR:
+        add(colors_[row]);
+        break;
+    case COL_SMELL:
+        add(smells_[row]);
+        break;
+    default:
+        for (uint32_t mask = regions_[row]; mask; mask &= mask - 1) {
+            add((uint32_t)__builtin_ctz(mask));
+        }
+        break;
+    }
+}
+
+template <typename Visit>
+void ColumnStore::ForEachMatch(size_t begin, size_t end, const ColumnFilter& filter, Visit visit) const {
+    for (size_t i = begin; i < end; i += COLUMN_BLOCK) {
+        uint32_t mask = Match(i, min(end, i + COLUMN_BLOCK), filter);
+        while (mask) {
+            visit(i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+}
+
+uint64_t ColumnStore::Count(const ColumnFilter& filter) const {
+    vector<uint64_t> counts(pool_.GetThreads(), 0);
+
+    ForRanges([&](size_t part, size_t begin, size_t end) {
+        uint64_t count = 0;
+        for (size_t i = begin; i < end; i += COLUMN_BLOCK) {
+            count += __builtin_popcount(Match(i, min(end, i + COLUMN_BLOCK), filter));
+        }
+        counts[part] = count;
+    });
+
+    uint64_t res = 0;
+    for (uint64_t count : counts) {
+        res += count;
+    }
+    return res;
+}
+
+vector<uint64_t> ColumnStore::CountBy(ColumnId column, const ColumnFilter& filter) const {
+    size_t groups = dicts_[column].size();
+    vector<vector<uint64_t>> parts(pool_.GetThreads(), vector<uint64_t>(groups, 0));
+    bool all = filter.name == ANY_VALUE && filter.color == ANY_VALUE && filter.smell == ANY_VALUE &&
+               filter.region == ANY_VALUE;
+
+    ForRanges([&](size_t part, size_t begin, size_t end) {
+        vector<uint64_t>& hist = parts[part];
+        if (all && column != COL_REGION) {
+            Histogram(column, begin, end, hist.data());
+        } else {
+            ForEachMatch(begin, end, filter, [&](size_t row) {
+                ForEachValue(column, row, [&](uint32_t code) { hist[code] += 1; });
+            });
+        }
+    });
+
+    for (size_t p = 1; p < parts.size(); ++p) {
+        for (size_t g = 0; g < groups; ++g) {
+            parts[0][g] += parts[p][g];
+        }
+    }
+    return parts[0];
+}
+
+vector<uint64_t> ColumnStore::CountBy(ColumnId first, ColumnId second, const ColumnFilter& filter) const {
+    size_t width = dicts_[second].size();
+    size_t groups = dicts_[first].size() * width;
+    vector<vector<uint64_t>> parts(pool_.GetThreads(), vector<uint64_t>(groups, 0));
+
+    ForRanges([&](size_t part, size_t begin, size_t end) {
+        vector<uint64_t>& hist = parts[part];
+        ForEachMatch(begin, end, filter, [&](size_t row) {
+            ForEachValue(first, row, [&](uint32_t a) {
+                ForEachValue(second, row, [&](uint32_t b) { hist[a * width + b] += 1; });
+            });
+        });
+    });
+
+    for (size_t p = 1; p < parts.size(); ++p) {
+        for (size_t g = 0; g < groups; ++g) {
+            parts[0][g] += parts[p][g];
+        }
+    }
+    return parts[0];
+}
+
+uint32_t ColumnStore::Match(size_t begin, size_t end, const ColumnFilter& filter) const {
+    if (filter.name == NO_VALUE || filter.color == NO_VALUE || filter.smell == NO_VALUE || filter.region == NO_VALUE) {
+        return 0;
+    }
+
+    uint32_t mask = end - begin == COLUMN_BLOCK ? ~0u : (1u << (end - begin)) - 1;
+
+    if (end - begin < COLUMN_BLOCK) {
+        // The last, partial block: test row by row instead of reading past the columns.
+        for (size_t i = begin; i < end; ++i) {
+            bool pass = (filter.name == ANY_VALUE || names_[i] == (uint32_t)filter.name) &&
+                        (filter.color == ANY_VALUE || colors_[i] == filter.color) &&
+                        (filter.smell == ANY_VALUE || smells_[i] == filter.smell) &&
+                        (filter.region == ANY_VALUE || (regions_[i] >> filter.region & 1));
+            mask &= ~((uint32_t)!pass << (i - begin));
+        }
+        return mask;
+    }
+
+    if (filter.color != ANY_VALUE) {
+        mask &= equalBytes(colors_.data() + begin, (uint8_t)filter.color);
+    }
+    if (filter.smell != ANY_VALUE) {
+        mask &= equalBytes(smells_.data() + begin, (uint8_t)filter.smell);
+    }
+    if (filter.name != ANY_VALUE && mask) {
+        mask &= matchWords(names_.data() + begin, (uint32_t)filter.name, false);
+    }
+    if (filter.region != ANY_VALUE && mask) {
+        mask &= matchWords(regions_.data() + begin, 1u << filter.region, true);
+    }
+    return mask;
+}
+
+
+void ColumnStore::Histogram(ColumnId column, size_t begin, size_t end, uint64_t *hist) const {
+    size_t groups = dicts_[column].size();
+
+    // With about as many groups as rows, equal neighbours are rare and the lanes only cost memory.
+    if (4 * groups > end - begin) {
+        for (size_t i = begin; i < end; ++i) {
+            ForEachValue(column, i, [&](uint32_t code) { hist[code] += 1; });
+        }
+        return;
+    }
+
+    vector<uint32_t> lanes(4 * groups, 0);
+    uint32_t *h0 = lanes.data(), *h1 = h0 + groups, *h2 = h1 + groups, *h3 = h2 + groups;
+
+    // A lane counts a quarter of the rows of the range, which RowId keeps below 2^32.
+    auto count = [&](const auto *codes) {
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            h0[codes[i]] += 1;
+            h1[codes[i + 1]] += 1;
+            h2[codes[i + 2]] += 1;
+            h3[codes[i + 3]] += 1;
+        }
+        for (; i < end; ++i) {
+            h0[codes[i]] += 1;
+        }
+    };
+
+    if (column == COL_NAME) {
+        count(names_.data());
+    } else {
+        count(column == COL_COLOR ? colors_.data() : smells_.data());
+    }
+
+    for (size_t g = 0; g < groups; ++g) {
+        hist[g] += (uint64_t)h0[g] + h1[g] + h2[g] + h3[g];
+    }
+}
+
+
@@ -9,10 +9,11 @@ Flower::Flower(string name, string color, string smell, vector<string> regions)
     color_ = color;
     smell_ = smell;
     regions_ = regions;
+    key_.Assign(name_);
 }
 
 bool Flower::EqFlowers(const Flower& other) const {
-    if (name_ == other.name_) {
+    if (CompareNames(other) == 0) {
         return true;
     }
     return false;
@@ -20,18 +21,12 @@ bool Flower::EqFlowers(const Flower& other) const {
 
 /// \brief "Greater than" operator based on key fields.
 bool Flower::operator>(const Flower& other) const {
-    if (name_ != other.name_) {
-        return name_ > other.name_;
-    }
-    return false;
+    return CompareNames(other) > 0;
 }
 
 /// \brief "Less than" operator based on key fields.
 bool Flower::operator<(const Flower& other) const {
-    if (name_ != other.name_) {
-        return name_ < other.name_;
-    }
-    return false;
+    return CompareNames(other) < 0;
 }
 
 /// \brief "Greater than or equal to" operator based on key fields.
@@ -56,6 +51,7 @@ bool Flower::operator==(const Flower& other) const {
 
 /// \brief Copy assignment operator.
 Flower& Flower::operator=(const Flower& other) {
+    key_ = other.key_;
     name_ = other.name_;
     color_ = other.color_;
     smell_ = other.smell_;
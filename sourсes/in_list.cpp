@@ -0,0 +1,74 @@
+/// \file  in_list.cpp
+/// \brief Implements the IN-list lookups over the RB tree, the hash table and the sorted array.
+
+#include "../headers/in_list.h"
+
+#include <algorithm>
+
+/// \brief Pair every name with its matches and drop the names without any.
+template <typename Rows, typename Matches>
+static vector<KeyGroup<Rows>> groupMatches(vector<string>& names, const vector<Matches>& matches) {
+    vector<KeyGroup<Rows>> res;
+
+    for (size_t i = 0; i < names.size(); ++i) {
+        Rows rows = Rows(matches[i]);
+        if (!rows.empty()) {
+            res.push_back(KeyGroup<Rows>{ std::move(names[i]), rows });
+        }
+    }
+
+    return res;
+}
+
+vector<string> inListKeys(const vector<string>& keys) {
+    // Sort references by the 8-byte prefix first; the names are only read on equal prefixes.
+    vector<pair<uint64_t, const string*>> order;
+    order.reserve(keys.size());
+    for (const string& key : keys) {
+        order.push_back({ keyPrefix(key), &key });
+    }
+    sort(order.begin(), order.end(), [](const auto& l, const auto& r) {
+        return l.first != r.first ? l.first < r.first : *l.second < *r.second;
+    });
+
+    vector<string> names;
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i == 0 || *order[i - 1].second != *order[i].second) {
+            names.push_back(*order[i].second);
+        }
+    }
+    return names;
+}
+
+vector<KeyGroup<span<const Flower>>> searchIn(RBTree<Flower>& tree, const vector<string>& keys) {
+    vector<string> names = inListKeys(keys);
+
+    vector<Flower> probes;
+    probes.reserve(names.size());
+    for (const string& name : names) {
+        probes.push_back(Flower(name, "", "", {}));
+    }
+
+    vector<span<const Flower>> matches;
+    for (RBNode<Flower> *node : tree.SearchSorted(probes)) {
+        matches.push_back(node ? span<const Flower>(node->values_) : span<const Flower>());
+    }
+
+    return groupMatches<span<const Flower>>(names, matches);
+}
+
+vector<KeyGroup<span<const Flower>>> searchIn(const HashTable& table, const vector<string>& keys) {
+    vector<string> names = inListKeys(keys);
+
+    vector<span<const Flower>> matches;
+    for (vector<Flower> *values : table.SearchBatch(names)) {
+        matches.push_back(values ? span<const Flower>(*values) : span<const Flower>());
+    }
+
+    return groupMatches<span<const Flower>>(names, matches);
+}
+
+vector<KeyGroup<RowRange>> searchIn(const SortedIndex& index, const vector<string>& keys) {
+    vector<string> names = inListKeys(keys);
+    return groupMatches<RowRange>(names, index.SearchSorted(names));
+}
@@ -5,16 +5,125 @@
 #include "../headers/linear.h"
 #include "../headers/binary_tree.h"
 #include "../headers/rb_tree.h"
+#include "../headers/compact_rb_tree.h"
+#include "../headers/splay_tree.h"
+#include "../headers/skip_list.h"
+#include "../headers/in_list.h"
+#include "../headers/window.h"
+#include "../headers/memory.h"
 #include "../headers/hash.h"
+#include "../headers/mph.h"
+#include "../headers/sorted_index.h"
+#include "../headers/learned.h"
+#include "../headers/filter.h"
+#include "../headers/cache.h"
+#include "../headers/bench.h"
+#include "../headers/trace.h"
+#include "../headers/sink.h"
+#include "../headers/index.h"
+#include "../headers/row_store.h"
+#include "../headers/live.h"
+#include "../headers/columns.h"
 
 #include <fstream>
-#include <chrono>
 #include <algorithm>
 #include <stdexcept>
 #include <iostream>
 #include <map>
+#include <functional>
+#include <memory>
+#include <unordered_set>
+#include <mutex>
+#include <cstring>
+
+/// \brief Number of timed queries for the linear search, which is too slow for the full workload.
+#define LINEAR_QUERIES 200
+/// \brief Number of absent keys used to measure the miss latency of every index.
+#define MISS_QUERIES 200
+/// \brief Number of absent keys used to measure the false-positive rate of the filter.
+#define FPR_PROBES 100000
+/// \brief Number of repeated lookups of the hot key through the result cache.
+#define CACHE_QUERIES 2000
+/// \brief Maximum number of results kept by the result cache.
+#define CACHE_CAPACITY 1000
+/// \brief Number of keys upserted and removed, and of rows updated and erased in the row store.
+#define UPDATE_QUERIES 200
+/// \brief Number of timed runs of every aggregation query over the column store.
+#define AGGREGATE_QUERIES 20
+/// \brief Skews of the read-only workloads on which the RB and splay trees are compared.
+#define ZIPF_SKEWS { 0.0, 0.8, 1.2 }
+/// \brief Number of names of the IN-list query, half of them absent.
+#define IN_LIST_KEYS 500
+/// \brief Number of timed runs of every IN-list query.
+#define IN_LIST_QUERIES 20
+/// \brief Passes of the dataset streamed through the window index.
+#define WINDOW_PASSES 10
+/// \brief Segments of the window index; together they hold about one dataset.
+#define WINDOW_SEGMENTS 8
+/// \brief Seconds a row stays in the time-bounded window; the stream delivers one dataset per second.
+#define WINDOW_MAX_AGE 0.5
+/// \brief Thread counts at which concurrent inserts and lookups are measured.
+#define SCALING_THREADS { 1, 2, 4 }
+
+/// \brief Parse one data line of a dataset CSV, see parserCSV().
+static Flower parseLine(const string& line) {
+    string name, color, smell, regions_str;
+    vector<string> regions;
+    int ind1 = -1, ind2 = -1, ind3 = -1; 
+
+    for (int i = 0; i < line.size(); ++i) {
+        if (line[i] == ',') {
+            if (ind1 == -1) {
+                ind1 = i;
+            } else if (ind2 == -1) {
+                ind2 = i;
+            } else {
+                ind3 = i;
+                break;
+            }
+        }
+    }
+
+    name = line.substr(0, ind1);
+    color = line.substr(ind1 + 1, ind2 - ind1 - 1);
+    smell = line.substr(ind2 + 1, ind3 - ind2 - 1);
+    regions_str = line.substr(ind3 + 3, line.size() - 2 - ind3 - 3);
+
+    ind1 = -1, ind2 = -1;
+
+    for (int j = 0; j < regions_str.size(); ++j) {
+        if (regions_str[j] == ',') {
+            if (ind1 == -1) {
+                ind1 = j;
+            } else {
+                ind2 = j;
+                break;
+            } 
+        }
+    }
+
+    if (ind1 == -1) {
+        string region1 = regions_str;
+        regions.push_back(region1);
+    } else if (ind2 == -1) {
+        string region1 = regions_str.substr(1, ind1 - 2);
+        string region2 = regions_str.substr(ind1 + 3, regions_str.size() - ind1 - 4);
+        regions.push_back(region1);
+        regions.push_back(region2);
+    } else {
+        string region1 = regions_str.substr(1, ind1 - 2);
+        string region2 = regions_str.substr(ind1 + 3, ind2 - ind1 - 4);
+        string region3 = regions_str.substr(ind2 + 3, regions_str.size() - ind2 - 4);
+        regions.push_back(region1);
+        regions.push_back(region2);
+        regions.push_back(region3);
+    }
+
+    return Flower(name, color, smell, regions);
+}
 
 vector<Flower> parserCSV(string filename) {
+    TraceSpan span("parserCSV");
     ifstream file(filename);
 
     if (!file.is_open()) {
@@ -28,72 +137,53 @@ vector<Flower> parserCSV(string filename) {
         return tmp_vector;
     }
 
-    string name, color, smell, regions_str;
-    vector<string> regions;
-
     while(getline(file, line)) {
-        regions.clear();
-        int ind1 = -1, ind2 = -1, ind3 = -1; 
-
-        for (int i = 0; i < line.size(); ++i) {
-            if (line[i] == ',') {
-                if (ind1 == -1) {
-                    ind1 = i;
-                } else if (ind2 == -1) {
-                    ind2 = i;
-                } else {
-                    ind3 = i;
-                    break;
-                }
-            }
-        }
+        tmp_vector.push_back(parseLine(line));
+    }
 
-        name = line.substr(0, ind1);
-        color = line.substr(ind1 + 1, ind2 - ind1 - 1);
-        smell = line.substr(ind2 + 1, ind3 - ind2 - 1);
-        regions_str = line.substr(ind3 + 3, line.size() - 2 - ind3 - 3);
+    return tmp_vector;
+}
 
-        ind1 = -1, ind2 = -1;
+vector<Flower> parserCSVTail(const string& filename, size_t& offset, size_t max_rows) {
+    TraceSpan span("parserCSVTail");
+    ifstream file(filename, ios::binary);
 
-        for (int j = 0; j < regions_str.size(); ++j) {
-            if (regions_str[j] == ',') {
-                if (ind1 == -1) {
-                    ind1 = j;
-                } else {
-                    ind2 = j;
-                    break;
-                } 
-            }
-        }
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open CSV file: " + filename);
+    }
 
-        if (ind1 == -1) {
-            string region1 = regions_str;
-            regions.push_back(region1);
-        } else if (ind2 == -1) {
-            string region1 = regions_str.substr(1, ind1 - 2);
-            string region2 = regions_str.substr(ind1 + 3, regions_str.size() - ind1 - 4);
-            regions.push_back(region1);
-            regions.push_back(region2);
-        } else {
-            string region1 = regions_str.substr(1, ind1 - 2);
-            string region2 = regions_str.substr(ind1 + 3, ind2 - ind1 - 4);
-            string region3 = regions_str.substr(ind2 + 3, regions_str.size() - ind2 - 4);
-            regions.push_back(region1);
-            regions.push_back(region2);
-            regions.push_back(region3);
-        }
+    vector<Flower> tmp_vector;
+    string line;
+    file.seekg(offset);
 
-        Flower tmp(name, color, smell, regions);
-        tmp_vector.push_back(tmp);
+    // A line counts only when its newline has been written; a partial last line is read next time.
+    while (tmp_vector.size() < max_rows && getline(file, line) && !file.eof()) {
+        if (offset != 0) {
+            tmp_vector.push_back(parseLine(line));
+        }
+        offset += line.size() + 1;
     }
 
     return tmp_vector;
 }
 
-void saveRes(vector<Flower>& source, long size, Flower target) {
+void parserCSVChunk(const char *data, size_t size, vector<Flower>& out) {
+    TraceSpan span("parserCSVChunk", size);
+    string line;
+
+    for (size_t pos = 0; pos < size; ) {
+        const char *end = (const char*)memchr(data + pos, '\n', size - pos);
+        size_t length = end ? end - (data + pos) : size - pos;
+
+        line.assign(data + pos, length);
+        out.push_back(parseLine(line));
+        pos += length + 1;
+    }
+}
+
+void saveRes(vector<Flower>& source, long size, Flower target, const vector<Operation>& workload) {
     Flower* data = source.data();
     string size_str = to_string(size);
-    int cntReg = 0;
 
     vector<int> res_a;
 
@@ -104,6 +194,11 @@ void saveRes(vector<Flower>& source, long size, Flower target) {
     c = base + "_rb.txt";
     d = base + "_hash.txt";
     e = base + "_multimap.txt";
+    string f = base + "_mph.txt";
+    string g = base + "_sorted.txt";
+    string l = base + "_learned.txt";
+    string r = base + "_rb_compact.txt";
+    string y = base + "_splay.txt";
 
 
 
@@ -114,181 +209,918 @@ void saveRes(vector<Flower>& source, long size, Flower target) {
 
     fout << "Datasets" << size << ":" << endl;
 
-    ofstream fout1(a);
-    if (!fout1.is_open()) {
-        throw std::runtime_error("Cannot open file for writing: " + a);
-    }
+    BenchConfig config;
+    BenchConfig linear_config;
+    linear_config.warmup = LINEAR_QUERIES / 10;
+    linear_config.repetitions = 1;
 
-    auto start = chrono::high_resolution_clock::now();
-    res_a = searchAll(data, size, target);
-    auto end = chrono::high_resolution_clock::now();
-    chrono::duration<float> duration = end - start;
-
-    fout << "1. Linear search time: " << duration.count() << endl;
+    vector<Operation> linear_workload(workload.begin(), workload.begin() + min<size_t>(LINEAR_QUERIES, workload.size()));
 
-    for (long i = 0; i < res_a.size(); ++i) {
-        fout1 << res_a[i] << ": \t" << data[res_a[i]].GetName() << ";" << data[res_a[i]].GetColor() << ";" << data[res_a[i]].GetSmell() << ";";
+    vector<BenchResult> results;
+    vector<BenchResult> inserts;    ///< Insert latency of the structures that take the inserts of the workload.
+    vector<BuildResult> builds;
+    BuildMeter meter;
+    TraceSpan write_span;
+    SinkWriter writer;
 
-        cntReg = data[res_a[i]].GetRegions().size();
-        for (int j = 0; j < cntReg; ++j) {
-            fout1 << data[res_a[i]].GetRegions()[j];
-            if (j != cntReg-1) {
-                fout1 << ",";
-            }
+    ThreadPool pool;
+    Tree<Flower> tree_b;
+    RBTree<Flower> tree_c;
+    unique_ptr<HashTable> table_ptr;
+    std::multimap<string, Flower> mmap;
+    PerfectHash mph;
+    SortedIndex sorted_index;
+    LearnedIndex learned_index;
+    CompactRBTree<Flower> tree_r;
+    SplayTree<Flower> tree_y;
+
+    // The ordered structures are bulk-loaded from one stable parallel sort of the rows,
+    // which keeps equal keys in input order; then all structures are built concurrently.
+    uint64_t sort_start = tscNow();
+    vector<const Flower*> sorted(size);
+    for (long i = 0; i < size; ++i) {
+        sorted[i] = &data[i];
+    }
+    parallelStableSort(pool, sorted.begin(), sorted.end(), [](const Flower *l, const Flower *r) { return *l < *r; });
+    double sort_seconds = (tscNow() - sort_start) * tscSeconds();
+
+    BuildScheduler scheduler(pool);
+    scheduler.Add("binary", [&] { tree_b.BuildSorted(sorted); });
+    scheduler.Add("rb", [&] { tree_c.BuildSorted(sorted); });
+    scheduler.Add("hash", [&] { table_ptr = make_unique<HashTable>(source, pool); });
+    scheduler.Add("multimap", [&] {
+        for (const Flower *row : sorted) {
+            mmap.emplace_hint(mmap.end(), row->GetName(), *row);
         }
+    });
+    scheduler.Add("mph", [&] { mph.Build(source); });
+    scheduler.Add("sorted", [&] { sorted_index.Build(source); });
+    scheduler.Add("learned", [&] { learned_index.Build(source); });
+    scheduler.Add("rb_compact", [&] { tree_r.BuildSorted(sorted); });
+    scheduler.Add("splay", [&] { tree_y.BuildSorted(sorted); });
+    builds = scheduler.Run();
+    HashTable& table = *table_ptr;
+
+    fout << "Parallel build time: " << scheduler.GetSeconds() << " (sort " << sort_seconds << ", threads "
+         << pool.GetThreads() << ")" << endl;
 
-        fout1 << endl;
+    ResultSink fout1(writer, a);
+
+    res_a = searchAll(data, size, target);
+    write_span.Begin("write linear", size);
+
+    for (long i = 0; i < res_a.size(); ++i) {
+        fout1.AppendInt(res_a[i]).Append(": \t").AppendRow(data[res_a[i]]).Append('\n');
     }
 
-    fout1.close();
+    fout1.Close();
+    write_span.End();
 
+    vector<Flower> linear_rows(source);
+    results.push_back(runWorkload("linear", linear_workload, linear_config, [&](const Operation& op) {
+        if (op.type == INSERT) {
+            linear_rows.push_back(op.row);
+            return linear_rows.size();
+        }
+        return searchAll(linear_rows.data(), (long)linear_rows.size(), op.row).size();
+    }, &inserts.emplace_back()));
+    fout << "1. Linear search time: " << results.back().mean << endl;
 
 
-    ofstream fout2(b);
-    if (!fout2.is_open()) {
-        throw std::runtime_error("Cannot open file for writing: " + b);
-    }
 
-    Tree<Flower> tree_b(data[0]);
-    for (int i = 1; i < size; ++i) {
-        tree_b.Insert(data[i]);
-    }
+    ResultSink fout2(writer, b);
+
+    tree_b.GetStats().SetPhase(QUERY);
 
     vector<Node<Flower>*> res_b;
 
-    start = chrono::high_resolution_clock::now();
     res_b = tree_b.SearchAll(target);
-    end = chrono::high_resolution_clock::now();
-    duration = end - start;
-    fout << "2. Binary search tree time: " << duration.count() << endl;
+    write_span.Begin("write binary", size);
 
     for (long i = 0; i < res_b.size(); ++i) {
-        fout2 << i+1 << " " << res_b[i] << ": " << res_b[i]->value_.GetName() << ";" << res_b[i]->value_.GetColor() << ";" << res_b[i]->value_.GetSmell() << ";";
-
-        cntReg = res_b[i]->value_.GetRegions().size();
-        for (int j = 0; j < cntReg; ++j) {
-            fout2 << res_b[i]->value_.GetRegions()[j];
-            if (j != cntReg-1) {
-                fout2 << ",";
-            }
-        }
-
-        fout2 << endl;
+        fout2.AppendInt(i + 1).Append(' ').AppendPointer(res_b[i]).Append(": ").AppendRow(res_b[i]->value_).Append('\n');
     }
 
-    fout2.close();
+    fout2.Close();
+    write_span.End();
 
+    results.push_back(runWorkload("binary", workload, config, [&](const Operation& op) {
+        if (op.type == INSERT) {
+            tree_b.Insert(op.row);
+            return (size_t)0;
+        }
+        return tree_b.SearchAll(op.row).size();
+    }, &inserts.emplace_back()));
+    fout << "2. Binary search tree time: " << results.back().mean << endl;
 
 
-    ofstream fout3(c);
-    if (!fout3.is_open()) {
-        throw std::runtime_error("Cannot open file for writing: " + c);
-    } 
 
-    RBTree<Flower> tree_c(data[0]);
-    for (int i = 1; i < size; ++i) {
-        tree_c.Insert(data[i]);
-    }
+    ResultSink fout3(writer, c);
+
+    tree_c.GetStats().SetPhase(QUERY);
 
     RBNode<Flower> *res_c;
 
-    start = chrono::high_resolution_clock::now();
     res_c = tree_c.SearchAll(target);
-    end = chrono::high_resolution_clock::now();
-    duration = end - start;
-    fout << "3. RB Tree search time: " << duration.count() << endl;
+    write_span.Begin("write rb", size);
 
-    fout3 << "Адрес узла, где хранятся все объекты с искомым ключом: " << res_c << endl;
-    fout3 << "Сами объекты: " << endl;
+    fout3.Append("Адрес узла, где хранятся все объекты с искомым ключом: ").AppendPointer(res_c).Append('\n');
+    fout3.Append("Сами объекты: \n");
     for (long i = 0; i < res_c->values_.size(); ++i) {
-        fout3 << i + 1 << ": " << res_c->values_[i].GetName() << ";" << res_c->values_[i].GetColor() << ";" << res_c->values_[i].GetSmell() << ";";
-
-        cntReg = res_c->values_[i].GetRegions().size();
-        for (int j = 0; j < cntReg; ++j) {
-            fout3 << res_c->values_[i].GetRegions()[j];
-            if (j != cntReg-1) {
-                fout3 << ",";
-            }
-        }
-
-        fout3 << endl;
+        fout3.AppendInt(i + 1).Append(": ").AppendRow(res_c->values_[i]).Append('\n');
     }
 
-    fout3.close();
+    fout3.Close();
+    write_span.End();
 
+    results.push_back(runWorkload("rb", workload, config, [&](const Operation& op) {
+        if (op.type == INSERT) {
+            tree_c.Insert(op.row);
+            return (size_t)0;
+        }
+        return (size_t)(tree_c.SearchAll(op.row) != nullptr);
+    }, &inserts.emplace_back()));
+    fout << "3. RB Tree search time: " << results.back().mean << endl;
 
 
-    ofstream fout4(d);
-    if (!fout4.is_open()) {
-        throw std::runtime_error("Cannot open file for writing: " + d);
-    }
 
-    HashTable table(source);
+    ResultSink fout4(writer, d);
+
+    table.GetStats().SetPhase(QUERY);
     vector<Flower>* res_d;
 
-    start = chrono::high_resolution_clock::now();
     res_d = table.Search(target.GetName());
-    end = chrono::high_resolution_clock::now();
-    duration = end - start;
-    fout << "4. HASH search time: " << duration.count() << endl << "Collisions: " << table.GetCollisions() << endl;
+    write_span.Begin("write hash", size);
 
     for (int i = 0; i < SIZE; ++i) {
         Item *cur = table.GetItems()[i];
 
-        fout4 << i << "   \t";
+        fout4.AppendInt(i).Append("   \t");
         if (!cur) {
-            fout4 << "-" << endl;
+            fout4.Append("-\n");
         } else {
             while (cur) {
-                fout4 << cur->key_ << "(" << cur->values_->size() << ")" << "   \t";
+                fout4.Append(cur->key_).Append('(').AppendInt(cur->values_->size()).Append(")   \t");
                 cur = cur->next_;
             }
-            fout4 << endl;
+            fout4.Append('\n');
         }
 
-        fout4 << endl;
+        fout4.Append('\n');
     }
     
-    fout4 << endl << "Key: " << target.GetName() << endl << "Unique count: " << table.GetCountUnq() << endl << "Collisions: " << table.GetCollisions();
-    fout4.close();
+    fout4.Append("\nKey: ").Append(target.GetName()).Append("\nUnique count: ").AppendInt(table.GetCountUnq())
+         .Append("\nCollisions: ").AppendInt(table.GetCollisions());
+    fout4.Close();
+    write_span.End();
+
+    results.push_back(runWorkload("hash", workload, config, [&](const Operation& op) {
+        if (op.type == INSERT) {
+            table.Insert(op.row);
+            return (size_t)0;
+        }
+        return (size_t)(table.Search(op.key) != nullptr);
+    }, &inserts.emplace_back()));
+    fout << "4. HASH search time: " << results.back().mean << endl << "Collisions: " << table.GetCollisions() << endl;
 
 
     
-    ofstream fout5(e);
-    if (!fout5.is_open()) {
-        throw std::runtime_error("Cannot open file for writing: " + e);
+    ResultSink fout5(writer, e);
+
+
+    auto res = mmap.equal_range(target.GetName());
+    write_span.Begin("write multimap", size);
+
+    for (auto it = res.first; it != res.second; ++it) {
+        fout5.Append(it->first).Append(" -> ").AppendRow(it->second).Append('\n');
     }
+    
+    fout5.Close();
+    write_span.End();
 
-    std::multimap<string, Flower> mmap;
-    for (int i = 0; i < size; ++i) {
-        mmap.insert({data[i].GetName(), data[i]});
+    results.push_back(runWorkload("multimap", workload, config, [&](const Operation& op) {
+        if (op.type == INSERT) {
+            mmap.insert({op.key, op.row});
+            return (size_t)0;
+        }
+        auto range = mmap.equal_range(op.key);
+        return (size_t)(range.first != range.second);
+    }, &inserts.emplace_back()));
+    fout << "5. Multimap time: " << results.back().mean << endl;
+
+
+
+    ResultSink fout6(writer, f);
+
+    mph.GetStats().SetPhase(QUERY);
+    RowRange res_f;
+
+    res_f = mph.Search(target.GetName());
+    write_span.Begin("write mph", size);
+
+    for (size_t i = 0; i < res_f.size(); ++i) {
+        fout6.AppendInt(res_f[i]).Append(": \t").AppendRow(data[res_f[i]]).Append('\n');
     }
 
-    start = chrono::high_resolution_clock::now();
-    auto res = mmap.equal_range(target.GetName());
-    end = chrono::high_resolution_clock::now();
-    duration = end - start;
-    fout << "5. Multimap time: " << duration.count() << endl;
+    fout6.Close();
+    write_span.End();
 
+    results.push_back(runWorkload("mph", workload, config, [&](const Operation& op) {
+        if (op.type == INSERT) {
+            return (size_t)0;
+        }
+        return mph.Search(op.key).size();
+    }));
+    fout << "6. MPH search time: " << results.back().mean << endl << "MPH bytes: " << mph.GetBytes() << endl;
 
-    for (auto it = res.first; it != res.second; ++it) {
-        fout5 << it->first << " -> " << it->second.GetName() << ";" << it->second.GetColor() << ";" << it->second.GetSmell() << ";";
-        cntReg = it->second.GetRegions().size();
-        for (int j = 0; j < cntReg; ++j) {
-            fout5 << it->second.GetRegions()[j];
-            if (j != cntReg-1) {
-                fout5 << ",";
-            }
+
+
+    ResultSink fout7(writer, g);
+
+    sorted_index.GetStats().SetPhase(QUERY);
+    RowRange res_g;
+
+    res_g = sorted_index.Search(target.GetName());
+    write_span.Begin("write sorted", size);
+
+    for (size_t i = 0; i < res_g.size(); ++i) {
+        fout7.AppendInt(res_g[i]).Append(": \t").AppendRow(data[res_g[i]]).Append('\n');
+    }
+
+    fout7.Close();
+    write_span.End();
+
+    results.push_back(runWorkload("sorted", workload, config, [&](const Operation& op) {
+        if (op.type == INSERT) {
+            return (size_t)0;
         }
+        return sorted_index.Search(op.key).size();
+    }));
+    fout << "7. Sorted array search time: " << results.back().mean << endl
+         << "Sorted array bytes: " << sorted_index.GetBytes() << ", interpolation " << sorted_index.GetInterpolated() << endl;
+
+
+
+    ResultSink fout8(writer, l);
+
+    learned_index.GetStats().SetPhase(QUERY);
+    RowRange res_l;
 
-        fout5 << endl;
+    res_l = learned_index.Search(target.GetName());
+    write_span.Begin("write learned", size);
+
+    for (size_t i = 0; i < res_l.size(); ++i) {
+        fout8.AppendInt(res_l[i]).Append(": \t").AppendRow(data[res_l[i]]).Append('\n');
     }
-    
-    fout5.close();
+
+    fout8.Close();
+    write_span.End();
+
+    results.push_back(runWorkload("learned", workload, config, [&](const Operation& op) {
+        if (op.type == INSERT) {
+            return (size_t)0;
+        }
+        return learned_index.Search(op.key).size();
+    }));
+    fout << "8. Learned index search time: " << results.back().mean << endl
+         << "Learned index model bytes: " << learned_index.GetModelBytes() << ", mean search distance "
+         << learned_index.GetMeanDistance() << ", mean window " << learned_index.GetMeanWindow() << endl;
+
+
+
+    ResultSink fout9(writer, r);
+
+    tree_r.GetStats().SetPhase(QUERY);
+
+    const vector<Flower> *res_r;
+
+    res_r = tree_r.SearchAll(target);
+    write_span.Begin("write rb_compact", size);
+
+    fout9.Append("Сами объекты: \n");
+    for (size_t i = 0; res_r && i < res_r->size(); ++i) {
+        fout9.AppendInt(i + 1).Append(": ").AppendRow((*res_r)[i]).Append('\n');
+    }
+
+    fout9.Close();
+    write_span.End();
+
+    results.push_back(runWorkload("rb_compact", workload, config, [&](const Operation& op) {
+        if (op.type == INSERT) {
+            tree_r.Insert(op.row);
+            return (size_t)0;
+        }
+        return (size_t)(tree_r.SearchAll(op.row) != nullptr);
+    }, &inserts.emplace_back()));
+    fout << "9. Compact RB tree search time: " << results.back().mean << endl
+         << "Compact RB tree bytes: " << tree_r.GetBytes() << endl;
+
+
+
+    ResultSink fout10(writer, y);
+
+    tree_y.GetStats().SetPhase(QUERY);
+
+    const vector<Flower> *res_y;
+
+    res_y = tree_y.SearchAll(target);
+    write_span.Begin("write splay", size);
+
+    fout10.Append("Сами объекты: \n");
+    for (size_t i = 0; res_y && i < res_y->size(); ++i) {
+        fout10.AppendInt(i + 1).Append(": ").AppendRow((*res_y)[i]).Append('\n');
+    }
+
+    fout10.Close();
+    write_span.End();
+
+    results.push_back(runWorkload("splay", workload, config, [&](const Operation& op) {
+        if (op.type == INSERT) {
+            tree_y.Insert(op.row);
+            return (size_t)0;
+        }
+        return (size_t)(tree_y.SearchAll(op.row) != nullptr);
+    }, &inserts.emplace_back()));
+    fout << "10. Splay tree search time: " << results.back().mean << endl;
+
+    if (inserts[0].samples > 0) {
+        fout << "Insert time (linear/binary/rb/hash/multimap/rb_compact/splay):";
+        for (const BenchResult& insert : inserts) {
+            fout << " " << insert.mean;
+        }
+        fout << endl;
+    }
+
+    // Read-only streams of growing skew over this dataset; the splay tree is rebuilt balanced
+    // before every stream, so it only profits from the skew of that stream.
+    fout << "Zipf search time, skew";
+    vector<double> zipf_rb, zipf_splay;
+    for (double skew : ZIPF_SKEWS) {
+        WorkloadConfig zipf_config;
+        zipf_config.operations = workload.size();
+        zipf_config.zipf = skew;
+        vector<Operation> reads = makeWorkload(source, zipf_config);
+
+        SplayTree<Flower> adaptive;
+        adaptive.BuildSorted(sorted);
+
+        zipf_rb.push_back(runBench("zipf rb", reads, config, [&](const Operation& op) {
+            return (size_t)(tree_c.SearchAll(op.row) != nullptr);
+        }).mean);
+        zipf_splay.push_back(runBench("zipf splay", reads, config, [&](const Operation& op) {
+            return (size_t)(adaptive.SearchAll(op.row) != nullptr);
+        }).mean);
+        fout << (zipf_rb.size() == 1 ? " " : "/") << skew;
+    }
+    fout << " (rb/splay):";
+    for (size_t i = 0; i < zipf_rb.size(); ++i) {
+        fout << " " << zipf_rb[i] << "/" << zipf_splay[i];
+    }
+    fout << endl;
+
+
+
+    // The mutable structures hold the inserts of the workload by now, so the planner sees the
+    // rows with the inserts: the statistics and the scan cover them, and the static indexes,
+    // built over source only, are unavailable once there are any.
+    vector<Flower> planned_rows(source);
+    for (const Operation& op : workload) {
+        if (op.type == INSERT) {
+            planned_rows.push_back(op.row);
+        }
+    }
+
+    TableStats table_stats(planned_rows);
+    QueryPlanner planner(table_stats, LinearIndex(planned_rows), TreeIndex(tree_b), RBTreeIndex(tree_c),
+                         HashIndex(table), MultimapIndex(mmap), PerfectHashIndex(mph, planned_rows),
+                         SortedArrayIndex(sorted_index, planned_rows), LearnedArrayIndex(learned_index, planned_rows),
+                         CompactRBTreeIndex(tree_r));
+
+    results.push_back(runWorkload("planner", workload, config, [&](const Operation& op) {
+        if (op.type == INSERT) {
+            return (ptrdiff_t)0;
+        }
+        return planner.Lookup(op.key, [](auto&& rows) { return ranges::distance(rows); });
+    }));
+    fout << "Planner search time: " << results.back().mean << endl << "Planner choices:";
+    for (size_t i = 0; i < planner.Count(); ++i) {
+        fout << " " << planner.Name(i) << "=" << planner.GetChoices()[i];
+    }
+    fout << endl;
+
+
+
+    meter.Start();
+    BloomFilter filter(source);
+    builds.push_back(meter.Stop("filter"));
+
+    vector<string> miss_keys;
+    for (int i = 0; i < MISS_QUERIES; ++i) {
+        miss_keys.push_back(data[i % size].GetName() + "#" + to_string(i));
+    }
+
+    long false_pos = 0;
+    for (int i = 0; i < FPR_PROBES; ++i) {
+        if (filter.MayContain(data[i % size].GetName() + "#" + to_string(i))) {
+            false_pos += 1;
+        }
+    }
+
+    fout << "Filter bytes: " << filter.GetBytes() << endl;
+    fout << "Filter false positive rate: " << (double)false_pos / FPR_PROBES << endl;
+
+    // The trees search by a Flower; the probes are built once, outside the timed calls.
+    vector<Flower> miss_probes;
+    for (const string& key : miss_keys) {
+        miss_probes.push_back(Flower(key, "", "", {}));
+    }
+
+    vector<function<size_t(const Flower&)>> lookups = {
+        [&](const Flower& probe) { return searchAll(data, size, probe).size(); },
+        [&](const Flower& probe) { return tree_b.SearchAll(probe).size(); },
+        [&](const Flower& probe) { return (size_t)(tree_c.SearchAll(probe) != nullptr); },
+        [&](const Flower& probe) { return (size_t)(table.Search(probe.GetName()) != nullptr); },
+        [&](const Flower& probe) { return (size_t)mmap.count(probe.GetName()); },
+        [&](const Flower& probe) { return mph.Search(probe.GetName()).size(); },
+        [&](const Flower& probe) { return sorted_index.Search(probe.GetName()).size(); },
+        [&](const Flower& probe) { return learned_index.Search(probe.GetName()).size(); },
+        [&](const Flower& probe) { return (size_t)(tree_r.SearchAll(probe) != nullptr); },
+        [&](const Flower& probe) { return (size_t)(tree_y.SearchAll(probe) != nullptr); },
+    };
+
+    BenchConfig miss_config;
+    miss_config.warmup = MISS_QUERIES / 10;
+    miss_config.repetitions = 1;
+
+    for (int with_filter = 0; with_filter < 2; ++with_filter) {
+        fout << (with_filter ? "Miss time with filter" : "Miss time without filter")
+             << " (linear/binary/rb/hash/multimap/mph/sorted/learned/rb_compact/splay):";
+
+        for (size_t k = 0; k < lookups.size(); ++k) {
+            BenchResult miss = runBench("miss", miss_probes, miss_config, [&](const Flower& probe) {
+                if (with_filter) {
+                    return filteredSearch(filter, probe.GetName(), [&]() { return lookups[k](probe); });
+                }
+                return lookups[k](probe);
+            });
+
+            fout << " " << miss.mean;
+        }
+
+        fout << endl;
+    }
+
+    // Every other key misses; the hits come from the workload, or from the rows when it is empty.
+    // Repeated names are dropped, so one search per name and searchIn() look up the same names.
+    vector<string> in_keys;
+    unordered_set<string> in_seen;
+    for (int i = 0; i < IN_LIST_KEYS; ++i) {
+        string key = i % 2 ? data[i % size].GetName() + "#" + to_string(i)
+                           : workload.empty() ? data[i % size].GetName() : workload[i % workload.size()].key;
+        if (in_seen.insert(key).second) {
+            in_keys.push_back(key);
+        }
+    }
+
+    vector<Flower> in_probes;
+    for (const string& key : in_keys) {
+        in_probes.push_back(Flower(key, "", "", {}));
+    }
+
+    // Every pair is one search per name against one IN-list pass.
+    vector<function<size_t()>> in_lists = {
+        [&] { size_t rows = 0; for (const Flower& probe : in_probes) { rows += lookups[2](probe); } return rows; },
+        [&] { return searchIn(tree_c, in_keys).size(); },
+        [&] { size_t rows = 0; for (const Flower& probe : in_probes) { rows += lookups[3](probe); } return rows; },
+        [&] { return searchIn(table, in_keys).size(); },
+        [&] { size_t rows = 0; for (const Flower& probe : in_probes) { rows += lookups[6](probe); } return rows; },
+        [&] { return searchIn(sorted_index, in_keys).size(); },
+    };
+
+    BenchConfig in_config;
+    in_config.warmup = 1;
+    in_config.repetitions = IN_LIST_QUERIES;
+
+    fout << "IN-list time, " << in_keys.size() << " names (rb/rb_in hash/hash_in sorted/sorted_in):";
+    for (size_t k = 0; k < in_lists.size(); ++k) {
+        vector<int> once = { 0 };
+        BenchResult run = runBench("in-list", once, in_config, [&](int) { return in_lists[k](); });
+        fout << (k % 2 ? "/" : " ") << run.mean;
+    }
+    fout << endl;
+
+
+
+    vector<Flower> cache_rows(source);
+    ResultCache cache(CACHE_CAPACITY);
+    auto cached_linear = [&](const Operation& op) {
+        if (op.type == INSERT) {
+            cache_rows.push_back(op.row);
+            cache.Invalidate(0, op.key);
+            return (size_t)0;
+        }
+
+        const vector<RowId>* hit = cache.Get(0, op.key);
+        if (hit) {
+            return hit->size();
+        }
+
+        vector<int> found = searchAll(cache_rows.data(), (long)cache_rows.size(), op.row);
+        cache.Put(0, op.key, vector<RowId>(found.begin(), found.end()));
+        return found.size();
+    };
+
+    for (const Operation& op : workload) {
+        cached_linear(op);
+    }
+    fout << "Cache hit ratio: " << cache.HitRatio() << endl;
+
+    Operation hot_op;
+    hot_op.key = target.GetName();
+    hot_op.row = Flower(hot_op.key, "", "", {});
+    vector<Operation> hot_ops(CACHE_QUERIES, hot_op);
+    BenchResult hot = runBench("cache", hot_ops, config, cached_linear);
+    fout << "Cached hot-key time: " << hot.mean << endl;
 
 
     
+    fout << "Build time (binary/rb/hash/multimap/mph/sorted/learned/rb_compact/splay/filter):";
+    for (const BuildResult& build : builds) {
+        fout << " " << build.seconds;
+    }
+    fout << endl << "Bytes per row (binary/rb/hash/multimap/mph/sorted/learned/rb_compact/splay/filter):";
+    for (const BuildResult& build : builds) {
+        fout << " " << (double)build.steady_bytes / size;
+    }
+    fout << endl;
+
+    vector<pair<string, IndexStats>> stats = {
+        { "binary", tree_b.GetStats() },
+        { "rb", tree_c.GetStats() },
+        { "hash", table.GetStats() },
+        { "mph", mph.GetStats() },
+        { "sorted", sorted_index.GetStats() },
+        { "learned", learned_index.GetStats() },
+        { "rb_compact", tree_r.GetStats() },
+        { "splay", tree_y.GetStats() },
+    };
+
+    if (statsEnabled()) {
+        for (const auto& index : stats) {
+            for (Phase phase : { BUILD, QUERY }) {
+                const PhaseStats& counters = index.second.Get(phase);
+                fout << "Stats " << index.first << (phase == BUILD ? " build" : " query")
+                     << ": comparisons " << counters.comparisons << ", nodes visited " << counters.nodes_visited
+                     << ", rotations " << counters.rotations << ", probes " << counters.probes
+                     << ", allocations " << counters.allocations << ", height " << counters.height << endl;
+            }
+        }
+    }
+
+
+
+    // The upserted keys are new, so every index ends with the rows it had before.
+    vector<Flower> update_rows;
+    for (int i = 0; i < UPDATE_QUERIES; ++i) {
+        const Flower& origin = data[i % size];
+        update_rows.push_back(Flower(origin.GetName() + "#u" + to_string(i), origin.GetColor(), origin.GetSmell(),
+                                     origin.GetRegions()));
+    }
+
+    BenchConfig update_config;
+    update_config.warmup = 0;
+    update_config.repetitions = 1;
+
+    vector<function<void(const Flower&)>> upserts = {
+        [&](const Flower& row) { tree_b.Upsert(row); },
+        [&](const Flower& row) { tree_c.Upsert(row); },
+        [&](const Flower& row) { tree_r.Upsert(row); },
+        [&](const Flower& row) { table.Upsert(row); },
+    };
+    vector<function<size_t(const Flower&)>> removes = {
+        [&](const Flower& row) { return tree_b.Remove(row); },
+        [&](const Flower& row) { return tree_c.Remove(row); },
+        [&](const Flower& row) { return tree_r.Remove(row); },
+        [&](const Flower& row) { return table.Remove(row.GetName()); },
+    };
+
+    vector<double> insert_times, replace_times, remove_times;
+    for (size_t k = 0; k < upserts.size(); ++k) {
+        auto upsert = [&](const Flower& row) { upserts[k](row); return (size_t)0; };
+        insert_times.push_back(runBench("upsert", update_rows, update_config, upsert).mean);
+        replace_times.push_back(runBench("upsert", update_rows, update_config, upsert).mean);
+        remove_times.push_back(runBench("remove", update_rows, update_config, removes[k]).mean);
+    }
+
+    fout << "Upsert new key time (binary/rb/rb_compact/hash):";
+    for (double time : insert_times) {
+        fout << " " << time;
+    }
+    fout << endl << "Upsert existing key time (binary/rb/rb_compact/hash):";
+    for (double time : replace_times) {
+        fout << " " << time;
+    }
+    fout << endl << "Remove time (binary/rb/rb_compact/hash):";
+    for (double time : remove_times) {
+        fout << " " << time;
+    }
+    fout << endl;
+
+    // Every thread inserts its share of the rows, then looks up its share of the workload reads.
+    vector<string> read_keys;
+    for (const Operation& op : workload) {
+        if (op.type == READ) {
+            read_keys.push_back(op.key);
+        }
+    }
+
+    vector<pair<double, double>> insert_rates, lookup_rates;
+    for (unsigned threads : SCALING_THREADS) {
+        ThreadPool workers(threads);
+        SkipList skip;
+        RBTree<Flower> locked;
+        std::mutex locked_mutex;
+
+        auto rate = [&](size_t count, const function<void(size_t)>& body) {
+            uint64_t start = tscNow();
+            workers.ParallelFor(count, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    body(i);
+                }
+            });
+            return count / ((tscNow() - start) * tscSeconds());
+        };
+
+        double skip_insert = rate(size, [&](size_t i) { skip.Insert(data[i]); });
+        double locked_insert = rate(size, [&](size_t i) {
+            lock_guard<std::mutex> lock(locked_mutex);
+            locked.Insert(data[i]);
+        });
+        insert_rates.push_back({ skip_insert, locked_insert });
+
+        // Both lookups visit every row of the name and build nothing.
+        double skip_lookup = rate(read_keys.size(), [&](size_t i) {
+            size_t regions = 0;
+            skip.ForEach(read_keys[i], [&](const Flower& row) { regions += row.GetRegions().size(); });
+            doNotOptimize(regions);
+        });
+        double locked_lookup = rate(read_keys.size(), [&](size_t i) {
+            Flower probe(read_keys[i], "", "", {});
+            size_t regions = 0;
+            lock_guard<std::mutex> lock(locked_mutex);
+            if (const RBNode<Flower> *node = locked.SearchAll(probe)) {
+                for (const Flower& row : node->values_) {
+                    regions += row.GetRegions().size();
+                }
+            }
+            doNotOptimize(regions);
+        });
+        lookup_rates.push_back({ skip_lookup, locked_lookup });
+    }
+
+    for (int lookup = 0; lookup < 2; ++lookup) {
+        fout << (lookup ? "Concurrent lookups per second" : "Concurrent inserts per second") << ", threads";
+        bool first = true;
+        for (unsigned threads : SCALING_THREADS) {
+            fout << (first ? " " : "/") << threads;
+            first = false;
+        }
+        fout << " (skip_list/locked_rb):";
+        for (const auto& rates : lookup ? lookup_rates : insert_rates) {
+            fout << " " << rates.first << "/" << rates.second;
+        }
+        fout << endl;
+    }
+
+    // The dataset is streamed WINDOW_PASSES times through a window of about one dataset. Once
+    // the window is full its footprint must not grow any more.
+    WindowConfig window_config;
+    window_config.segments = WINDOW_SEGMENTS;
+    window_config.segment_rows = max<size_t>(size / WINDOW_SEGMENTS, 1);
+
+    size_t window_bytes[2] = {};
+    unsigned long long window_scope = memScopeOpen();
+    unsigned long long previous_scope = memScopeSwitch(window_scope);
+    WindowIndex window(window_config);
+
+    uint64_t append_start = tscNow();
+    for (int pass = 0; pass < WINDOW_PASSES; ++pass) {
+        for (long i = 0; i < size; ++i) {
+            window.Append(data[i]);
+        }
+        if (pass == 1) {
+            window_bytes[0] = memScopeRead(window_scope).current;
+        }
+    }
+    double append_seconds = (tscNow() - append_start) * tscSeconds();
+    window_bytes[1] = memScopeRead(window_scope).current;
+    memScopeSwitch(previous_scope);
+
+    BenchResult window_search = runWorkload("window", workload, config, [&](const Operation& op) {
+        return window.SearchAll(op.key).size();
+    });
+
+    fout << "Window index (" << WINDOW_SEGMENTS << " segments of " << window_config.segment_rows
+         << " rows): append time per row " << append_seconds / ((double)size * WINDOW_PASSES)
+         << ", search time " << window_search.mean << ", live rows " << window.GetCount()
+         << ", bytes after 2/" << WINDOW_PASSES << " passes " << window_bytes[0] << "/" << window_bytes[1] << endl;
+
+    // The same stream bounded by age: one dataset arrives per second and rows live WINDOW_MAX_AGE
+    // seconds, so about half a dataset, plus the segment not yet expired, stays in the window.
+    WindowConfig age_config = window_config;
+    age_config.segments = 4 * WINDOW_SEGMENTS;
+    age_config.max_age = WINDOW_MAX_AGE;
+    WindowIndex aged(age_config);
+
+    size_t expired = 0;
+    uint64_t age_start = tscNow();
+    for (int pass = 0; pass < WINDOW_PASSES; ++pass) {
+        for (long i = 0; i < size; ++i) {
+            double time = pass + (double)i / size;
+            aged.Append(data[i], time);
+            expired += aged.Expire(time);
+        }
+    }
+    double age_seconds = (tscNow() - age_start) * tscSeconds();
+
+    fout << "Window index by age (" << WINDOW_MAX_AGE << " s, one dataset per second): append and expire time per row "
+         << age_seconds / ((double)size * WINDOW_PASSES) << ", live rows " << aged.GetCount() << " in "
+         << aged.GetSegments() << " segments, expired " << expired << endl;
+
+    // The static indexes read their row ids through the store, so they skip erased rows. Half of the
+    // updates and erases run while a compaction is copying the rows: the new versions go to the tail,
+    // half of them are erased again, and the erases are re-applied when the compaction is installed.
+    // The static indexes are then moved to the new ids.
+    RowStore store(source);
+    PerfectHash store_mph(source);
+    SortedIndex store_sorted(source);
+    LearnedIndex store_learned(source);
+
+    vector<string> names;
+    for (long i = 0; i < size; ++i) {
+        names.push_back(data[i].GetName());
+    }
+    sort(names.begin(), names.end());
+    names.erase(unique(names.begin(), names.end()), names.end());
+
+    auto found_rows = [&] {
+        size_t found[3] = {};
+        for (const string& name : names) {
+            found[0] += ranges::distance(PerfectHashIndex(store_mph, store).Lookup(name));
+            found[1] += ranges::distance(SortedArrayIndex(store_sorted, store).Lookup(name));
+            found[2] += ranges::distance(LearnedArrayIndex(store_learned, store).Lookup(name));
+        }
+        return to_string(found[0]) + "/" + to_string(found[1]) + "/" + to_string(found[2]);
+    };
+
+    // Rows 4i and 4i + 1 are updated and erased before the compaction, rows 4i + 2 and 4i + 3 while it runs.
+    vector<RowId> before[2], during[2];
+    for (int i = 0; i < UPDATE_QUERIES / 2; ++i) {
+        for (int k = 0; k < 2; ++k) {
+            before[k].push_back((RowId)((4 * i + k) % size));
+            during[k].push_back((RowId)((4 * i + 2 + k) % size));
+        }
+    }
+    vector<RowId> tail_ids;
+
+    auto store_update = [&](RowId id) {
+        RowId fresh = store.Update(id, update_rows[id % UPDATE_QUERIES]);
+        if (fresh != NO_ROW && store.IsCompacting()) {
+            tail_ids.push_back(fresh);
+        }
+        return (size_t)fresh;
+    };
+    auto store_erase = [&](RowId id) { return (size_t)store.Erase(id); };
+
+    BenchResult update_time = runBench("store update", before[0], update_config, store_update);
+    BenchResult erase_time = runBench("store erase", before[1], update_config, store_erase);
+    string found_before = found_rows();
+
+    vector<RowId> remap;
+    uint64_t compact_start = tscNow();
+    store.StartCompaction();
+    for (size_t i = 0; i < during[0].size(); ++i) {
+        store_update(during[0][i]);
+        store_erase(during[1][i]);
+    }
+    for (size_t i = 0; i < tail_ids.size(); i += 2) {
+        store.Erase(tail_ids[i]);
+    }
+    store.FinishCompaction(remap);
+    double compact_seconds = (tscNow() - compact_start) * tscSeconds();
+
+    store_mph.Remap(remap);
+    store_sorted.Remap(remap);
+    store_learned.Remap(remap);
+
+    fout << "Row store update time: " << update_time.mean << ", erase time: " << erase_time.mean
+         << ", compaction time: " << compact_seconds << " (dropped " << count(remap.begin(), remap.end(), NO_ROW)
+         << ", live " << store.GetLive() << ", tombstones " << store.GetDead() << ")" << endl
+         << "Row store rows found through mph/sorted/learned before/after compaction: " << found_before << " "
+         << found_rows() << endl;
+
+    ColumnStore columns(source, pool);
+    ColumnFilter strong;
+    strong.smell = columns.Code(COL_SMELL, "сильный");
+
+    vector<function<size_t()>> aggregates = {
+        [&] { return (size_t)columns.Count(strong); },
+        [&] { return columns.CountBy(COL_NAME, ColumnFilter()).size(); },
+        [&] { return columns.CountBy(COL_REGION, COL_COLOR, ColumnFilter()).size(); },
+        [&] { return columns.CountBy(COL_REGION, strong).size(); },
+    };
+
+    BenchConfig aggregate_config;
+    aggregate_config.warmup = 1;
+    aggregate_config.repetitions = AGGREGATE_QUERIES;
+
+    fout << "Column store bytes: " << columns.GetBytes()
+         << ", rows per second (strong count/rows per name/colors per region/strong per region):";
+    for (const auto& aggregate : aggregates) {
+        vector<int> once = { 0 };
+        BenchResult run = runBench("aggregate", once, aggregate_config, [&](int) { return aggregate(); });
+        fout << " " << size / run.mean;
+    }
+    fout << endl;
+
+    writer.Drain();
+
     fout << endl << endl;
     fout.close();
+
+    writeBenchCSV("/Users/ekaterinagridneva/Desktop/hse/mp/data-search-algorithms/bench.csv", size, results);
+    writeBenchJSON("/Users/ekaterinagridneva/Desktop/hse/mp/data-search-algorithms/bench.jsonl", size, results);
+    writeBuildCSV("/Users/ekaterinagridneva/Desktop/hse/mp/data-search-algorithms/build.csv", size, mph.GetCountUnq(), builds);
+    if (statsEnabled()) {
+        writeStatsCSV("/Users/ekaterinagridneva/Desktop/hse/mp/data-search-algorithms/stats.csv", size, stats);
+    }
 }
 
+void saveIngest(vector<Flower>& source, const string& path, size_t batch_rows) {
+    ofstream fout("/Users/ekaterinagridneva/Desktop/hse/mp/data-search-algorithms/info_time.txt", ofstream::app);
+    if (!fout.is_open()) {
+        throw std::runtime_error("Cannot open file for writing");
+    }
+
+    ThreadPool pool;
+    LiveIndexes live(source, pool);
+
+    size_t offset = 0;
+    uint64_t start = tscNow();
+    size_t batches = live.IngestTail(path, offset, batch_rows);
+    double ingest_seconds = (tscNow() - start) * tscSeconds();
+    size_t rows = live.GetStore().GetCount() - source.size();
+
+    vector<Flower> all(source);
+    for (size_t i = source.size(); i < live.GetStore().GetCount(); ++i) {
+        all.push_back(live.GetStore().Get((RowId)i));
+    }
+    start = tscNow();
+    LiveIndexes rebuilt(std::move(all), pool);
+    double rebuild_seconds = (tscNow() - start) * tscSeconds();
+
+    // Every index must end with exactly the live rows of the store; the second half of the
+    // updates and erases runs while a compaction is copying the rows.
+    size_t count = live.GetStore().GetCount();
+    vector<RowId> update_ids, erase_ids;
+    for (int i = 0; count > 0 && i < UPDATE_QUERIES; ++i) {
+        update_ids.push_back((RowId)((4 * i) % count));
+        erase_ids.push_back((RowId)((4 * i + 1) % count));
+    }
+
+    double update_seconds = 0, erase_seconds = 0;
+    for (size_t i = 0; i < update_ids.size(); ++i) {
+        if (i == update_ids.size() / 2) {
+            live.StartCompaction();
+        }
+
+        Flower row = live.GetStore().Get(update_ids[i]);
+        row = Flower(row.GetName(), row.GetColor() + "#u", row.GetSmell(), row.GetRegions());
+
+        start = tscNow();
+        live.Update(update_ids[i], row);
+        update_seconds += (tscNow() - start) * tscSeconds();
+
+        start = tscNow();
+        live.Erase(erase_ids[i]);
+        erase_seconds += (tscNow() - start) * tscSeconds();
+    }
+
+    vector<RowId> remap;
+    live.FinishCompaction(remap);
+
+    size_t indexed = 0;
+    const multimap<string, Flower>& mmap = live.GetMultimap();
+    for (auto it = mmap.begin(); it != mmap.end(); it = mmap.upper_bound(it->first)) {
+        const RBNode<Flower> *node = live.GetRBTree().SearchAll(Flower(it->first, "", "", {}));
+        indexed += node ? node->values_.size() : 0;
+    }
+
+    fout << "Ingest " << path << " into " << source.size() << " rows: rows " << rows << ", batches " << batches << endl
+         << "Ingest time: " << ingest_seconds << " (per row " << (rows ? ingest_seconds / rows : 0)
+         << "), full rebuild time: " << rebuild_seconds << endl
+         << "Live update time: " << (update_ids.empty() ? 0 : update_seconds / update_ids.size())
+         << ", erase time: " << (erase_ids.empty() ? 0 : erase_seconds / erase_ids.size())
+         << ", rows in the multimap/rb tree: " << live.GetMultimap().size() << "/" << indexed << " of "
+         << live.GetStore().GetLive() << " live" << endl << endl;
+}
@@ -0,0 +1,126 @@
+/// \file  live.cpp
+/// \brief Implements the initial build, the batch merges and the erases of LiveIndexes.
+
+#include "../headers/live.h"
+#include "../headers/io.h"
+#include "../headers/trace.h"
+
+#include <algorithm>
+#include <functional>
+
+/// \brief Whether two rows are equal in every field, not only by name as operator== compares them.
+static bool sameRow(const Flower& l, const Flower& r) {
+    return l.GetName() == r.GetName() && l.GetColor() == r.GetColor() && l.GetSmell() == r.GetSmell()
+        && l.GetRegions() == r.GetRegions();
+}
+
+LiveIndexes::LiveIndexes(vector<Flower> rows, ThreadPool& pool)
+    : pool_(pool), store_(std::move(rows)) {
+    TraceSpan span("live build", store_.GetCount());
+
+    vector<const Flower*> sorted(store_.GetCount());
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        sorted[i] = &store_.Get((RowId)i);
+    }
+    parallelStableSort(pool_, sorted.begin(), sorted.end(), [](const Flower *l, const Flower *r) { return *l < *r; });
+
+    pool_.RunAll({
+        [&] { tree_b_.BuildSorted(sorted); },
+        [&] { tree_c_.BuildSorted(sorted); },
+        [&] { tree_r_.BuildSorted(sorted); },
+        [&] { table_ = make_unique<HashTable>(vector<Flower>()); table_->MergeSorted(sorted); },
+        [&] { MergeMultimap(sorted); },
+    });
+}
+
+void LiveIndexes::Ingest(const vector<Flower>& batch) {
+    TraceSpan span("ingest", batch.size());
+
+    for (const Flower& row : batch) {
+        store_.Append(row);
+    }
+
+    vector<const Flower*> sorted(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        sorted[i] = &batch[i];
+    }
+    stable_sort(sorted.begin(), sorted.end(), [](const Flower *l, const Flower *r) { return *l < *r; });
+
+    Merge(sorted);
+}
+
+size_t LiveIndexes::IngestTail(const string& path, size_t& offset, size_t batch_rows) {
+    size_t batches = 0;
+
+    for (;;) {
+        vector<Flower> batch = parserCSVTail(path, offset, batch_rows);
+        if (batch.empty()) {
+            return batches;
+        }
+
+        Ingest(batch);
+        batches += 1;
+    }
+}
+
+bool LiveIndexes::Erase(RowId id) {
+    if (!store_.Erase(id)) {
+        return false;
+    }
+
+    // An erased row stays readable in the store until the next compaction.
+    RemoveRow(store_.Get(id));
+    return true;
+}
+
+RowId LiveIndexes::Update(RowId id, const Flower& row) {
+    RowId fresh = store_.Update(id, row);
+    if (fresh == NO_ROW) {
+        return NO_ROW;
+    }
+
+    RemoveRow(store_.Get(id));
+    Merge({ &store_.Get(fresh) });
+    return fresh;
+}
+
+void LiveIndexes::Merge(const vector<const Flower*>& sorted) {
+    pool_.RunAll({
+        [&] { tree_b_.MergeSorted(sorted); },
+        [&] { tree_c_.MergeSorted(sorted); },
+        [&] { tree_r_.MergeSorted(sorted); },
+        [&] { table_->MergeSorted(sorted); },
+        [&] { MergeMultimap(sorted); },
+    });
+}
+
+void LiveIndexes::RemoveRow(const Flower& row) {
+    // Rows of one name differ in their other fields; every index drops the first copy of row.
+    auto match = [&](const Flower& value) { return sameRow(value, row); };
+
+    pool_.RunAll({
+        [&] { tree_b_.RemoveOne(row, match); },
+        [&] { tree_c_.RemoveOne(row, match); },
+        [&] { tree_r_.RemoveOne(row, match); },
+        [&] { table_->RemoveOne(row.GetName(), match); },
+        [&] {
+            auto range = mmap_.equal_range(row.GetName());
+            auto it = find_if(range.first, range.second, [&](const auto& entry) { return match(entry.second); });
+            if (it != range.second) {
+                mmap_.erase(it);
+            }
+        },
+    });
+}
+
+void LiveIndexes::MergeMultimap(const vector<const Flower*>& sorted) {
+    for (size_t i = 0; i < sorted.size(); ) {
+        const string& key = sorted[i]->GetName();
+
+        // Inserting before the first greater key keeps equal keys in insertion order.
+        auto hint = mmap_.upper_bound(key);
+        for (; i < sorted.size() && sorted[i]->GetName() == key; ++i) {
+            hint = next(mmap_.emplace_hint(hint, key, *sorted[i]));
+        }
+    }
+}
@@ -1,16 +1,144 @@
 /// \file main.cpp
 /// \brief Entry point: parses multiple dataset CSVs and runs search algorithms on each.
+///
+/// Usage:
+///     SecondLab [--trace PATH] [--operations N] [--hit-ratio R] [--zipf S] [--insert-ratio R] [--seed X]
+///               [--chrome-trace PATH] [--perf] [--ingest PATH] [--batch N] [--serve SOCKET] [--threads N]
+///               [--pipeline]
+///
+/// The workload is generated once from the first dataset and then sent through every structure
+/// of every dataset. With --trace, an existing trace file is replayed instead; if the file does
+/// not exist yet, the generated workload is recorded to it.
+///
+/// Every dataset is parsed only when its turn comes, so nothing else runs during the measurements.
+/// With --pipeline the datasets go through runPipeline() instead, which reads and parses the next
+/// files while the current one is benchmarked: the whole run is shorter, but the parse workers
+/// compete with the timed sections for the cores and the caches.
+///
+/// With --chrome-trace, the parse, build, query and write phases are traced and saved as Chrome
+/// trace-event JSON; --perf adds hardware counters to every traced phase.
+///
+/// With --ingest, the largest dataset is loaded once and the rows of the given CSV are merged
+/// into its indexes in batches of --batch rows (1000 by default) instead of running the searches.
+///
+/// With --serve, the largest dataset is loaded once and a QueryServer answers queries on the Unix
+/// domain socket SOCKET with --threads worker threads (one per hardware thread by default) until
+/// SIGINT or SIGTERM; utils/loadGen.cpp is a client that measures its throughput and latency.
 
 #include "../headers/io.h"
+#include "../headers/pipeline.h"
+#include "../headers/server.h"
+#include "../headers/trace.h"
+
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char **argv) {
+    WorkloadConfig config;
+    string trace;
+    string chrome_trace;
+    bool perf = false;
+    bool pipeline = false;
+    string ingest;
+    size_t batch_rows = 1000;
+    string serve;
+    unsigned threads = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--perf") {
+            perf = true;
+            continue;
+        }
+        if (arg == "--pipeline") {
+            pipeline = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            return 1;
+        }
+        string value = argv[++i];
+
+        if (arg == "--trace") {
+            trace = value;
+        } else if (arg == "--operations") {
+            config.operations = stoul(value);
+        } else if (arg == "--hit-ratio") {
+            config.hit_ratio = stod(value);
+        } else if (arg == "--zipf") {
+            config.zipf = stod(value);
+        } else if (arg == "--insert-ratio") {
+            config.insert_ratio = stod(value);
+        } else if (arg == "--seed") {
+            config.seed = stoul(value);
+        } else if (arg == "--chrome-trace") {
+            chrome_trace = value;
+        } else if (arg == "--ingest") {
+            ingest = value;
+        } else if (arg == "--batch") {
+            batch_rows = stoul(value);
+        } else if (arg == "--serve") {
+            serve = value;
+        } else if (arg == "--threads") {
+            threads = stoul(value);
+        } else {
+            cerr << "Unknown option " << arg << endl;
+            return 1;
+        }
+    }
+
+    if (!chrome_trace.empty()) {
+        traceEnable(perf);
+    }
 
-int main() {
     vector<Flower> tmp;
+    vector<Operation> workload;
     string base = "/Users/ekaterinagridneva/Desktop/hse/mp/data-search-algorithms/datasets/dataset_";
     string sizes[10] = {"100", "200", "500", "1000", "2000", "5000", "10000", "20000", "50000", "100000"};
-    
-    for (int i = 0; i < 10; ++i) {
-        string path = base + sizes[i] + ".csv";
-        tmp = parserCSV(path);
-        saveRes(tmp, tmp.size(), tmp[0]);
+
+    if (!ingest.empty()) {
+        tmp = parserCSV(base + sizes[9] + ".csv");
+        saveIngest(tmp, ingest, batch_rows);
+    } else if (!serve.empty()) {
+        tmp = parserCSV(base + sizes[9] + ".csv");
+        QueryServer server(tmp, threads);
+        cerr << "Serving " << server.GetRows() << " rows on " << serve << endl;
+        server.Serve(serve);
+    } else {
+        auto process = [&](size_t i, vector<Flower>& rows) {
+            if (i == 0) {
+                if (!trace.empty() && ifstream(trace).good()) {
+                    workload = loadTrace(trace);
+                } else {
+                    workload = makeWorkload(rows, config);
+                    if (!trace.empty()) {
+                        saveTrace(trace, workload);
+                    }
+                }
+            }
+
+            TraceSpan span("saveRes", rows.size());
+            saveRes(rows, rows.size(), rows[0], workload);
+        };
+
+        vector<string> paths;
+        for (int i = 0; i < 10; ++i) {
+            paths.push_back(base + sizes[i] + ".csv");
+        }
+
+        if (pipeline) {
+            runPipeline(paths, process);
+        } else {
+            for (size_t i = 0; i < paths.size(); ++i) {
+                tmp = parserCSV(paths[i]);
+                process(i, tmp);
+            }
+        }
+    }
+
+    if (!chrome_trace.empty()) {
+        traceWriteChrome(chrome_trace);
     }
-}
\ No newline at end of file
+}
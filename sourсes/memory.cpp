@@ -0,0 +1,167 @@
+/// \file  memory.cpp
+/// \brief Replaces the global allocation functions with versions that count live and peak heap bytes.
+///
+/// Every block carries a small header in front of the returned pointer with the requested
+/// size and the allocation scope, so operator delete knows how many bytes are released and
+/// which scope to charge. The counters are atomic, the indexes may be built from several threads.
+
+#include "../headers/memory.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<size_t> current_bytes(0);
+static std::atomic<size_t> peak_bytes(0);
+static std::atomic<size_t> allocations(0);
+
+/// \brief Size of the header in front of blocks with the default alignment.
+static const size_t kHeader = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+static_assert(kHeader >= 2 * sizeof(size_t), "the block header holds the size and the scope");
+
+/// \brief Number of scopes tracked at the same time; scope id % kScopes is its slot.
+static const unsigned long long kScopes = 64;
+
+/// \brief Counters of one scope slot.
+struct ScopeSlot {
+    std::atomic<unsigned long long> id;
+    std::atomic<size_t> current;
+    std::atomic<size_t> peak;
+    std::atomic<size_t> allocations;
+};
+
+static ScopeSlot scopes[kScopes];
+static std::atomic<unsigned long long> last_scope(0);
+static thread_local unsigned long long thread_scope = 0;
+
+size_t memCurrent() { return current_bytes.load(std::memory_order_relaxed); }
+size_t memPeak() { return peak_bytes.load(std::memory_order_relaxed); }
+size_t memAllocations() { return allocations.load(std::memory_order_relaxed); }
+void memResetPeak() { peak_bytes.store(memCurrent(), std::memory_order_relaxed); }
+
+unsigned long long memScopeOpen() {
+    unsigned long long id = last_scope.fetch_add(1, std::memory_order_relaxed) + 1;
+    ScopeSlot& slot = scopes[id % kScopes];
+
+    slot.id.store(0, std::memory_order_relaxed);
+    slot.current.store(0, std::memory_order_relaxed);
+    slot.peak.store(0, std::memory_order_relaxed);
+    slot.allocations.store(0, std::memory_order_relaxed);
+    slot.id.store(id, std::memory_order_release);
+
+    return id;
+}
+
+unsigned long long memScopeSwitch(unsigned long long id) {
+    unsigned long long previous = thread_scope;
+    thread_scope = id;
+    return previous;
+}
+
+unsigned long long memScopeCurrent() { return thread_scope; }
+
+MemScope memScopeRead(unsigned long long id) {
+    MemScope res;
+    ScopeSlot& slot = scopes[id % kScopes];
+
+    if (id && slot.id.load(std::memory_order_acquire) == id) {
+        res.current = slot.current.load(std::memory_order_relaxed);
+        res.peak = slot.peak.load(std::memory_order_relaxed);
+        res.allocations = slot.allocations.load(std::memory_order_relaxed);
+    }
+
+    return res;
+}
+
+/// \brief Raise an atomic peak to at least now.
+static void raisePeak(std::atomic<size_t>& peak_counter, size_t now) {
+    size_t peak = peak_counter.load(std::memory_order_relaxed);
+
+    while (now > peak && !peak_counter.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+    }
+}
+
+/// \brief Record size bytes as allocated in the global counters and the scope of the thread.
+static void countAlloc(size_t size) {
+    raisePeak(peak_bytes, current_bytes.fetch_add(size, std::memory_order_relaxed) + size);
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    unsigned long long id = thread_scope;
+    ScopeSlot& slot = scopes[id % kScopes];
+    if (id && slot.id.load(std::memory_order_relaxed) == id) {
+        raisePeak(slot.peak, slot.current.fetch_add(size, std::memory_order_relaxed) + size);
+        slot.allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/// \brief Record the release of size bytes allocated in scope id.
+static void countFree(size_t size, unsigned long long id) {
+    current_bytes.fetch_sub(size, std::memory_order_relaxed);
+
+    ScopeSlot& slot = scopes[id % kScopes];
+    if (id && slot.id.load(std::memory_order_relaxed) == id) {
+        slot.current.fetch_sub(size, std::memory_order_relaxed);
+    }
+}
+
+/// \brief Allocate size bytes with the given alignment and store the size in front of the block.
+static void* countedAlloc(size_t size, size_t align) {
+    size_t header = align > kHeader ? align : kHeader;
+    size_t total = (size + header + align - 1) / align * align;
+
+    char *raw = (char*)(align > kHeader ? aligned_alloc(align, total) : malloc(total));
+    if (!raw) {
+        return nullptr;
+    }
+
+    char *user = raw + header;
+    *((size_t*)user - 1) = size;
+    *((unsigned long long*)user - 2) = thread_scope;
+    countAlloc(size);
+
+    return user;
+}
+
+/// \brief Release a block allocated by countedAlloc().
+static void countedFree(void *ptr, size_t align) {
+    if (!ptr) {
+        return;
+    }
+
+    size_t header = align > kHeader ? align : kHeader;
+    countFree(*((size_t*)ptr - 1), *((unsigned long long*)ptr - 2));
+    free((char*)ptr - header);
+}
+
+void* operator new(size_t size) {
+    void *ptr = countedAlloc(size, kHeader);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size, kHeader); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size, kHeader); }
+
+void operator delete(void *ptr) noexcept { countedFree(ptr, kHeader); }
+void operator delete[](void *ptr) noexcept { countedFree(ptr, kHeader); }
+void operator delete(void *ptr, size_t) noexcept { countedFree(ptr, kHeader); }
+void operator delete[](void *ptr, size_t) noexcept { countedFree(ptr, kHeader); }
+void operator delete(void *ptr, const std::nothrow_t&) noexcept { countedFree(ptr, kHeader); }
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept { countedFree(ptr, kHeader); }
+
+void* operator new(size_t size, std::align_val_t align) {
+    void *ptr = countedAlloc(size, (size_t)align);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size, std::align_val_t align) { return operator new(size, align); }
+void operator delete(void *ptr, std::align_val_t align) noexcept { countedFree(ptr, (size_t)align); }
+void operator delete[](void *ptr, std::align_val_t align) noexcept { countedFree(ptr, (size_t)align); }
+void operator delete(void *ptr, size_t, std::align_val_t align) noexcept { countedFree(ptr, (size_t)align); }
+void operator delete[](void *ptr, size_t, std::align_val_t align) noexcept { countedFree(ptr, (size_t)align); }
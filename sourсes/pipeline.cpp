@@ -0,0 +1,139 @@
+/// \file  pipeline.cpp
+/// \brief Implements the reader, parser and consumer stages of runPipeline().
+
+#include "../headers/pipeline.h"
+#include "../headers/coro.h"
+#include "../headers/io.h"
+#include "../headers/trace.h"
+
+#include <fstream>
+#include <stdexcept>
+
+/// \brief A block of whole lines of one dataset file.
+struct Chunk {
+    size_t dataset_;
+    string text_;
+    bool last_;     ///< The last chunk of the file.
+};
+
+/// \brief The rows of one dataset file.
+struct Dataset {
+    size_t index_;
+    vector<Flower> rows_;
+};
+
+/// \brief Read the files into chunks; the first line of every file (the header) is dropped.
+static Task<> readFiles(ThreadPool& pool, const vector<string>& paths, BoundedQueue<Chunk>& chunks) {
+    co_await resumeOn(pool);
+
+    try {
+        for (size_t i = 0; i < paths.size(); ++i) {
+            ifstream file(paths[i], ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Cannot open CSV file: " + paths[i]);
+            }
+
+            string carry;
+            bool header = true;
+            for (;;) {
+                TraceSpan span("read chunk", i);
+                string text = std::move(carry);
+                size_t start = text.size();
+                text.resize(start + PIPELINE_CHUNK);
+                file.read(&text[start], PIPELINE_CHUNK);
+                text.resize(start + file.gcount());
+                bool last = file.gcount() < PIPELINE_CHUNK;
+
+                // Keep a partial last line for the next chunk.
+                size_t end = text.size();
+                if (!last) {
+                    size_t newline = text.rfind('\n');
+                    end = newline == string::npos ? 0 : newline + 1;
+                }
+                carry = text.substr(end);
+                text.resize(end);
+
+                if (header) {
+                    size_t newline = text.find('\n');
+                    if (newline == string::npos && !last) {
+                        carry = text + carry;
+                        continue;
+                    }
+                    text.erase(0, newline == string::npos ? text.size() : newline + 1);
+                    header = false;
+                }
+                span.End();
+
+                // A named value, not a temporary inside the co_await expression: GCC 12 frees such
+                // temporaries before the awaiter has moved them.
+                Chunk chunk{ i, std::move(text), last };
+                if (!co_await chunks.Push(std::move(chunk))) {
+                    co_return;
+                }
+                if (last) {
+                    break;
+                }
+            }
+        }
+    } catch (...) {
+        chunks.Close();
+        throw;
+    }
+
+    chunks.Close();
+}
+
+/// \brief Parse the chunks and pass on every dataset once its last chunk is parsed; an error stops both neighbours.
+static Task<> parseChunks(ThreadPool& pool, BoundedQueue<Chunk>& chunks, BoundedQueue<Dataset>& datasets) {
+    co_await resumeOn(pool);
+
+    try {
+        vector<Flower> rows;
+        while (optional<Chunk> chunk = co_await chunks.Pop()) {
+            parserCSVChunk(chunk->text_.data(), chunk->text_.size(), rows);
+
+            if (chunk->last_) {
+                Dataset dataset{ chunk->dataset_, std::move(rows) };
+                if (!co_await datasets.Push(std::move(dataset))) {
+                    chunks.Close();
+                    co_return;
+                }
+                rows = vector<Flower>();
+            }
+        }
+    } catch (...) {
+        chunks.Close();
+        datasets.Close();
+        throw;
+    }
+
+    datasets.Close();
+}
+
+/// \brief Hand the datasets to consume() in order; on an error the earlier stages are stopped.
+static Task<> consumeDatasets(ThreadPool& pool, BoundedQueue<Dataset>& datasets,
+                              const function<void(size_t, vector<Flower>&)>& consume) {
+    co_await resumeOn(pool);
+
+    try {
+        while (optional<Dataset> dataset = co_await datasets.Pop()) {
+            consume(dataset->index_, dataset->rows_);
+        }
+    } catch (...) {
+        datasets.Close();
+        throw;
+    }
+}
+
+void runPipeline(const vector<string>& paths, const function<void(size_t, vector<Flower>&)>& consume) {
+    // One worker per stage; the calling thread only waits.
+    ThreadPool pool(4);
+    BoundedQueue<Chunk> chunks(pool, PIPELINE_CHUNKS);
+    BoundedQueue<Dataset> datasets(pool, PIPELINE_DATASETS);
+
+    vector<Task<>> stages;
+    stages.push_back(readFiles(pool, paths, chunks));
+    stages.push_back(parseChunks(pool, chunks, datasets));
+    stages.push_back(consumeDatasets(pool, datasets, consume));
+    syncWaitAll(stages);
+}
@@ -0,0 +1,105 @@
+/// \file  pool.cpp
+/// \brief Implements the worker threads of ThreadPool and the group wait of RunAll().
+
+#include "../headers/pool.h"
+#include "../headers/memory.h"
+
+#include <exception>
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) {
+        threads = max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 1; i < threads; ++i) {
+        workers_.emplace_back(&ThreadPool::Work, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_.notify_all();
+
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::RunAll(vector<function<void()>> tasks) {
+    size_t left = tasks.size();
+    exception_ptr error;
+    unsigned long long scope = memScopeCurrent();
+
+    unique_lock<std::mutex> lock(mutex_);
+    for (function<void()>& task : tasks) {
+        queue_.push_back(Task{ [this, &left, &error, task = std::move(task)] {
+            exception_ptr failure;
+            try {
+                task();
+            } catch (...) {
+                failure = current_exception();
+            }
+
+            lock_guard<std::mutex> guard(mutex_);
+            if (failure && !error) {
+                error = failure;
+            }
+            left -= 1;
+        }, scope });
+    }
+    work_.notify_all();
+
+    while (left > 0) {
+        if (!queue_.empty()) {
+            RunOne(lock);
+        } else {
+            done_.wait(lock);
+        }
+    }
+    lock.unlock();
+
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+void ThreadPool::Post(function<void()> task) {
+    if (workers_.empty()) {
+        task();
+        return;
+    }
+
+    {
+        lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(Task{ std::move(task), memScopeCurrent() });
+    }
+    work_.notify_one();
+}
+
+void ThreadPool::Work() {
+    unique_lock<std::mutex> lock(mutex_);
+
+    for (;;) {
+        work_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return;
+        }
+        RunOne(lock);
+    }
+}
+
+void ThreadPool::RunOne(unique_lock<std::mutex>& lock) {
+    Task task = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+
+    unsigned long long previous = memScopeSwitch(task.scope_);
+    task.run_();
+    memScopeSwitch(previous);
+
+    lock.lock();
+    done_.notify_all();
+}
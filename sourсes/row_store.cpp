@@ -0,0 +1,102 @@
+/// \file  row_store.cpp
+/// \brief Implements tombstones and the background compaction of RowStore.
+
+#include "../headers/row_store.h"
+
+RowStore::RowStore(vector<Flower> rows) : rows_(std::move(rows)), dead_(rows_.size(), 0) {}
+
+RowStore::~RowStore() {
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+RowId RowStore::Append(const Flower& row) {
+    if (worker_.joinable()) {
+        tail_.push_back(row);
+    } else {
+        rows_.push_back(row);
+    }
+
+    dead_.push_back(0);
+    return (RowId)(dead_.size() - 1);
+}
+
+bool RowStore::Erase(RowId id) {
+    if (!IsLive(id)) {
+        return false;
+    }
+
+    dead_[id] = 1;
+    dead_count_ += 1;
+    return true;
+}
+
+RowId RowStore::Update(RowId id, const Flower& row) {
+    if (!Erase(id)) {
+        return NO_ROW;
+    }
+    return Append(row);
+}
+
+bool RowStore::StartCompaction() {
+    if (worker_.joinable()) {
+        return false;
+    }
+
+    snapshot_ = dead_;
+    done_ = false;
+    worker_ = std::thread(&RowStore::Compact, this);
+    return true;
+}
+
+bool RowStore::FinishCompaction(vector<RowId>& remap, bool wait) {
+    if (!worker_.joinable() || (!wait && !done_)) {
+        return false;
+    }
+    worker_.join();
+
+    remap = std::move(remap_);
+    vector<unsigned char> dead(compacted_.size(), 0);
+    size_t dead_count = 0;
+
+    // Rows erased while the worker was copying them stay, under their new id, as tombstones.
+    for (size_t id = 0; id < rows_.size(); ++id) {
+        if (remap[id] != NO_ROW && dead_[id]) {
+            dead[remap[id]] = 1;
+            dead_count += 1;
+        }
+    }
+
+    for (size_t i = 0; i < tail_.size(); ++i) {
+        if (dead_[rows_.size() + i]) {
+            remap.push_back(NO_ROW);
+        } else {
+            remap.push_back((RowId)compacted_.size());
+            compacted_.push_back(std::move(tail_[i]));
+            dead.push_back(0);
+        }
+    }
+
+    rows_ = std::move(compacted_);
+    compacted_.clear();
+    tail_.clear();
+    snapshot_.clear();
+    dead_ = std::move(dead);
+    dead_count_ = dead_count;
+    return true;
+}
+
+void RowStore::Compact() {
+    compacted_.clear();
+    remap_.assign(rows_.size(), NO_ROW);
+
+    for (size_t id = 0; id < rows_.size(); ++id) {
+        if (!snapshot_[id]) {
+            remap_[id] = (RowId)compacted_.size();
+            compacted_.push_back(rows_[id]);
+        }
+    }
+
+    done_ = true;
+}
@@ -0,0 +1,374 @@
+/// \file  server.cpp
+/// \brief Implements the indexes, the epoll loop and the query answering of QueryServer.
+
+#include "../headers/server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/// \brief epoll data of the sockets that are not connections.
+#define LISTENER_SERIAL 0
+#define WAKE_SERIAL 1
+#define SIGNAL_SERIAL 2
+
+QueryServer::QueryServer(const vector<Flower>& rows, unsigned threads) : rows_(rows.size()), names_(rows) {
+    for (size_t i = 0; i < rows.size(); ++i) {
+        colors_[rows[i].GetColor()].push_back((RowId)i);
+        smells_[rows[i].GetSmell()].push_back((RowId)i);
+        for (const string& region : rows[i].GetRegions()) {
+            regions_[region].push_back((RowId)i);
+        }
+    }
+
+    wake_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_ < 0) {
+        throw runtime_error(string("eventfd: ") + strerror(errno));
+    }
+
+    if (threads == 0) {
+        threads = max(1u, std::thread::hardware_concurrency());
+    }
+
+    // The workers inherit the signal mask: SIGINT and SIGTERM must only reach the signalfd of Serve().
+    sigset_t signals, old;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, &old);
+    pool_ = make_unique<ThreadPool>(threads + 1);
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+}
+
+QueryServer::~QueryServer() {
+    pool_.reset();
+    close(wake_);
+}
+
+void QueryServer::Stop() {
+    uint64_t one = 1;
+    stop_ = true;
+    (void)!write(wake_, &one, sizeof(one));
+}
+
+void QueryServer::Serve(const string& path) {
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw runtime_error("Socket path is too long: " + path);
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    sigset_t signals, old;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, &old);
+    int sigfd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path.c_str());
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+
+    if (sigfd < 0 || listener < 0 || epoll_ < 0 || bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(listener, SOMAXCONN) < 0) {
+        string error = strerror(errno);
+        close(sigfd);
+        close(listener);
+        close(epoll_);
+        pthread_sigmask(SIG_SETMASK, &old, nullptr);
+        throw runtime_error("Could not listen on " + path + ": " + error);
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTENER_SERIAL;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, listener, &event);
+    event.data.u64 = WAKE_SERIAL;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &event);
+    event.data.u64 = SIGNAL_SERIAL;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, sigfd, &event);
+
+    epoll_event events[64];
+    while (!stop_) {
+        int count = epoll_wait(epoll_, events, 64, -1);
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            uint64_t serial = events[i].data.u64;
+            if (serial == LISTENER_SERIAL) {
+                Accept(listener);
+            } else if (serial == WAKE_SERIAL) {
+                Complete();
+            } else if (serial == SIGNAL_SERIAL) {
+                stop_ = true;
+            } else {
+                auto it = connections_.find(serial);
+                if (it == connections_.end()) {
+                    continue;
+                }
+
+                Connection& conn = it->second;
+                if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                    Close(serial, conn);
+                    continue;
+                }
+                if (events[i].events & EPOLLIN) {
+                    Read(serial, conn);
+                }
+                Flush(conn);
+                Update(serial, conn);
+            }
+        }
+    }
+
+    while (!connections_.empty()) {
+        Close(connections_.begin()->first, connections_.begin()->second);
+    }
+    close(listener);
+    close(sigfd);
+    close(epoll_);
+    epoll_ = -1;
+    unlink(path.c_str());
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+}
+
+void QueryServer::Answer(const char *body, size_t size, string& out) const {
+    uint32_t id = 0;
+    vector<Query> queries;
+    bool valid = decodeRequest(body, size, id, queries);
+    for (const Query& query : queries) {
+        valid = valid && query.op_ >= OP_EXACT && query.op_ <= OP_REGION;
+    }
+    if (!valid) {
+        queries.clear();
+    }
+
+    size_t start = out.size();
+    putInt<uint32_t>(out, 0);
+    putInt<uint32_t>(out, id);
+    putInt<uint8_t>(out, valid ? REPLY_OK : REPLY_BAD_REQUEST);
+    putInt<uint16_t>(out, (uint16_t)queries.size());
+
+    // The headers of all results always fit (65535 of 8 bytes); the rest of MAX_FRAME is shared by the row ids.
+    size_t budget = MAX_FRAME - (out.size() - start - FRAME_HEADER) - queries.size() * 2 * sizeof(uint32_t);
+    for (const Query& query : queries) {
+        AnswerQuery(query, out, budget);
+    }
+
+    uint32_t length = (uint32_t)(out.size() - start - FRAME_HEADER);
+    memcpy(&out[start], &length, sizeof(length));
+}
+
+void QueryServer::AnswerQuery(const Query& query, string& out, size_t& budget) const {
+    RowRange range;
+    const unordered_map<string, vector<RowId>> *postings = nullptr;
+
+    switch (query.op_) {
+    case OP_EXACT:
+        range = names_.Search(query.key_);
+        break;
+    case OP_PREFIX:
+        range = names_.SearchPrefix(query.key_);
+        break;
+    case OP_COLOR:
+        postings = &colors_;
+        break;
+    case OP_SMELL:
+        postings = &smells_;
+        break;
+    default:
+        postings = &regions_;
+        break;
+    }
+
+    if (postings) {
+        auto it = postings->find(query.key_);
+        if (it != postings->end()) {
+            range.begin_ = it->second.data();
+            range.end_ = it->second.data() + it->second.size();
+        }
+    }
+
+    uint32_t returned = (uint32_t)min<size_t>({ range.size(), query.limit_, budget / sizeof(RowId) });
+    budget -= returned * sizeof(RowId);
+    putInt<uint32_t>(out, (uint32_t)range.size());
+    putInt<uint32_t>(out, returned);
+    out.append((const char*)range.begin(), returned * sizeof(RowId));
+}
+
+void QueryServer::Accept(int listener) {
+    for (;;) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+
+        uint64_t serial = next_serial_++;
+        Connection& conn = connections_[serial];
+        conn.fd_ = fd;
+        conn.events_ = EPOLLIN;
+
+        epoll_event event{};
+        event.events = conn.events_;
+        event.data.u64 = serial;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void QueryServer::Read(uint64_t serial, Connection& conn) {
+    char chunk[SERVER_READ_CHUNK];
+
+    for (;;) {
+        ssize_t got = recv(conn.fd_, chunk, sizeof(chunk), 0);
+        if (got > 0) {
+            conn.in_.append(chunk, got);
+            if ((size_t)got == sizeof(chunk)) {
+                continue;
+            }
+        } else if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            conn.eof_ = true;
+        } else if (errno == EINTR) {
+            continue;
+        }
+        break;
+    }
+
+    // Cut off the complete frames; a frame larger than MAX_FRAME ends the connection.
+    size_t end = 0;
+    while (conn.in_.size() - end >= FRAME_HEADER) {
+        uint32_t body = 0;
+        memcpy(&body, conn.in_.data() + end, sizeof(body));
+        if (body > MAX_FRAME) {
+            conn.eof_ = true;
+            break;
+        }
+
+        size_t length = frameLength(conn.in_.data() + end, conn.in_.size() - end);
+        if (length == 0) {
+            break;
+        }
+        end += length;
+    }
+
+    if (end == 0) {
+        return;
+    }
+
+    string frames = conn.in_.substr(0, end);
+    conn.in_.erase(0, end);
+
+    shared_ptr<Reply> reply = make_shared<Reply>();
+    conn.pending_.push_back(reply);
+
+    pool_->Post([this, serial, reply, frames = std::move(frames)] {
+        string out;
+        for (size_t pos = 0; pos < frames.size(); ) {
+            uint32_t body = 0;
+            memcpy(&body, frames.data() + pos, sizeof(body));
+            Answer(frames.data() + pos + FRAME_HEADER, body, out);
+            pos += FRAME_HEADER + body;
+        }
+
+        {
+            lock_guard<std::mutex> lock(done_mutex_);
+            reply->bytes_ = std::move(out);
+            reply->ready_ = true;
+            done_.push_back(serial);
+        }
+
+        uint64_t one = 1;
+        (void)!write(wake_, &one, sizeof(one));
+    });
+}
+
+void QueryServer::Flush(Connection& conn) {
+    {
+        lock_guard<std::mutex> lock(done_mutex_);
+        while (!conn.pending_.empty() && conn.pending_.front()->ready_) {
+            conn.out_ += conn.pending_.front()->bytes_;
+            conn.pending_.pop_front();
+        }
+    }
+
+    while (conn.out_pos_ < conn.out_.size()) {
+        ssize_t sent = send(conn.fd_, conn.out_.data() + conn.out_pos_, conn.out_.size() - conn.out_pos_, MSG_NOSIGNAL);
+        if (sent > 0) {
+            conn.out_pos_ += sent;
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                // The peer is gone: nothing that is pending can be delivered.
+                conn.eof_ = true;
+                conn.pending_.clear();
+                conn.out_pos_ = conn.out_.size();
+            }
+            break;
+        }
+    }
+
+    if (conn.out_pos_ == conn.out_.size()) {
+        conn.out_.clear();
+        conn.out_pos_ = 0;
+    }
+}
+
+void QueryServer::Update(uint64_t serial, Connection& conn) {
+    if (conn.eof_ && conn.pending_.empty() && conn.out_.empty()) {
+        Close(serial, conn);
+        return;
+    }
+
+    uint32_t events = 0;
+    if (!conn.eof_ && conn.pending_.size() < SERVER_MAX_PENDING) {
+        events |= EPOLLIN;
+    }
+    if (!conn.out_.empty()) {
+        events |= EPOLLOUT;
+    }
+
+    if (events != conn.events_) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = serial;
+        epoll_ctl(epoll_, EPOLL_CTL_MOD, conn.fd_, &event);
+        conn.events_ = events;
+    }
+}
+
+void QueryServer::Close(uint64_t serial, Connection& conn) {
+    epoll_ctl(epoll_, EPOLL_CTL_DEL, conn.fd_, nullptr);
+    close(conn.fd_);
+    connections_.erase(serial);
+}
+
+void QueryServer::Complete() {
+    uint64_t value = 0;
+    (void)!read(wake_, &value, sizeof(value));
+
+    vector<uint64_t> done;
+    {
+        lock_guard<std::mutex> lock(done_mutex_);
+        done.swap(done_);
+    }
+
+    for (uint64_t serial : done) {
+        auto it = connections_.find(serial);
+        if (it != connections_.end()) {
+            Flush(it->second);
+            Update(serial, it->second);
+        }
+    }
+}
@@ -0,0 +1,166 @@
+/// \file  sink.cpp
+/// \brief Implements the background result writer and the buffered result files.
+
+#include "../headers/sink.h"
+
+#include <cerrno>
+#include <climits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+SinkWriter::SinkWriter() : thread_(&SinkWriter::Run, this) {}
+
+SinkWriter::~SinkWriter() {
+    {
+        lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_.notify_one();
+    thread_.join();
+}
+
+string SinkWriter::Acquire() {
+    string buffer;
+    {
+        lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            buffer = std::move(free_.back());
+            free_.pop_back();
+        }
+    }
+
+    buffer.clear();
+    buffer.reserve(SINK_BUFFER_SIZE);
+    return buffer;
+}
+
+void SinkWriter::Submit(int fd, string&& buffer, bool close) {
+    {
+        lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(Job{ fd, std::move(buffer), close });
+    }
+    work_.notify_one();
+}
+
+void SinkWriter::Drain() {
+    unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return jobs_.empty() && !busy_; });
+
+    if (!error_.empty()) {
+        string error = error_;
+        error_.clear();
+        throw std::runtime_error(error);
+    }
+}
+
+void SinkWriter::Run() {
+    vector<Job> batch;
+
+    for (;;) {
+        {
+            unique_lock<std::mutex> lock(mutex_);
+            busy_ = false;
+            if (jobs_.empty()) {
+                idle_.notify_all();
+            }
+            work_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+            if (jobs_.empty()) {
+                return;
+            }
+
+            // Take the leading jobs of one file, up to the first one that closes it.
+            int fd = jobs_.front().fd_;
+            while (!jobs_.empty() && jobs_.front().fd_ == fd && batch.size() < IOV_MAX) {
+                bool close = jobs_.front().close_;
+                batch.push_back(std::move(jobs_.front()));
+                jobs_.pop_front();
+                if (close) {
+                    break;
+                }
+            }
+            busy_ = true;
+        }
+
+        string error = WriteBatch(batch);
+
+        lock_guard<std::mutex> lock(mutex_);
+        if (!error.empty() && error_.empty()) {
+            error_ = error;
+        }
+        for (Job& job : batch) {
+            free_.push_back(std::move(job.buffer_));
+        }
+        batch.clear();
+    }
+}
+
+string SinkWriter::WriteBatch(vector<Job>& batch) {
+    int fd = batch.front().fd_;
+    string error;
+
+    vector<iovec> iov;
+    for (Job& job : batch) {
+        if (!job.buffer_.empty()) {
+            iov.push_back(iovec{ (void*)job.buffer_.data(), job.buffer_.size() });
+        }
+    }
+
+    size_t first = 0;
+    while (first < iov.size()) {
+        ssize_t written = writev(fd, iov.data() + first, (int)(iov.size() - first));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = "Write error: " + string(strerror(errno));
+            break;
+        }
+
+        // Skip the fully written buffers and shift the partially written one.
+        size_t left = written;
+        while (first < iov.size() && left >= iov[first].iov_len) {
+            left -= iov[first].iov_len;
+            first += 1;
+        }
+        if (first < iov.size()) {
+            iov[first].iov_base = (char*)iov[first].iov_base + left;
+            iov[first].iov_len -= left;
+        }
+    }
+
+    if (batch.back().close_ && close(fd) != 0 && error.empty()) {
+        error = "Write error: " + string(strerror(errno));
+    }
+
+    return error;
+}
+
+ResultSink::ResultSink(SinkWriter& writer, const string& path) : writer_(writer) {
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("Cannot open file for writing: " + path);
+    }
+    buffer_ = writer_.Acquire();
+}
+
+void ResultSink::Close() {
+    if (fd_ < 0) {
+        return;
+    }
+
+    writer_.Submit(fd_, std::move(buffer_), true);
+    fd_ = -1;
+    buffer_ = string();
+}
+
+void ResultSink::Spill() {
+    writer_.Submit(fd_, std::move(buffer_), false);
+    buffer_ = writer_.Acquire();
+}
@@ -0,0 +1,227 @@
+/// \file  skip_list.cpp
+/// \brief Implements the lock-free arena and the inserts, searches and scans of SkipList.
+
+#include "../headers/skip_list.h"
+
+#include <algorithm>
+#include <new>
+#include <thread>
+
+SkipArena::~SkipArena() {
+    Block *block = current_.load();
+    while (block) {
+        Block *next = block->next_;
+        block->~Block();
+        delete[] (char*)block;
+        block = next;
+    }
+}
+
+void* SkipArena::Allocate(size_t bytes) {
+    bytes = (bytes + 15) & ~(size_t)15;
+
+    for (;;) {
+        Block *block = current_.load(memory_order_acquire);
+        if (block) {
+            size_t offset = block->used_.fetch_add(bytes, memory_order_relaxed);
+            if (offset + bytes <= block->size_) {
+                return block->Data() + offset;
+            }
+        }
+
+        size_t size = max<size_t>(SKIP_ARENA_BLOCK, bytes);
+        Block *fresh = new (new char[HEADER + size]) Block{ block, size, { bytes } };
+        if (current_.compare_exchange_strong(block, fresh, memory_order_acq_rel, memory_order_acquire)) {
+            bytes_.fetch_add(HEADER + size, memory_order_relaxed);
+            return fresh->Data();
+        }
+
+        fresh->~Block();
+        delete[] (char*)fresh;
+    }
+}
+
+SkipList::SkipList() {
+    head_ = NewTower(nullptr, SKIP_MAX_HEIGHT);
+}
+
+SkipList::~SkipList() {
+    // The arena frees the memory; only the rows own heap memory of their own.
+    for (Tower *tower = head_->next_[0].load(); tower; tower = tower->next_[0].load()) {
+        for (Row *row = tower->rows_.load(); row; row = row->next_) {
+            row->~Row();
+        }
+    }
+}
+
+void SkipList::Insert(const Flower& value) {
+    Row *row = new (arena_.Allocate(sizeof(Row))) Row{ value, { SKIP_UNNUMBERED }, nullptr };
+    const InlineKey& key = row->row_.GetKey();
+    const string& name = row->row_.GetName();
+
+    Tower *preds[SKIP_MAX_HEIGHT], *succs[SKIP_MAX_HEIGHT];
+    Tower *tower = nullptr;
+
+    for (;;) {
+        Tower *found = Find(key, name, preds, succs);
+        if (found) {
+            // A tower made in an earlier round stays unused in the arena.
+            Row *head = found->rows_.load(memory_order_relaxed);
+            do {
+                row->next_ = head;
+            } while (!found->rows_.compare_exchange_weak(head, row, memory_order_release, memory_order_relaxed));
+
+            row->number_.store(clock_.fetch_add(1), memory_order_release);
+            return;
+        }
+
+        if (!tower) {
+            tower = NewTower(row, RandomHeight());
+        }
+        for (int level = 0; level < tower->height_; ++level) {
+            tower->next_[level].store(succs[level], memory_order_relaxed);
+        }
+
+        if (preds[0]->next_[0].compare_exchange_strong(succs[0], tower, memory_order_release, memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    row->number_.store(clock_.fetch_add(1), memory_order_release);
+
+    // The upper levels only shorten searches: link them one by one, searching again after a lost race.
+    for (int level = 1; level < tower->height_; ++level) {
+        while (!preds[level]->next_[level].compare_exchange_strong(succs[level], tower, memory_order_release,
+                                                                    memory_order_relaxed)) {
+            Find(key, name, preds, succs);
+            tower->next_[level].store(succs[level], memory_order_relaxed);
+        }
+    }
+}
+
+vector<const Flower*> SkipList::SearchAll(const string& name) const {
+    uint64_t now = clock_.load();
+    vector<const Flower*> out;
+
+    Tower *tower = LowerBound(name);
+    if (tower && Compare(tower, InlineKey(name), name) == 0) {
+        CollectRows(tower, now, out);
+    }
+    return out;
+}
+
+vector<const Flower*> SkipList::Range(const string& low, const string& high) const {
+    uint64_t now = clock_.load();
+    vector<const Flower*> out;
+    Collect(LowerBound(low), &high, now, out);
+    return out;
+}
+
+vector<const Flower*> SkipList::All() const {
+    uint64_t now = clock_.load();
+    vector<const Flower*> out;
+    Collect(head_->next_[0].load(memory_order_acquire), nullptr, now, out);
+    return out;
+}
+
+int SkipList::Compare(const Tower *tower, const InlineKey& key, const string& name) {
+    int order = tower->key_.Compare(key);
+    if (order == 0 && key.Truncated()) {
+        return tower->first_->GetName().compare(name);
+    }
+    return order;
+}
+
+SkipList::Tower* SkipList::Find(const InlineKey& key, const string& name, Tower **preds, Tower **succs) const {
+    Tower *pred = head_;
+
+    // Every level is walked: an empty one costs a single load, and a cached height could be
+    // stale and hide a tower that was linked at a higher level meanwhile.
+    for (int level = SKIP_MAX_HEIGHT - 1; level >= 0; --level) {
+        Tower *cur = pred->next_[level].load(memory_order_acquire);
+        while (cur && Compare(cur, key, name) < 0) {
+            pred = cur;
+            cur = cur->next_[level].load(memory_order_acquire);
+        }
+        preds[level] = pred;
+        succs[level] = cur;
+    }
+
+    return succs[0] && Compare(succs[0], key, name) == 0 ? succs[0] : nullptr;
+}
+
+SkipList::Tower* SkipList::LowerBound(const string& name) const {
+    InlineKey key(name);
+    Tower *pred = head_;
+    Tower *cur = nullptr;
+
+    for (int level = SKIP_MAX_HEIGHT - 1; level >= 0; --level) {
+        cur = pred->next_[level].load(memory_order_acquire);
+        while (cur && Compare(cur, key, name) < 0) {
+            pred = cur;
+            cur = cur->next_[level].load(memory_order_acquire);
+        }
+    }
+
+    return cur;
+}
+
+void SkipList::Collect(const Tower *first, const string *high, uint64_t now, vector<const Flower*>& out) const {
+    InlineKey high_key(high ? *high : string());
+
+    for (const Tower *tower = first; tower; tower = tower->next_[0].load(memory_order_acquire)) {
+        if (high && Compare(tower, high_key, *high) >= 0) {
+            break;
+        }
+        CollectRows(tower, now, out);
+    }
+}
+
+void SkipList::CollectRows(const Tower *tower, uint64_t now, vector<const Flower*>& out) {
+    size_t start = out.size();
+
+    for (const Row *row = tower->rows_.load(memory_order_acquire); row; row = row->next_) {
+        if (WaitNumber(row) < now) {
+            out.push_back(&row->row_);
+        }
+    }
+
+    // The list runs from the newest row to the oldest.
+    reverse(out.begin() + start, out.end());
+}
+
+uint64_t SkipList::WaitNumber(const Row *row) {
+    uint64_t number;
+    while ((number = row->number_.load(memory_order_acquire)) == SKIP_UNNUMBERED) {
+        this_thread::yield();
+    }
+    return number;
+}
+
+SkipList::Tower* SkipList::NewTower(Row *first, int height) {
+    size_t bytes = sizeof(Tower) + (height - 1) * sizeof(atomic<Tower*>);
+    Tower *tower = new (arena_.Allocate(bytes)) Tower{ InlineKey(), first ? &first->row_ : nullptr, { nullptr },
+                                                       height, { nullptr } };
+    if (first) {
+        tower->key_ = first->row_.GetKey();
+        tower->rows_.store(first, memory_order_relaxed);
+    }
+    for (int level = 1; level < height; ++level) {
+        new (&tower->next_[level]) atomic<Tower*>(nullptr);
+    }
+    return tower;
+}
+
+int SkipList::RandomHeight() {
+    thread_local uint64_t state = 0x9e3779b97f4a7c15ULL ^ (uint64_t)hash<thread::id>()(this_thread::get_id());
+
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    int height = 1;
+    for (uint64_t bits = state; height < SKIP_MAX_HEIGHT && (bits & 3) == 0; bits >>= 2) {
+        height += 1;
+    }
+    return height;
+}
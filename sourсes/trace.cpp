@@ -0,0 +1,244 @@
+/// \file  trace.cpp
+/// \brief Implements thread-local trace ring buffers, hardware counters and the Chrome JSON export.
+
+#include "../headers/trace.h"
+#include "../headers/bench.h"
+#include "../headers/memory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/// \brief Number of spans kept per thread; older spans are overwritten.
+#define TRACE_CAPACITY (1 << 16)
+
+static std::atomic<bool> enabled(false);
+static std::atomic<bool> perf_enabled(false);
+
+/// \brief Ring buffer of one thread. Only the owner thread writes to it.
+struct TraceBuffer {
+    vector<TraceEvent> events;
+    size_t head = 0;              ///< Number of spans ever written.
+    int tid = 0;
+    int perf_fd = -1;             ///< Group leader of the hardware counters, -1 if unavailable.
+};
+
+static std::mutex registry_mutex;
+static vector<unique_ptr<TraceBuffer>> registry;
+
+/// \brief Open the hardware counters of the calling thread as one group.
+static void openPerf(TraceBuffer *buffer) {
+#ifdef __linux__
+    const uint64_t configs[PERF_COUNTERS] = { PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                              PERF_COUNT_HW_BRANCH_MISSES };
+
+    for (int i = 0; i < PERF_COUNTERS; ++i) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.disabled = i == 0;
+
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : buffer->perf_fd, 0);
+        if (fd < 0) {
+            if (buffer->perf_fd >= 0) {
+                close(buffer->perf_fd);
+            }
+            buffer->perf_fd = -1;
+            return;
+        }
+
+        if (i == 0) {
+            buffer->perf_fd = fd;
+        }
+    }
+
+    ioctl(buffer->perf_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+    (void)buffer;
+#endif
+}
+
+/// \brief Buffer of the calling thread, created and registered on first use.
+static TraceBuffer* threadBuffer() {
+    thread_local TraceBuffer *buffer = nullptr;
+
+    if (!buffer) {
+        // The first span of a thread may start inside a build; its buffer is not part of the build.
+        unsigned long long scope = memScopeSwitch(0);
+
+        unique_ptr<TraceBuffer> created(new TraceBuffer());
+        created->events.resize(TRACE_CAPACITY);
+        if (perf_enabled.load(std::memory_order_relaxed)) {
+            openPerf(created.get());
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            created->tid = (int)registry.size() + 1;
+            buffer = created.get();
+            registry.push_back(std::move(created));
+        }
+        memScopeSwitch(scope);
+    }
+
+    return buffer;
+}
+
+/// \brief Read the current values of the hardware counters of the calling thread.
+static void readPerf(TraceBuffer *buffer, long long values[PERF_COUNTERS]) {
+    for (int i = 0; i < PERF_COUNTERS; ++i) {
+        values[i] = -1;
+    }
+
+#ifdef __linux__
+    if (buffer->perf_fd < 0) {
+        return;
+    }
+
+    uint64_t data[1 + PERF_COUNTERS];
+    if (read(buffer->perf_fd, data, sizeof(data)) == (ssize_t)sizeof(data) && data[0] == PERF_COUNTERS) {
+        for (int i = 0; i < PERF_COUNTERS; ++i) {
+            values[i] = (long long)data[1 + i];
+        }
+    }
+#else
+    (void)buffer;
+#endif
+}
+
+void traceEnable(bool perf_counters) {
+    perf_enabled.store(perf_counters, std::memory_order_relaxed);
+    enabled.store(true, std::memory_order_release);
+}
+
+bool traceEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+void TraceSpan::Begin(const string& name, long long arg) {
+    End();
+    if (!traceEnabled()) {
+        return;
+    }
+
+    size_t len = min(name.size(), sizeof(event_.name) - 1);
+    memcpy(event_.name, name.data(), len);
+    event_.name[len] = '\0';
+    event_.arg = arg;
+
+    readPerf(threadBuffer(), event_.perf);
+    active_ = true;
+    event_.start = tscNow();
+}
+
+void TraceSpan::End() {
+    if (!active_) {
+        return;
+    }
+
+    event_.end = tscNow();
+    active_ = false;
+
+    TraceBuffer *buffer = threadBuffer();
+    long long now[PERF_COUNTERS];
+    readPerf(buffer, now);
+    for (int i = 0; i < PERF_COUNTERS; ++i) {
+        event_.perf[i] = now[i] >= 0 && event_.perf[i] >= 0 ? now[i] - event_.perf[i] : -1;
+    }
+
+    buffer->events[buffer->head % TRACE_CAPACITY] = event_;
+    buffer->head += 1;
+}
+
+void TraceSpan::End(const string& name) {
+    if (!active_) {
+        return;
+    }
+
+    size_t len = min(name.size(), sizeof(event_.name) - 1);
+    memcpy(event_.name, name.data(), len);
+    event_.name[len] = '\0';
+    End();
+}
+
+/// \brief Write a string as a JSON string literal.
+static void writeJsonString(ofstream& fout, const char *text) {
+    fout << '"';
+    for (const char *p = text; *p; ++p) {
+        if (*p == '"' || *p == '\\') {
+            fout << '\\' << *p;
+        } else if ((unsigned char)*p < 0x20) {
+            fout << ' ';
+        } else {
+            fout << *p;
+        }
+    }
+    fout << '"';
+}
+
+void traceWriteChrome(const string& path) {
+    ofstream fout(path);
+    if (!fout.is_open()) {
+        throw std::runtime_error("Cannot open file for writing: " + path);
+    }
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    uint64_t base = UINT64_MAX;
+    for (const auto& buffer : registry) {
+        size_t count = min<size_t>(buffer->head, TRACE_CAPACITY);
+        for (size_t i = 0; i < count; ++i) {
+            base = min(base, buffer->events[i].start);
+        }
+    }
+
+    double us = tscSeconds() * 1e6;
+    const char *perf_names[PERF_COUNTERS] = { "instructions", "cache_misses", "branch_misses" };
+    bool first = true;
+
+    fout << "{\"traceEvents\": [" << endl;
+    for (const auto& buffer : registry) {
+        size_t count = min<size_t>(buffer->head, TRACE_CAPACITY);
+        size_t begin = buffer->head - count;
+
+        for (size_t i = begin; i < buffer->head; ++i) {
+            const TraceEvent& event = buffer->events[i % TRACE_CAPACITY];
+
+            fout << (first ? "" : ",\n") << "{\"name\": ";
+            writeJsonString(fout, event.name);
+            fout << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->tid
+                 << ", \"ts\": " << (event.start - base) * us << ", \"dur\": " << (event.end - event.start) * us
+                 << ", \"args\": {";
+
+            bool first_arg = true;
+            if (event.arg >= 0) {
+                fout << "\"arg\": " << event.arg;
+                first_arg = false;
+            }
+            for (int k = 0; k < PERF_COUNTERS; ++k) {
+                if (event.perf[k] >= 0) {
+                    fout << (first_arg ? "" : ", ") << "\"" << perf_names[k] << "\": " << event.perf[k];
+                    first_arg = false;
+                }
+            }
+            fout << "}}";
+            first = false;
+        }
+    }
+    fout << endl << "]}" << endl;
+}
@@ -0,0 +1,98 @@
+/// \file  window.cpp
+/// \brief Implements appends, expiry and searches of WindowIndex.
+
+#include "../headers/window.h"
+
+#include <stdexcept>
+
+WindowIndex::WindowIndex(const WindowConfig& config) : config_(config) {
+    if (config_.segment_rows == 0 || config_.segments == 0) {
+        throw std::runtime_error("Window needs at least one segment of at least one row");
+    }
+}
+
+void WindowIndex::Append(const Flower& row, double time) {
+    if (ring_.empty() || ring_.back()->rows_.size() == config_.segment_rows) {
+        Open();
+    }
+
+    Segment& open = *ring_.back();
+    open.index_[row.GetName()].push_back((RowId)open.rows_.size());
+    open.rows_.push_back(row);
+    open.last_time_ = time;
+    count_ += 1;
+
+    ClearStep();
+}
+
+size_t WindowIndex::Expire(double now) {
+    size_t dropped = 0;
+    if (config_.max_age <= 0) {
+        return dropped;
+    }
+
+    while (!ring_.empty() && ring_.front()->last_time_ < now - config_.max_age) {
+        dropped += ring_.front()->rows_.size();
+        DropOldest();
+    }
+    return dropped;
+}
+
+vector<const Flower*> WindowIndex::SearchAll(const string& name) const {
+    vector<const Flower*> res;
+
+    for (const unique_ptr<Segment>& segment : ring_) {
+        auto it = segment->index_.find(name);
+        if (it == segment->index_.end()) {
+            continue;
+        }
+        for (RowId id : it->second) {
+            res.push_back(&segment->rows_[id]);
+        }
+    }
+
+    return res;
+}
+
+void WindowIndex::Open() {
+    if (ring_.size() == config_.segments) {
+        DropOldest();
+    }
+
+    unique_ptr<Segment> segment = std::move(spare_);
+    if (!segment) {
+        segment = make_unique<Segment>();
+        segment->rows_.reserve(config_.segment_rows);
+    }
+    segment->generation_ = next_generation_++;
+    ring_.push_back(std::move(segment));
+}
+
+void WindowIndex::DropOldest() {
+    count_ -= ring_.front()->rows_.size();
+    retired_.push_back(std::move(ring_.front()));
+    ring_.pop_front();
+}
+
+void WindowIndex::ClearStep() {
+    if (retired_.empty()) {
+        return;
+    }
+
+    // pop_back() and erase() keep the capacity of rows_ and the buckets of index_ for the next generation.
+    Segment& segment = *retired_.front();
+    for (int step = 0; step < WINDOW_CLEAR_STEP && !segment.rows_.empty(); ++step) {
+        segment.rows_.pop_back();
+    }
+    for (int step = 0; step < WINDOW_CLEAR_STEP && !segment.index_.empty(); ++step) {
+        segment.index_.erase(segment.index_.begin());
+    }
+
+    if (segment.rows_.empty() && segment.index_.empty()) {
+        // A second cleared segment owns no rows or entries any more and is cheap to free.
+        if (!spare_) {
+            spare_ = std::move(retired_.front());
+        }
+        retired_.pop_front();
+    }
+}
@@ -0,0 +1,132 @@
+/// \file  workload.cpp
+/// \brief Implements workload generation and trace files.
+
+#include "../headers/workload.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+vector<Operation> makeWorkload(const vector<Flower>& data, const WorkloadConfig& config) {
+    vector<Operation> operations;
+    if (data.empty()) {
+        return operations;
+    }
+
+    vector<string> names;
+    unordered_set<string> seen;
+    for (const Flower& flower : data) {
+        if (seen.insert(flower.GetName()).second) {
+            names.push_back(flower.GetName());
+        }
+    }
+
+    mt19937 gen(config.seed);
+    shuffle(names.begin(), names.end(), gen);
+
+    vector<double> weights;
+    for (size_t i = 0; i < names.size(); ++i) {
+        weights.push_back(1.0 / pow((double)(i + 1), config.zipf));
+    }
+
+    discrete_distribution<size_t> popularity(weights.begin(), weights.end());
+    uniform_int_distribution<size_t> row(0, data.size() - 1);
+    bernoulli_distribution hit(config.hit_ratio);
+    bernoulli_distribution insert(config.insert_ratio);
+
+    for (size_t i = 0; i < config.operations; ++i) {
+        Operation op;
+        op.type = insert(gen) ? INSERT : READ;
+        op.key = names[popularity(gen)];
+        if (!hit(gen)) {
+            op.key += "#" + to_string(i);
+        }
+
+        if (op.type == INSERT) {
+            const Flower& origin = data[row(gen)];
+            op.row = Flower(op.key, origin.GetColor(), origin.GetSmell(), origin.GetRegions());
+        } else {
+            op.row = Flower(op.key, "", "", {});
+        }
+
+        operations.push_back(op);
+    }
+
+    return operations;
+}
+
+void saveTrace(const string& path, const vector<Operation>& operations) {
+    ofstream fout(path);
+    if (!fout.is_open()) {
+        throw std::runtime_error("Cannot open file for writing: " + path);
+    }
+
+    for (const Operation& op : operations) {
+        if (op.type == READ) {
+            fout << "R\t" << op.key << "\n";
+            continue;
+        }
+
+        fout << "I\t" << op.key << "\t" << op.row.GetColor() << "\t" << op.row.GetSmell() << "\t";
+
+        vector<string> regions = op.row.GetRegions();
+        for (size_t j = 0; j < regions.size(); ++j) {
+            fout << regions[j];
+            if (j != regions.size() - 1) {
+                fout << ";";
+            }
+        }
+        fout << "\n";
+    }
+}
+
+vector<Operation> loadTrace(const string& path) {
+    ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open trace file: " + path);
+    }
+
+    vector<Operation> operations;
+    string line;
+
+    while (getline(file, line)) {
+        if (line.empty()) {
+            continue;
+        }
+
+        vector<string> fields;
+        stringstream fields_stream(line);
+        string field;
+        while (getline(fields_stream, field, '\t')) {
+            fields.push_back(field);
+        }
+
+        Operation op;
+        if (fields.size() == 2 && fields[0] == "R") {
+            op.type = READ;
+            op.key = fields[1];
+            op.row = Flower(op.key, "", "", {});
+        } else if (fields.size() == 5 && fields[0] == "I") {
+            vector<string> regions;
+            stringstream regions_stream(fields[4]);
+            string region;
+            while (getline(regions_stream, region, ';')) {
+                regions.push_back(region);
+            }
+
+            op.type = INSERT;
+            op.key = fields[1];
+            op.row = Flower(op.key, fields[2], fields[3], regions);
+        } else {
+            throw std::runtime_error("Malformed trace line in " + path + ": " + line);
+        }
+
+        operations.push_back(op);
+    }
+
+    return operations;
+}
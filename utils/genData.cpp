@@ -0,0 +1,260 @@
+/// \file  genData.cpp
+/// \brief Multithreaded generator of synthetic Flower datasets in the CSV format read by parserCSV().
+///
+/// Usage:
+///     GenData --rows N --out PATH [--names K] [--zipf S] [--min-regions A] [--max-regions B]
+///             [--seed X] [--threads T]
+///
+/// - names        number of distinct flower names (default 14, the names of the shipped datasets);
+/// - zipf         skew of the name popularity, 0 gives a uniform distribution (default 0);
+/// - min-regions, max-regions  length of the region list of a row, at most 3 (default 1 and 3);
+/// - seed         the output only depends on the seed and the options, not on the number of threads.
+///
+/// Rows are produced in chunks. Every chunk has its own random generator seeded from (seed, chunk),
+/// the chunks of one round are generated in parallel while the previous round is written to disk.
+
+#include "../headers/hash_func.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/// \brief Number of rows generated by one task.
+#define CHUNK_ROWS 65536
+
+static const vector<string> kNames = { "Бархатцы", "Бегония", "Гвоздика", "Гиацинт", "Жасмин", "Лаванда", "Лилия",
+                                       "Маргаритка", "Нарцисс", "Орхидея", "Пион", "Роза", "Тюльпан", "Хризантема" };
+static const vector<string> kColors = { "белый", "голубой", "жёлтый", "зелёный", "красный", "оранжевый", "розовый",
+                                        "синий", "фиолетовый" };
+static const vector<string> kSmells = { "сильный", "слабый", "умеренный" };
+static const vector<string> kRegions = { "Австралия", "Азия", "Африка", "Европа", "Северная Америка", "Южная Америка" };
+
+/// \brief Options of one generator run.
+struct GenConfig {
+    unsigned long long rows = 0;
+    size_t names = 14;
+    double zipf = 0;
+    int min_regions = 1;
+    int max_regions = 3;
+    unsigned long long seed = 1;
+    unsigned threads = 0;
+    string out;
+};
+
+/// \brief Small and fast generator (SplitMix64), one instance per chunk.
+struct Random {
+    uint64_t state;
+
+    Random(uint64_t seed) : state(seed) {}
+
+    uint64_t Next() {
+        state += 0x9e3779b97f4a7c15ULL;
+        return mix64(state);
+    }
+
+    /// \brief Uniform integer in [0, n).
+    uint64_t Below(uint64_t n) { return (uint64_t)(((unsigned __int128)Next() * n) >> 64); }
+
+    /// \brief Uniform double in [0, 1).
+    double Unit() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+/// \brief Name of the flower with a given popularity rank; names beyond the base list get a number.
+string makeName(size_t rank) {
+    string name = kNames[rank % kNames.size()];
+    if (rank >= kNames.size()) {
+        name += " " + to_string(rank / kNames.size());
+    }
+    return name;
+}
+
+/// \brief Cumulative Zipf distribution over the name ranks.
+vector<double> makeCdf(const GenConfig& config) {
+    vector<double> cdf(config.names);
+    double sum = 0;
+
+    for (size_t i = 0; i < config.names; ++i) {
+        sum += 1.0 / pow((double)(i + 1), config.zipf);
+        cdf[i] = sum;
+    }
+    for (double& value : cdf) {
+        value /= sum;
+    }
+
+    return cdf;
+}
+
+/**
+ * \brief Generate the rows of one chunk as CSV text.
+ *
+ * \param config Generator options.
+ * \param names  Name of every rank.
+ * \param cdf    Cumulative popularity of the ranks.
+ * \param chunk  Number of the chunk.
+ * \param out    Output buffer, replaced by the chunk text.
+ */
+void generateChunk(const GenConfig& config, const vector<string>& names, const vector<double>& cdf,
+                   unsigned long long chunk, string& out) {
+    Random random(mix64(config.seed) ^ mix64(chunk + 1));
+
+    unsigned long long first = chunk * CHUNK_ROWS;
+    unsigned long long count = min<unsigned long long>(CHUNK_ROWS, config.rows - first);
+
+    out.clear();
+    int order[6] = { 0, 1, 2, 3, 4, 5 };
+
+    for (unsigned long long i = 0; i < count; ++i) {
+        size_t rank = upper_bound(cdf.begin(), cdf.end(), random.Unit()) - cdf.begin();
+        rank = min(rank, names.size() - 1);
+
+        out += names[rank];
+        out += ',';
+        out += kColors[random.Below(kColors.size())];
+        out += ',';
+        out += kSmells[random.Below(kSmells.size())];
+        out += ',';
+
+        int regions = config.min_regions + (int)random.Below(config.max_regions - config.min_regions + 1);
+        for (int r = 0; r < regions; ++r) {
+            swap(order[r], order[r + random.Below(kRegions.size() - r)]);
+        }
+
+        if (regions == 1) {
+            out += "['";
+            out += kRegions[order[0]];
+            out += "']";
+        } else {
+            out += "\"[";
+            for (int r = 0; r < regions; ++r) {
+                if (r) {
+                    out += ", ";
+                }
+                out += '\'';
+                out += kRegions[order[r]];
+                out += '\'';
+            }
+            out += "]\"";
+        }
+
+        out += '\n';
+    }
+}
+
+/// \brief Parse the command line into a GenConfig.
+/// \throws invalid_argument on unknown or malformed options.
+GenConfig parseArgs(int argc, char **argv) {
+    GenConfig config;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        string value = argv[++i];
+
+        if (arg == "--rows") {
+            config.rows = stoull(value);
+        } else if (arg == "--names") {
+            config.names = stoull(value);
+        } else if (arg == "--zipf") {
+            config.zipf = stod(value);
+        } else if (arg == "--min-regions") {
+            config.min_regions = stoi(value);
+        } else if (arg == "--max-regions") {
+            config.max_regions = stoi(value);
+        } else if (arg == "--seed") {
+            config.seed = stoull(value);
+        } else if (arg == "--threads") {
+            config.threads = stoul(value);
+        } else if (arg == "--out") {
+            config.out = value;
+        } else {
+            throw std::invalid_argument("Unknown option " + arg);
+        }
+    }
+
+    if (config.out.empty() || config.names == 0) {
+        throw std::invalid_argument("--out and a positive --names are required");
+    }
+    if (config.min_regions < 1 || config.max_regions > 3 || config.min_regions > config.max_regions) {
+        throw std::invalid_argument("Region list length must satisfy 1 <= min <= max <= 3");
+    }
+    if (config.threads == 0) {
+        config.threads = max(1u, thread::hardware_concurrency());
+    }
+
+    return config;
+}
+
+int main(int argc, char **argv) {
+    GenConfig config;
+    try {
+        config = parseArgs(argc, argv);
+    } catch (const exception& e) {
+        cerr << e.what() << endl
+             << "Usage: GenData --rows N --out PATH [--names K] [--zipf S] [--min-regions A] [--max-regions B] "
+                "[--seed X] [--threads T]" << endl;
+        return 1;
+    }
+
+    FILE *file = fopen(config.out.c_str(), "wb");
+    if (!file) {
+        cerr << "Cannot open file for writing: " << config.out << endl;
+        return 1;
+    }
+    setvbuf(file, nullptr, _IOFBF, 1 << 22);
+
+    vector<string> names(config.names);
+    for (size_t i = 0; i < config.names; ++i) {
+        names[i] = makeName(i);
+    }
+    vector<double> cdf = makeCdf(config);
+
+    fputs("name,color,aroma,regions\n", file);
+
+    unsigned long long chunks = (config.rows + CHUNK_ROWS - 1) / CHUNK_ROWS;
+    vector<string> ready(config.threads), next(config.threads);
+    size_t ready_count = 0;
+
+    for (unsigned long long round = 0; round * config.threads < chunks || ready_count; round += 1) {
+        unsigned long long first = round * config.threads;
+        size_t count = first < chunks ? (size_t)min<unsigned long long>(config.threads, chunks - first) : 0;
+
+        vector<future<void>> tasks;
+        for (size_t t = 0; t < count; ++t) {
+            tasks.push_back(async(launch::async, generateChunk, cref(config), cref(names), cref(cdf),
+                                  first + t, ref(next[t])));
+        }
+
+        for (size_t t = 0; t < ready_count; ++t) {
+            if (fwrite(ready[t].data(), 1, ready[t].size(), file) != ready[t].size()) {
+                cerr << "Write error: " << config.out << endl;
+                fclose(file);
+                return 1;
+            }
+        }
+
+        for (future<void>& task : tasks) {
+            task.get();
+        }
+
+        swap(ready, next);
+        ready_count = count;
+    }
+
+    if (fclose(file) != 0) {
+        cerr << "Write error: " << config.out << endl;
+        return 1;
+    }
+
+    return 0;
+}
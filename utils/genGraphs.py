@@ -9,6 +9,11 @@ data = {
     "RB tree": [],
     "Hash table": [],
     "Multimap": [],
+    "MPH": [],
+    "Sorted array": [],
+    "Learned index": [],
+    "Compact RB tree": [],
+    "Splay tree": [],
 
     "Collisions": []
 }
@@ -29,19 +34,30 @@ def parse_file(filepath, data):
                 size = int(size_str)
                 data["Size"].append(size)
 
-            elif line[0] in "12345":
+            elif line[0] in "123456789":
+                number, _ = line.split(".", 1)
                 _, time_str = line.split(": ")
                 time = float(time_str)
-                if line[0] == "1":
+                if number == "1":
                     data["Linear search"].append(time)
-                elif line[0] == "2":
+                elif number == "2":
                     data["Binary search tree"].append(time)
-                elif line[0] == "3":
+                elif number == "3":
                     data["RB tree"].append(time)
-                elif line[0] == "4":
+                elif number == "4":
                     data["Hash table"].append(time)
-                elif line[0] == "5":
+                elif number == "5":
                     data["Multimap"].append(time)
+                elif number == "6":
+                    data["MPH"].append(time)
+                elif number == "7":
+                    data["Sorted array"].append(time)
+                elif number == "8":
+                    data["Learned index"].append(time)
+                elif number == "9":
+                    data["Compact RB tree"].append(time)
+                elif number == "10":
+                    data["Splay tree"].append(time)
             
             elif line.startswith("Collisions"):
                 _, collis_str = line.split(": ")
@@ -66,6 +82,11 @@ def plotAll(data):
     plt.plot(data["Size"], data["RB tree"], label="rb", color="green")
     plt.plot(data["Size"], data["Hash table"], label="hash", color="purple")
     plt.plot(data["Size"], data["Multimap"], label="multimap", color="orange")
+    plt.plot(data["Size"], data["MPH"], label="mph", color="brown")
+    plt.plot(data["Size"], data["Sorted array"], label="sorted", color="black")
+    plt.plot(data["Size"], data["Learned index"], label="learned", color="gray")
+    plt.plot(data["Size"], data["Compact RB tree"], label="rb_compact", color="olive")
+    plt.plot(data["Size"], data["Splay tree"], label="splay", color="cyan")
 
     plt.xlabel("Dataset size")
     plt.ylabel("Time of search")
@@ -80,6 +101,61 @@ def plotAll(data):
     plt.show()
 
 
+def plotDistribution(filepath):
+    bench = pd.read_csv(filepath)
+    colors = {"linear": "blue", "binary": "red", "rb": "green", "hash": "purple", "multimap": "orange", "mph": "brown", "sorted": "black", "learned": "gray", "rb_compact": "olive", "splay": "cyan"}
+
+    plt.figure(figsize=(10, 6))
+
+    for name, rows in bench.groupby("structure"):
+        rows = rows.sort_values("size")
+        color = colors.get(name, "black")
+        plt.plot(rows["size"], rows["p50"], label=name + " p50", color=color)
+        plt.fill_between(rows["size"], rows["p50"], rows["p99"], color=color, alpha=0.2)
+        plt.plot(rows["size"], rows["p999"], linestyle="--", color=color)
+
+    plt.xlabel("Dataset size")
+    plt.ylabel("Time of search (p50, p50-p99 band, p99.9 dashed)")
+
+    plt.xscale("log")
+    plt.yscale("log")
+
+    plt.title("Latency distribution")
+    plt.legend()
+    plt.grid(True)
+    plt.show()
+
+
+def plotBuild(filepath):
+    build = pd.read_csv(filepath)
+
+    fig, (ax_time, ax_bytes) = plt.subplots(1, 2, figsize=(14, 6))
+
+    for name, rows in build.groupby("structure"):
+        rows = rows.sort_values("size")
+        ax_time.plot(rows["size"], rows["build_seconds"], label=name)
+        ax_bytes.plot(rows["size"], rows["bytes_per_row"], label=name)
+
+    ax_time.set_xlabel("Dataset size")
+    ax_time.set_ylabel("Build time")
+    ax_time.set_xscale("log")
+    ax_time.set_yscale("log")
+    ax_time.set_title("Build time")
+    ax_time.legend()
+    ax_time.grid(True)
+
+    ax_bytes.set_xlabel("Dataset size")
+    ax_bytes.set_ylabel("Bytes per row")
+    ax_bytes.set_xscale("log")
+    ax_bytes.set_title("Memory footprint")
+    ax_bytes.legend()
+    ax_bytes.grid(True)
+
+    plt.show()
+
+
 parse_file("/Users/ekaterinagridneva/Desktop/hse/mp/data-search-algorithms/info_time.txt", data)
 plotCollis(data)
 plotAll(data)
+plotDistribution("/Users/ekaterinagridneva/Desktop/hse/mp/data-search-algorithms/bench.csv")
+plotBuild("/Users/ekaterinagridneva/Desktop/hse/mp/data-search-algorithms/build.csv")
\ No newline at end of file
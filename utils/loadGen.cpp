@@ -0,0 +1,328 @@
+/// \file  loadGen.cpp
+/// \brief Load generator for the query server (SecondLab --serve): measures throughput and tail latency.
+///
+/// Usage:
+///     LoadGen --socket PATH [--connections C] [--frames N] [--depth D] [--batch B] [--limit L]
+///             [--keys CSV] [--prefix-ratio R] [--attr-ratio R] [--seed X]
+///
+/// - connections  client connections, one thread each (default 4);
+/// - frames       request frames sent by every connection (default 10000);
+/// - depth        frames a connection keeps in flight, 1 disables pipelining (default 8);
+/// - batch        queries per frame (default 1);
+/// - limit        largest number of row ids a query asks for (default 16);
+/// - keys         CSV whose names (first field) are queried, the 14 base names by default;
+/// - prefix-ratio, attr-ratio  shares of prefix and attribute queries, the rest are exact (default 0.1 each).
+///
+/// The latency of a frame is the time from writing it to reading its response. Prints the query
+/// rate, the frame rate and the latency percentiles over all connections.
+
+#include "../headers/hash_func.h"
+#include "../headers/protocol.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const vector<string> kNames = { "Бархатцы", "Бегония", "Гвоздика", "Гиацинт", "Жасмин", "Лаванда", "Лилия",
+                                       "Маргаритка", "Нарцисс", "Орхидея", "Пион", "Роза", "Тюльпан", "Хризантема" };
+static const vector<string> kColors = { "белый", "голубой", "жёлтый", "зелёный", "красный", "оранжевый", "розовый",
+                                        "синий", "фиолетовый" };
+static const vector<string> kSmells = { "сильный", "слабый", "умеренный" };
+static const vector<string> kRegions = { "Австралия", "Азия", "Африка", "Европа", "Северная Америка", "Южная Америка" };
+
+/// \brief Options of one load run.
+struct LoadConfig {
+    string socket;
+    unsigned connections = 4;
+    size_t frames = 10000;
+    size_t depth = 8;
+    size_t batch = 1;
+    uint32_t limit = 16;
+    string keys;
+    double prefix_ratio = 0.1;
+    double attr_ratio = 0.1;
+    unsigned long long seed = 1;
+};
+
+/// \brief What one connection measured.
+struct ConnectionResult {
+    vector<double> latencies;   ///< Microseconds per frame.
+    size_t matches = 0;
+    size_t errors = 0;
+};
+
+/// \brief Small and fast generator (SplitMix64), one instance per connection.
+struct Random {
+    uint64_t state;
+
+    Random(uint64_t seed) : state(seed) {}
+
+    uint64_t Next() {
+        state += 0x9e3779b97f4a7c15ULL;
+        return mix64(state);
+    }
+
+    /// \brief Uniform integer in [0, n).
+    uint64_t Below(uint64_t n) { return (uint64_t)(((unsigned __int128)Next() * n) >> 64); }
+
+    /// \brief Uniform double in [0, 1).
+    double Unit() { return (Next() >> 11) * (1.0 / 9007199254740992.0); }
+};
+
+/// \brief The distinct names of the first field of a CSV file, the header skipped.
+vector<string> readKeys(const string& path) {
+    ifstream in(path);
+    if (!in.is_open()) {
+        throw runtime_error("Cannot open file: " + path);
+    }
+
+    vector<string> keys;
+    string line;
+    getline(in, line);
+    while (getline(in, line)) {
+        keys.push_back(line.substr(0, line.find(',')));
+    }
+
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+/// \brief A random query of the configured mix.
+Query makeQuery(const LoadConfig& config, const vector<string>& keys, Random& random) {
+    Query query;
+    query.limit_ = config.limit;
+    double kind = random.Unit();
+
+    if (kind < config.attr_ratio) {
+        static const vector<string> *lists[3] = { &kColors, &kSmells, &kRegions };
+        size_t list = random.Below(3);
+        query.op_ = (uint8_t)(OP_COLOR + list);
+        query.key_ = (*lists[list])[random.Below(lists[list]->size())];
+    } else {
+        query.key_ = keys[random.Below(keys.size())];
+        query.op_ = OP_EXACT;
+
+        if (kind < config.attr_ratio + config.prefix_ratio) {
+            // Half of the name, cut at a UTF-8 character boundary.
+            size_t cut = query.key_.size() / 2;
+            while (cut > 0 && ((unsigned char)query.key_[cut] & 0xc0) == 0x80) {
+                cut -= 1;
+            }
+            query.key_.resize(cut);
+            query.op_ = OP_PREFIX;
+        }
+    }
+
+    return query;
+}
+
+/// \brief Write all of data. \return false if the connection failed.
+bool writeAll(int fd, const string& data) {
+    for (size_t pos = 0; pos < data.size(); ) {
+        ssize_t sent = send(fd, data.data() + pos, data.size() - pos, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        pos += sent;
+    }
+    return true;
+}
+
+/**
+ * \brief Send config.frames frames over one connection, keeping config.depth of them in flight.
+ *
+ * \param config Load options.
+ * \param keys   Names to query.
+ * \param index  Number of the connection, mixed into the seed.
+ * \param result Filled with the measurements.
+ */
+void runConnection(const LoadConfig& config, const vector<string>& keys, unsigned index, ConnectionResult& result) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, config.socket.c_str(), min(config.socket.size() + 1, sizeof(addr.sun_path) - 1));
+
+    if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        result.errors += config.frames;
+        close(fd);
+        return;
+    }
+
+    Random random(mix64(config.seed) ^ mix64(index + 1));
+    vector<chrono::steady_clock::time_point> sent_at(config.frames);
+    vector<Query> queries(config.batch);
+    string out, in;
+    char chunk[65536];
+    size_t sent = 0, received = 0;
+
+    while (received < config.frames) {
+        out.clear();
+        for (; sent < config.frames && sent - received < config.depth; ++sent) {
+            for (Query& query : queries) {
+                query = makeQuery(config, keys, random);
+            }
+            encodeRequest(out, (uint32_t)sent, queries);
+            sent_at[sent] = chrono::steady_clock::now();
+        }
+        if (!out.empty() && !writeAll(fd, out)) {
+            break;
+        }
+
+        ssize_t got = recv(fd, chunk, sizeof(chunk), 0);
+        if (got <= 0) {
+            break;
+        }
+        in.append(chunk, got);
+
+        size_t pos = 0, length;
+        while ((length = frameLength(in.data() + pos, in.size() - pos)) != 0) {
+            auto now = chrono::steady_clock::now();
+            size_t body = pos + FRAME_HEADER;
+            uint32_t id = 0;
+            uint8_t status = REPLY_BAD_REQUEST;
+            uint16_t count = 0;
+            getInt(in.data(), pos + length, body, id);
+            getInt(in.data(), pos + length, body, status);
+            getInt(in.data(), pos + length, body, count);
+
+            // Responses come back in request order.
+            if (id != received || status != REPLY_OK || count != config.batch) {
+                result.errors += 1;
+            }
+            for (uint16_t q = 0; q < count; ++q) {
+                uint32_t matches = 0, returned = 0;
+                getInt(in.data(), pos + length, body, matches);
+                getInt(in.data(), pos + length, body, returned);
+                body += returned * sizeof(uint32_t);
+                result.matches += matches;
+            }
+
+            result.latencies.push_back(chrono::duration<double, micro>(now - sent_at[min<size_t>(id, sent - 1)]).count());
+            received += 1;
+            pos += length;
+        }
+        in.erase(0, pos);
+    }
+
+    result.errors += config.frames - received;
+    close(fd);
+}
+
+/// \brief Parse the command line into a LoadConfig.
+/// \throws invalid_argument on unknown or malformed options.
+LoadConfig parseArgs(int argc, char **argv) {
+    LoadConfig config;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        string value = argv[++i];
+
+        if (arg == "--socket") {
+            config.socket = value;
+        } else if (arg == "--connections") {
+            config.connections = stoul(value);
+        } else if (arg == "--frames") {
+            config.frames = stoull(value);
+        } else if (arg == "--depth") {
+            config.depth = stoull(value);
+        } else if (arg == "--batch") {
+            config.batch = stoull(value);
+        } else if (arg == "--limit") {
+            config.limit = stoul(value);
+        } else if (arg == "--keys") {
+            config.keys = value;
+        } else if (arg == "--prefix-ratio") {
+            config.prefix_ratio = stod(value);
+        } else if (arg == "--attr-ratio") {
+            config.attr_ratio = stod(value);
+        } else if (arg == "--seed") {
+            config.seed = stoull(value);
+        } else {
+            throw std::invalid_argument("Unknown option " + arg);
+        }
+    }
+
+    if (config.socket.empty()) {
+        throw std::invalid_argument("--socket is required");
+    }
+    if (config.connections == 0 || config.depth == 0 || config.batch == 0 || config.batch > UINT16_MAX) {
+        throw std::invalid_argument("--connections, --depth and --batch must be positive, --batch at most 65535");
+    }
+
+    return config;
+}
+
+/// \brief Value at a quantile of sorted values.
+double percentile(const vector<double>& sorted, double quantile) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[min(sorted.size() - 1, (size_t)(quantile * sorted.size()))];
+}
+
+int main(int argc, char **argv) {
+    LoadConfig config;
+    vector<string> keys = kNames;
+    try {
+        config = parseArgs(argc, argv);
+        if (!config.keys.empty()) {
+            keys = readKeys(config.keys);
+        }
+    } catch (const exception& e) {
+        cerr << e.what() << endl
+             << "Usage: LoadGen --socket PATH [--connections C] [--frames N] [--depth D] [--batch B] [--limit L] "
+                "[--keys CSV] [--prefix-ratio R] [--attr-ratio R] [--seed X]" << endl;
+        return 1;
+    }
+    if (keys.empty()) {
+        cerr << "No keys in " << config.keys << endl;
+        return 1;
+    }
+
+    vector<ConnectionResult> results(config.connections);
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+
+    for (unsigned i = 0; i < config.connections; ++i) {
+        threads.emplace_back(runConnection, cref(config), cref(keys), i, ref(results[i]));
+    }
+    for (thread& worker : threads) {
+        worker.join();
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<double> latencies;
+    size_t matches = 0, errors = 0;
+    for (const ConnectionResult& result : results) {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        matches += result.matches;
+        errors += result.errors;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    size_t frames = latencies.size();
+    printf("Frames: %zu, queries: %zu, matches: %zu, errors: %zu, time: %.3f s\n", frames, frames * config.batch,
+           matches, errors, seconds);
+    printf("QPS: %.0f, frames per second: %.0f\n", frames * config.batch / seconds, frames / seconds);
+    printf("Frame latency, us: p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n", percentile(latencies, 0.5),
+           percentile(latencies, 0.99), percentile(latencies, 0.999), latencies.empty() ? 0.0 : latencies.back());
+
+    return errors ? 1 : 0;
+}